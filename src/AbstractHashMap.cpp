@@ -1,5 +1,57 @@
 #include "AbstractHashMap.h"
+#include <algorithm>
+#include <numeric>
 
 AbstractHashMap::AbstractHashMap() { this->count = 0; }
 
+bool AbstractHashMap::insert(std::string_view key) {
+  return insert(std::string(key));
+}
+
+bool AbstractHashMap::insert(const char *key) {
+  return insert(std::string(key));
+}
+
+void AbstractHashMap::insertBatch(std::string *keys, int n, bool *results) {
+  for (int i = 0; i < n; ++i) {
+    results[i] = insert(std::move(keys[i]));
+  }
+}
+
+void AbstractHashMap::searchBatch(const std::string_view *keys, int n,
+                                  bool *results) const {
+  for (int i = 0; i < n; ++i) {
+    results[i] = search(keys[i]);
+  }
+}
+
+void AbstractHashMap::removeBatch(const std::string_view *keys, int n,
+                                  bool *results) {
+  for (int i = 0; i < n; ++i) {
+    results[i] = remove(keys[i]);
+  }
+}
+
+MapStats AbstractHashMap::stats() const {
+  MapStats s;
+  s.size = size();
+  return s;
+}
+
+void AbstractHashMap::collectStats(bool) {}
+
+void AbstractHashMap::dumpStats(const std::string &path) const {
+  stats().dump(path);
+}
+
+std::vector<int> AbstractHashMap::orderByBucket(const uint64_t *hashes, int n,
+                                                uint64_t mask) {
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return (hashes[a] & mask) < (hashes[b] & mask);
+  });
+  return order;
+}
+
 AbstractHashMap::~AbstractHashMap() {}
\ No newline at end of file
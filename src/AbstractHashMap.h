@@ -1,11 +1,19 @@
 #ifndef ABSTRACT_HASH_MAP_H
 #define ABSTRACT_HASH_MAP_H
 
+#include "MapStats.h"
 #include <atomic>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 
 /**
  * Abstract Hash Map class for std::string data.
+ *
+ * Lookups take a std::string_view and never allocate. Insertion moves an
+ * owned key into the map; the other insert overloads copy the key once.
+ * Subclasses bring them into scope with using AbstractHashMap::insert.
  */
 class AbstractHashMap {
 
@@ -13,23 +21,63 @@ public:
   // Constructor.
   AbstractHashMap();
 
-  // Pure method to insert a key.
-  virtual bool insert(std::string) = 0;
+  // Pure method to insert a key, moving it into the map.
+  virtual bool insert(std::string &&) = 0;
+
+  // Insert a copy of a key.
+  bool insert(std::string_view);
+  bool insert(const char *);
 
   // Pure method to search a key.
-  virtual bool search(std::string) const = 0;
+  virtual bool search(std::string_view) const = 0;
 
   // Pure method to remove a key.
-  virtual bool remove(std::string) = 0;
+  virtual bool remove(std::string_view) = 0;
+
+  // Batched operations, results[i] is the result for keys[i]. Maps override
+  // them to hash the whole batch first and prefetch the buckets before
+  // resolving any key, and writers take each lock once per batch. The
+  // defaults call the single key methods in a loop.
+
+  // Insert a batch of keys, moving them into the map.
+  virtual void insertBatch(std::string *keys, int n, bool *results);
+
+  // Search a batch of keys.
+  virtual void searchBatch(const std::string_view *keys, int n,
+                           bool *results) const;
+
+  // Remove a batch of keys.
+  virtual void removeBatch(const std::string_view *keys, int n,
+                           bool *results);
 
   // Size.
   virtual int size() const = 0;
 
+  // A snapshot of the map's internals, see MapStats. The default only fills
+  // in the size.
+  virtual MapStats stats() const;
+
+  // Whether to count contended lock acquisitions for stats(), off by
+  // default. Maps without locks ignore it.
+  virtual void collectStats(bool);
+
+  // Append stats() to a file, or write it to stdout for "-".
+  void dumpStats(const std::string &path = "-") const;
+
   // Pure destructor.
   virtual ~AbstractHashMap();
 
 protected:
+  // Number of keys of a batch whose buckets are prefetched together, enough
+  // to overlap the cache misses while the lines stay in L1.
+  static constexpr int BATCH_CHUNK = 16;
+
   // Total number of data elements in hash map.
   std::atomic<int> count;
+
+  // Positions 0..n-1 of a batch ordered by bucket (hash & mask), so that a
+  // writer can take each bucket's lock once.
+  static std::vector<int> orderByBucket(const uint64_t *hashes, int n,
+                                        uint64_t mask);
 };
 #endif // ABSTRACT_HASH_MAP_H
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "BucketLocks.h"
+#include <thread>
+
+namespace {
+
+// Number of polls of an MCS node before its waiter starts yielding.
+const int MCS_SPINS = 64;
+
+} // namespace
+
+void SpinLock::lock() {
+  int backoff = 1;
+  while (locked.exchange(true, std::memory_order_acquire)) {
+    // Test before test-and-set, so waiters don't bounce the line around.
+    while (locked.load(std::memory_order_relaxed)) {
+      if (backoff < MAX_BACKOFF) {
+        for (int i = 0; i < backoff; ++i) {
+          cpuRelax();
+        }
+        backoff *= 2;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+McsLock::Node *McsLock::acquireNode() {
+  static thread_local Node nodes[MAX_HELD];
+  for (Node &node : nodes) {
+    if (!node.inUse) {
+      node.inUse = true;
+      return &node;
+    }
+  }
+  std::__throw_runtime_error("too many MCS locks held by one thread.");
+}
+
+void McsLock::lock() {
+  Node *node = acquireNode();
+  node->next.store(nullptr, std::memory_order_relaxed);
+  node->waiting.store(true, std::memory_order_relaxed);
+  Node *prev = tail.exchange(node, std::memory_order_acq_rel);
+  if (prev != nullptr) {
+    // Queue behind prev and wait for it to hand the lock over.
+    prev->next.store(node, std::memory_order_release);
+    for (int i = 0; node->waiting.load(std::memory_order_acquire); ++i) {
+      if (i < MCS_SPINS) {
+        cpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+  owner = node;
+}
+
+bool McsLock::try_lock() {
+  if (tail.load(std::memory_order_relaxed) != nullptr) {
+    return false;
+  }
+  Node *node = acquireNode();
+  node->next.store(nullptr, std::memory_order_relaxed);
+  Node *expected = nullptr;
+  if (!tail.compare_exchange_strong(expected, node, std::memory_order_acquire,
+                                    std::memory_order_relaxed)) {
+    node->inUse = false;
+    return false;
+  }
+  owner = node;
+  return true;
+}
+
+void McsLock::unlock() {
+  Node *node = owner;
+  Node *next = node->next.load(std::memory_order_acquire);
+  if (next == nullptr) {
+    // No one queued: free the lock, unless a waiter is just linking in.
+    Node *expected = node;
+    if (tail.compare_exchange_strong(expected, nullptr,
+                                     std::memory_order_release,
+                                     std::memory_order_relaxed)) {
+      node->inUse = false;
+      return;
+    }
+    while ((next = node->next.load(std::memory_order_acquire)) == nullptr) {
+      cpuRelax();
+    }
+  }
+  next->waiting.store(false, std::memory_order_release);
+  node->inUse = false;
+}
+
+ContentionCounters::ContentionCounters(int slots) {
+  this->slots = 1;
+  while (this->slots < slots) {
+    this->slots *= 2;
+  }
+  counters.reset(new std::atomic<uint64_t>[this->slots]);
+  for (int i = 0; i < this->slots; ++i) {
+    counters[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void ContentionCounters::enable(bool enabled) {
+  used = used || enabled;
+  on = enabled;
+}
+
+std::vector<uint64_t> ContentionCounters::counts() const {
+  if (!used) {
+    return {};
+  }
+  std::vector<uint64_t> c(slots);
+  for (int i = 0; i < slots; ++i) {
+    c[i] = counters[i].load(std::memory_order_relaxed);
+  }
+  return c;
+}
+
+LockStripes::LockStripes(Kind kind, int stripes)
+    : kind(kind), contention(stripes) {
+  if (stripes < 1) {
+    std::__throw_out_of_range("stripes value is out of range.");
+  }
+  this->stripes = 1;
+  while (this->stripes < stripes) {
+    this->stripes *= 2;
+  }
+  switch (kind) {
+  case MUTEX:
+    mutexes.reset(new PaddedMutex[this->stripes]);
+    break;
+  case SPINLOCK:
+    spinLocks.reset(new SpinLock[this->stripes]);
+    break;
+  case MCS:
+    mcsLocks.reset(new McsLock[this->stripes]);
+    break;
+  }
+}
+
+void LockStripes::lock(int stripe) {
+  switch (kind) {
+  case MUTEX:
+    contention.lock(mutexes[stripe], stripe);
+    break;
+  case SPINLOCK:
+    contention.lock(spinLocks[stripe], stripe);
+    break;
+  case MCS:
+    contention.lock(mcsLocks[stripe], stripe);
+    break;
+  }
+}
+
+void LockStripes::unlock(int stripe) {
+  switch (kind) {
+  case MUTEX:
+    mutexes[stripe].unlock();
+    break;
+  case SPINLOCK:
+    spinLocks[stripe].unlock();
+    break;
+  case MCS:
+    mcsLocks[stripe].unlock();
+    break;
+  }
+}
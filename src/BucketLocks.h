@@ -0,0 +1,191 @@
+#ifndef BUCKET_LOCKS_H
+#define BUCKET_LOCKS_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Size of a cache line; locks are padded to it so that neighbours don't
+// share a line.
+constexpr int CACHE_LINE = 64;
+
+// Tell the CPU we are spinning.
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+/**
+ * A test-and-test-and-set spinlock with exponential backoff, padded to a
+ * cache line. Waiters spin on a plain load and only retry the exchange once
+ * the lock looks free; past MAX_BACKOFF they yield instead of burning the
+ * holder's core.
+ */
+class alignas(CACHE_LINE) SpinLock {
+
+public:
+  void lock();
+
+  bool try_lock() {
+    return !locked.load(std::memory_order_relaxed) &&
+           !locked.exchange(true, std::memory_order_acquire);
+  }
+
+  void unlock() { locked.store(false, std::memory_order_release); }
+
+private:
+  // Largest number of pause instructions between two polls.
+  static const int MAX_BACKOFF = 1024;
+
+  std::atomic<bool> locked{false};
+};
+
+/**
+ * An MCS queue lock, padded to a cache line. Waiters queue up and each spins
+ * on its own node, so a contended lock is handed over in FIFO order and only
+ * the next waiter's line is written on release.
+ *
+ * Queue nodes come from a small per-thread pool, so a thread can hold at most
+ * MAX_HELD MCS locks at a time.
+ */
+class alignas(CACHE_LINE) McsLock {
+
+public:
+  void lock();
+
+  bool try_lock();
+
+  void unlock();
+
+  // Number of MCS locks a thread can hold at the same time.
+  static const int MAX_HELD = 4;
+
+private:
+  struct alignas(CACHE_LINE) Node {
+    std::atomic<Node *> next;
+    std::atomic<bool> waiting;
+    // Whether the node is taken by a lock of its thread.
+    bool inUse = false;
+  };
+
+  // Last node of the queue, nullptr when the lock is free.
+  std::atomic<Node *> tail{nullptr};
+
+  // Node of the current holder, only accessed by the holder.
+  Node *owner = nullptr;
+
+  static Node *acquireNode();
+};
+
+/**
+ * Counts of contended lock acquisitions, one counter per slot (a lock stripe
+ * or a group of buckets). Counting is off by default and then lock() only
+ * adds a relaxed load and a predictable branch; when on, every acquisition
+ * tries the lock first and counts a failed try before it waits.
+ */
+class ContentionCounters {
+
+public:
+  // Constructor, the number of slots is rounded up to a power of two.
+  explicit ContentionCounters(int slots);
+
+  // Turn counting on or off.
+  void enable(bool);
+
+  // Take a lock, counting into slot & (slots - 1) if it was held.
+  template <typename L> void lock(L &l, uint64_t slot) {
+    if (on.load(std::memory_order_relaxed)) {
+      if (l.try_lock()) {
+        return;
+      }
+      counters[slot & (slots - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+    l.lock();
+  }
+
+  // The count of every slot, empty if counting was never turned on.
+  std::vector<uint64_t> counts() const;
+
+private:
+  std::atomic<bool> on{false};
+
+  // Whether counting was ever turned on.
+  std::atomic<bool> used{false};
+
+  int slots;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> counters;
+};
+
+/**
+ * A fixed number of locks shared by the buckets of a hash map: bucket b is
+ * guarded by stripe b & (stripes - 1), so the number of locks is independent
+ * of the number of buckets. The kind of lock is picked at construction.
+ */
+class LockStripes {
+
+public:
+  enum Kind {
+    // std::mutex, sleeps in the kernel when contended.
+    MUTEX,
+    // SpinLock, for short critical sections on a lightly loaded machine.
+    SPINLOCK,
+    // McsLock, fair and scalable on heavily contended (skewed) buckets.
+    MCS
+  };
+
+  // Constructor, the number of stripes is rounded up to a power of two.
+  LockStripes(Kind, int stripes);
+
+  // Stripe guarding a bucket.
+  int stripeOf(uint64_t bucket) const { return bucket & (stripes - 1); }
+
+  void lock(int stripe);
+
+  void unlock(int stripe);
+
+  // Number of stripes.
+  int size() const { return stripes; }
+
+  Kind getKind() const { return kind; }
+
+  // Count contended acquisitions per stripe, see ContentionCounters.
+  void countContention(bool enabled) { contention.enable(enabled); }
+
+  // Contended acquisitions per stripe, empty unless counted.
+  std::vector<uint64_t> contended() const { return contention.counts(); }
+
+  // Holds a stripe for its lifetime.
+  class Guard {
+  public:
+    Guard(LockStripes &locks, int stripe) : locks(locks), stripe(stripe) {
+      locks.lock(stripe);
+    }
+    ~Guard() { locks.unlock(stripe); }
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+  private:
+    LockStripes &locks;
+    const int stripe;
+  };
+
+private:
+  struct alignas(CACHE_LINE) PaddedMutex : std::mutex {};
+
+  Kind kind;
+
+  int stripes;
+
+  // Only the array of the selected kind is allocated.
+  std::unique_ptr<PaddedMutex[]> mutexes;
+  std::unique_ptr<SpinLock[]> spinLocks;
+  std::unique_ptr<McsLock[]> mcsLocks;
+
+  ContentionCounters contention;
+};
+#endif // BUCKET_LOCKS_H
@@ -0,0 +1,101 @@
+#ifndef BULK_LOAD_H
+#define BULK_LOAD_H
+#include "Hasher.h"
+#include "VersionedBucket.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * The shared part of the maps' bulkLoad(): insert n keys into a table of
+ * `buckets` VersionedBuckets without taking a lock.
+ *
+ * The keys are cut into one slice per task. Each task hashes its slice and
+ * counts its keys per partition, a partition being a contiguous range of
+ * buckets; a second pass scatters (hash, key) pairs into one array grouped by
+ * partition, every task writing its own runs. Each partition is then filled
+ * by a single task, so no two tasks touch a bucket and no bucket is locked.
+ * Every bucket's entry array is sized once before its keys are pushed.
+ *
+ * bucketOf(hash) is the bucket of a hash in [0, buckets) and bucketAt(b)
+ * the bucket itself. parallelFor(tasks, f) calls f(task) for every task in
+ * [0, tasks), in parallel, with `tasks` no more than `threads` times
+ * PARTITIONS_PER_THREAD. No writer may use the buckets meanwhile; searches
+ * may, the buckets stay consistent for them.
+ */
+namespace BulkLoad {
+
+// Partitions per thread, so that uneven partitions balance out.
+const int PARTITIONS_PER_THREAD = 4;
+
+struct Entry {
+  uint64_t hash;
+  uint64_t key;
+};
+
+template <typename BucketOf, typename BucketAt, typename ParallelFor>
+void load(const std::string_view *keys, size_t n, Hasher hasher,
+          uint64_t buckets, BucketOf bucketOf, BucketAt bucketAt, int threads,
+          ParallelFor parallelFor) {
+  const int slices = threads;
+  const int partitions = threads * PARTITIONS_PER_THREAD;
+  auto partitionOf = [&](uint64_t hash) {
+    return int(bucketOf(hash) * partitions / buckets);
+  };
+  auto sliceStart = [&](int s) { return n * s / slices; };
+
+  // Hash every key and count the keys of each slice per partition.
+  std::vector<uint64_t> hashes(n);
+  std::vector<std::vector<size_t>> counts(slices,
+                                          std::vector<size_t>(partitions));
+  parallelFor(slices, [&](int s) {
+    for (size_t i = sliceStart(s); i < sliceStart(s + 1); ++i) {
+      hashes[i] = hasher(keys[i]);
+      ++counts[s][partitionOf(hashes[i])];
+    }
+  });
+
+  // Partition p holds [start[p], start[p + 1]), slice by slice.
+  std::vector<size_t> start(partitions + 1);
+  size_t offset = 0;
+  for (int p = 0; p < partitions; ++p) {
+    start[p] = offset;
+    for (int s = 0; s < slices; ++s) {
+      const size_t c = counts[s][p];
+      counts[s][p] = offset;
+      offset += c;
+    }
+  }
+  start[partitions] = offset;
+
+  std::vector<Entry> entries(n);
+  parallelFor(slices, [&](int s) {
+    std::vector<size_t> &next = counts[s];
+    for (size_t i = sliceStart(s); i < sliceStart(s + 1); ++i) {
+      entries[next[partitionOf(hashes[i])]++] = {hashes[i], i};
+    }
+  });
+
+  parallelFor(partitions, [&](int p) {
+    // Buckets [first, last) make up partition p.
+    const uint64_t first = (p * buckets + partitions - 1) / partitions;
+    const uint64_t last = ((p + 1) * buckets + partitions - 1) / partitions;
+    std::vector<unsigned> sizes(last - first);
+    for (size_t j = start[p]; j < start[p + 1]; ++j) {
+      ++sizes[bucketOf(entries[j].hash) - first];
+    }
+    for (uint64_t b = first; b < last; ++b) {
+      if (sizes[b - first] > 0) {
+        VersionedBucket &bucket = bucketAt(b);
+        bucket.reserve(bucket.size() + sizes[b - first]);
+      }
+    }
+    for (size_t j = start[p]; j < start[p + 1]; ++j) {
+      const Entry &e = entries[j];
+      bucketAt(bucketOf(e.hash)).push(keys[e.key], e.hash);
+    }
+  });
+}
+
+} // namespace BulkLoad
+#endif // BULK_LOAD_H
@@ -1,57 +1,112 @@
 #include "ChainHashMap.h"
+#include "SlabAllocator.h"
 #include <algorithm>
-#include <iterator>
+#include <cstring>
+#include <new>
 
-ChainHashMap::ChainHashMap() : AbstractHashMap() {
-  hashMap = std::vector<std::list<std::string>>(BUCKETS);
+ChainHashMap::ChainHashMap(Hasher hasher) : AbstractHashMap() {
+  this->hasher = hasher;
+  hashMap = std::vector<Node *>(BUCKETS, nullptr);
 }
 
-bool ChainHashMap::insert(std::string key) {
-  const int index = getIndex(hash(key));
-  hashMap[index].push_back(key);
+bool ChainHashMap::insert(std::string &&key) {
+  const uint64_t h = hash(key);
+  const int index = getIndex(h);
+  Node *node = new (SlabAllocator::allocate(sizeof(Node) + key.size())) Node;
+  node->length = key.size();
+  node->tag = getTag(h);
+  std::memcpy(node + 1, key.data(), key.size());
+  node->next = hashMap[index];
+  hashMap[index] = node;
   ++count;
   return true;
 }
 
-bool ChainHashMap::search(std::string key) const {
-  const int index = getIndex(hash(key));
-  return std::find(hashMap[index].begin(), hashMap[index].end(), key) !=
-         hashMap[index].end();
+ChainHashMap::Node **ChainHashMap::find(Node **link, std::string_view key,
+                                        uint64_t hash) const {
+  // The key bytes are only read when the tags match, a miss compares one
+  // integer per node.
+  const uint32_t tag = getTag(hash);
+  while (*link != nullptr &&
+         ((*link)->tag != tag || (*link)->key() != key)) {
+    link = &(*link)->next;
+  }
+  return link;
+}
+
+bool ChainHashMap::search(std::string_view key) const {
+  const uint64_t h = hash(key);
+  Node *node = hashMap[getIndex(h)];
+  return *find(&node, key, h) != nullptr;
+}
+
+void ChainHashMap::searchBatch(const std::string_view *keys, int n,
+                               bool *results) const {
+  uint64_t h[BATCH_CHUNK];
+  int index[BATCH_CHUNK];
+  for (int base = 0; base < n; base += BATCH_CHUNK) {
+    const int m = std::min(BATCH_CHUNK, n - base);
+    // Overlap the misses on the chain heads, then on their first nodes.
+    for (int i = 0; i < m; ++i) {
+      h[i] = hash(keys[base + i]);
+      index[i] = getIndex(h[i]);
+      __builtin_prefetch(&hashMap[index[i]]);
+    }
+    for (int i = 0; i < m; ++i) {
+      if (hashMap[index[i]] != nullptr) {
+        __builtin_prefetch(hashMap[index[i]]);
+      }
+    }
+    for (int i = 0; i < m; ++i) {
+      Node *node = hashMap[index[i]];
+      results[base + i] = *find(&node, keys[base + i], h[i]) != nullptr;
+    }
+  }
 }
 
-bool ChainHashMap::remove(std::string key) {
-  const int index = getIndex(hash(key));
-  std::list<std::string>::iterator it =
-      std::find(hashMap[index].begin(), hashMap[index].end(), key);
+bool ChainHashMap::remove(std::string_view key) {
+  const uint64_t h = hash(key);
+  Node **link = find(&hashMap[getIndex(h)], key, h);
   // Do nothing if the key doesn't exist.
-  if (it == hashMap[index].end()) {
+  if (*link == nullptr) {
     return false;
   }
-  hashMap[index].erase(it);
+  Node *node = *link;
+  *link = node->next;
+  SlabAllocator::deallocate(node, sizeof(Node) + node->length);
   --count;
   return true;
 }
 
 int ChainHashMap::size() const { return count; }
 
-int ChainHashMap::getIndex(const int hash) const { return hash % BUCKETS; }
-
-int ChainHashMap::hash(const std::string &s) const {
-  /**
-   * Polynomial hashing.
-   * h = ( s[0] + s[1] * p + s[2] * p^2 + s[3] * p^3 + ... ) % mod.
-   */
-  const int p = 97;
-  const long long int mod = 1e9 + 7;
-  long long h = 0;
-  long long pow = 1;
-  for (char c : s) {
-    h += ((c - '!' + 1) * pow) % mod;
-    h %= mod;
-    pow *= p;
-    pow %= mod;
+MapStats ChainHashMap::stats() const {
+  MapStats s;
+  s.size = size();
+  for (const Node *node : hashMap) {
+    unsigned n = 0;
+    for (; node != nullptr; node = node->next) {
+      ++n;
+    }
+    s.addBucket(n);
   }
-  return h;
+  return s;
 }
 
-ChainHashMap::~ChainHashMap() {}
\ No newline at end of file
+int ChainHashMap::getIndex(const uint64_t hash) const {
+  return hash & (BUCKETS - 1);
+}
+
+uint32_t ChainHashMap::getTag(const uint64_t hash) { return hash >> 32; }
+
+uint64_t ChainHashMap::hash(std::string_view s) const { return hasher(s); }
+
+ChainHashMap::~ChainHashMap() {
+  for (Node *node : hashMap) {
+    while (node != nullptr) {
+      Node *next = node->next;
+      SlabAllocator::deallocate(node, sizeof(Node) + node->length);
+      node = next;
+    }
+  }
+}
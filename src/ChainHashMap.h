@@ -1,7 +1,7 @@
 #ifndef CHAIN_HASH_MAP_H
 #define CHAIN_HASH_MAP_H
 #include "AbstractHashMap.h"
-#include <list>
+#include "Hasher.h"
 #include <vector>
 
 /**
@@ -11,35 +11,65 @@ class ChainHashMap : public AbstractHashMap {
 
 public:
   // Constructor.
-  ChainHashMap();
+  ChainHashMap(Hasher = wyHash);
 
   // Insertion.
-  bool insert(std::string);
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
 
   // Search.
-  bool search(std::string) const;
+  bool search(std::string_view) const;
 
   // Deletion.
-  bool remove(std::string);
+  bool remove(std::string_view);
+
+  // Batched search, see AbstractHashMap.
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
 
   // Size.
   int size() const;
 
+  // Chain lengths and hash quality, see AbstractHashMap.
+  MapStats stats() const;
+
   // Destructor.
   ~ChainHashMap();
 
 private:
-  // Totat number of initial buckets for hash map.
+  // Totat number of initial buckets for hash map, a power of two.
   // For 1e7 elements, avg bucket size would be 10.
   const int BUCKETS = 1024 * 1024;
 
-  // The hash map data structure behind the scenes.
-  std::vector<std::list<std::string>> hashMap;
+  // The hash function.
+  Hasher hasher;
+
+  // A chain node and its key bytes, in a single SlabAllocator block.
+  struct Node {
+    Node *next;
+    uint32_t length;
+    // High half of the key's hash, compared before the key bytes.
+    uint32_t tag;
+
+    std::string_view key() const {
+      return std::string_view(reinterpret_cast<const char *>(this + 1),
+                              length);
+    }
+  };
+
+  // The hash map data structure behind the scenes, one chain per bucket.
+  std::vector<Node *> hashMap;
+
+  // Find the link pointing at the node of a key with the given hash, or at
+  // the end of the chain.
+  Node **find(Node **link, std::string_view, uint64_t hash) const;
+
+  // Tag of a hash.
+  static uint32_t getTag(const uint64_t hash);
 
   // A utility method to compute the hash of a given string.
-  int hash(const std::string &) const;
+  uint64_t hash(std::string_view) const;
 
   // A utility method to compute the index of a hash in the hash map.
-  int getIndex(const int hash) const;
+  int getIndex(const uint64_t hash) const;
 };
 #endif // CHAIN_HASH_MAP_H
\ No newline at end of file
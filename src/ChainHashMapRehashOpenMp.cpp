@@ -1,12 +1,24 @@
 #include "ChainHashMapRehashOpenMp.h"
+#include "BulkLoad.h"
+#include "EpochManager.h"
 #include <algorithm>
+#include <chrono>
 #include <iterator>
 #include <iostream>
 #include <omp.h>
 #include <mutex>
 #include <thread>
 
-ChainHashMapRehashOpenMp::ChainHashMapRehashOpenMp(float loadFactor, int BUCKETS, int MAX_CAPACITY) : AbstractHashMap() {
+ChainHashMapRehashOpenMp::Table::Table(int buckets)
+    : buckets(buckets), hashMap(buckets), mutexArr(buckets),
+      moved(new std::atomic<bool>[buckets]), next(nullptr), transferIndex(0),
+      migrated(0), helpers(0) {
+  for (int i = 0; i < buckets; ++i) {
+    moved[i].store(false, std::memory_order_relaxed);
+  }
+}
+
+ChainHashMapRehashOpenMp::ChainHashMapRehashOpenMp(float loadFactor, int BUCKETS, int MAX_CAPACITY, ResizeMode mode, Hasher hasher) : AbstractHashMap(), contention(CONTENTION_STRIPES) {
   if (loadFactor < 0 or loadFactor > 1) {
     std::__throw_out_of_range("load factor value is out of range.");
   }
@@ -18,141 +30,537 @@ ChainHashMapRehashOpenMp::ChainHashMapRehashOpenMp(float loadFactor, int BUCKETS
   }
   this->loadFactor = loadFactor;
   this->count = 0;
-  this->BUCKETS = BUCKETS;
+  // Round the number of buckets up to a power of two so that the index of a
+  // hash is a mask.
+  int buckets = 1;
+  while (buckets < BUCKETS) {
+    buckets *= 2;
+  }
+  this->BUCKETS = buckets;
   this->MAX_CAPACITY = MAX_CAPACITY;
-  hashMap = std::vector<std::vector<std::string>>(getBuckets());
-  mutexArr = std::vector<std::mutex>(BUCKETS);
+  minBuckets = buckets;
+  minCapacity = MAX_CAPACITY;
+  autoShrink = true;
+  this->hasher = hasher;
+  this->mode = mode;
+  table = new Table(getBuckets());
   isRehashing = false;
 }
 
 
-bool ChainHashMapRehashOpenMp::insert(std::string key) {
-  // If current loadFactor greater than desired, call rehash
-  // std::lock_guard<std::mutex> g(globalMutex); // Lock global lock
-  // Spin-wait if rehahsing is happening
-  while (isRehashing) {
-    std::this_thread::yield();
-  }
-
-  // Now lock to check size and trigger rehash safely
-  if (size() + 1 > getLoadFactor() * getMaxCapacity()) {
-    std::lock_guard<std::mutex> lock(rehashMutex);
-    if (size() + 1 > getLoadFactor() * getMaxCapacity()) { 
-      rehash();
-    }
-  }
-
-  const int index = getIndex(hash(key));
-  std::lock_guard<std::mutex> lk(mutexArr[index]);
-  hashMap[index].push_back(key);
+bool ChainHashMapRehashOpenMp::insert(std::string &&key) {
+  EpochManager::Guard guard;
+  Table *t = prepareInsert(1);
+  const uint64_t h = hash(key);
+  insertKey(t, std::move(key), h);
   ++count;
   return true;
 }
 
-bool ChainHashMapRehashOpenMp::search(std::string key) const {
-  // std::lock_guard<std::mutex> g(globalMutex); // Lock global lock
-  const int index = getIndex(hash(key));
-  return std::find(hashMap[index].begin(), hashMap[index].end(), key) != hashMap[index].end();
+bool ChainHashMapRehashOpenMp::search(std::string_view key) const {
+  EpochManager::Guard guard;
+  return searchKey(table.load(), key, hash(key));
 }
 
 
-bool ChainHashMapRehashOpenMp::remove(std::string key) {
-  // std::lock_guard<std::mutex> g(globalMutex); // Lock global lock
-  const int index = getIndex(hash(key));
-  std::lock_guard<std::mutex> lk(mutexArr[index]);
-  std::vector<std::string>::iterator it =
-      std::find(hashMap[index].begin(), hashMap[index].end(), key);
+bool ChainHashMapRehashOpenMp::remove(std::string_view key) {
+  EpochManager::Guard guard;
+  Table *t = table.load();
+  if (mode == COOPERATIVE) {
+    helpTransfer(t);
+  }
   // Do nothing if the key doesn't exist.
-  if (it == hashMap[index].end()) {
+  if (!removeKey(t, key, hash(key))) {
     return false;
   }
-  // Else lock the bucket and erase the element at it.
-  
-  hashMap[index].erase(it);
   --count;
+  maybeShrink(t);
   return true;
 }
 
-void ChainHashMapRehashOpenMp::rehash() {
-  // Try to acquire rehash lock without blocking others unnecessarily
-  {
-      std::unique_lock<std::mutex> lock(rehashMutex, std::try_to_lock);
-      if (!lock.owns_lock() || isRehashing) {
-          // Another thread is already rehashing
-          return;
+void ChainHashMapRehashOpenMp::insertBatch(std::string *keys, int n,
+                                           bool *results) {
+  EpochManager::Guard guard;
+  Table *t = prepareInsert(n);
+  std::vector<uint64_t> h(n);
+  for (int i = 0; i < n; ++i) {
+    h[i] = hash(keys[i]);
+    __builtin_prefetch(&t->hashMap[getIndex(h[i], t->buckets)]);
+  }
+  for (int i = 0; i < n; ++i) {
+    t->hashMap[getIndex(h[i], t->buckets)].prefetch();
+  }
+  const std::vector<int> order = orderByBucket(h.data(), n, t->buckets - 1);
+  for (int j = 0; j < n;) {
+    const int index = getIndex(h[order[j]], t->buckets);
+    int end = j;
+    while (end < n && getIndex(h[order[end]], t->buckets) == index) {
+      ++end;
+    }
+    contention.lock(t->mutexArr[index], index);
+    std::unique_lock<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+    const bool moved = t->moved[index].load(std::memory_order_relaxed);
+    if (moved) {
+      // The keys of the bucket are split over two buckets of the next table.
+      lk.unlock();
+    }
+    for (; j < end; ++j) {
+      const int i = order[j];
+      if (moved) {
+        insertKey(t, std::move(keys[i]), h[i]);
+      } else {
+        t->hashMap[index].push(std::move(keys[i]), h[i]);
       }
-      isRehashing = true;
+      results[i] = true;
+    }
+  }
+  count += n;
+}
+
+void ChainHashMapRehashOpenMp::searchBatch(const std::string_view *keys, int n,
+                                           bool *results) const {
+  EpochManager::Guard guard;
+  Table *t = table.load();
+  uint64_t h[BATCH_CHUNK];
+  for (int base = 0; base < n; base += BATCH_CHUNK) {
+    const int m = std::min(BATCH_CHUNK, n - base);
+    // Overlap the misses on the buckets, then on their entry arrays.
+    for (int i = 0; i < m; ++i) {
+      h[i] = hash(keys[base + i]);
+      __builtin_prefetch(&t->hashMap[getIndex(h[i], t->buckets)]);
+    }
+    for (int i = 0; i < m; ++i) {
+      t->hashMap[getIndex(h[i], t->buckets)].prefetch(h[i]);
+    }
+    for (int i = 0; i < m; ++i) {
+      results[base + i] = searchKey(t, keys[base + i], h[i]);
+    }
+  }
+}
+
+void ChainHashMapRehashOpenMp::removeBatch(const std::string_view *keys, int n,
+                                           bool *results) {
+  EpochManager::Guard guard;
+  Table *t = table.load();
+  if (mode == COOPERATIVE) {
+    helpTransfer(t);
+  }
+  std::vector<uint64_t> h(n);
+  for (int i = 0; i < n; ++i) {
+    h[i] = hash(keys[i]);
+    __builtin_prefetch(&t->hashMap[getIndex(h[i], t->buckets)]);
+  }
+  for (int i = 0; i < n; ++i) {
+    t->hashMap[getIndex(h[i], t->buckets)].prefetch();
+  }
+  const std::vector<int> order = orderByBucket(h.data(), n, t->buckets - 1);
+  int removed = 0;
+  for (int j = 0; j < n;) {
+    const int index = getIndex(h[order[j]], t->buckets);
+    int end = j;
+    while (end < n && getIndex(h[order[end]], t->buckets) == index) {
+      ++end;
+    }
+    contention.lock(t->mutexArr[index], index);
+    std::unique_lock<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+    const bool moved = t->moved[index].load(std::memory_order_relaxed);
+    if (moved) {
+      lk.unlock();
+    }
+    for (; j < end; ++j) {
+      const int i = order[j];
+      results[i] = moved ? removeKey(t, keys[i], h[i])
+                         : t->hashMap[index].erase(keys[i], h[i]);
+      removed += results[i];
+    }
+  }
+  count -= removed;
+  maybeShrink(t);
+}
+
+ChainHashMapRehashOpenMp::Table *ChainHashMapRehashOpenMp::prepareInsert(int n) {
+  // If current loadFactor greater than desired, start a resize. Writers never
+  // wait for it: in COOPERATIVE mode every write moves one chunk, in
+  // STOP_THE_WORLD mode the thread which started the resize moves them all.
+  Table *t = table.load();
+  if (size() + n > getLoadFactor() * getMaxCapacity()) {
+    if (startResize(t) && mode == STOP_THE_WORLD) {
+      transferAll(t);
+      t = table.load();
+    }
   }
+  if (mode == COOPERATIVE) {
+    helpTransfer(t);
+  }
+  return t;
+}
+
+void ChainHashMapRehashOpenMp::insertKey(Table *t, std::string &&key,
+                                         uint64_t h) {
+  while (true) {
+    const int index = getIndex(h, t->buckets);
+    contention.lock(t->mutexArr[index], index);
+    std::unique_lock<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+    // The bucket now lives in the next table.
+    if (t->moved[index].load(std::memory_order_relaxed)) {
+      lk.unlock();
+      t = t->next.load();
+      continue;
+    }
+    t->hashMap[index].push(std::move(key), h);
+    return;
+  }
+}
+
+bool ChainHashMapRehashOpenMp::searchKey(Table *t, std::string_view key,
+                                         uint64_t h) const {
+  int index = getIndex(h, t->buckets);
+  // Follow migrated buckets to the table they were copied to.
+  while (t->moved[index].load()) {
+    t = t->next.load();
+    index = getIndex(h, t->buckets);
+  }
+  return t->hashMap[index].contains(key, h);
+}
+
+bool ChainHashMapRehashOpenMp::removeKey(Table *t, std::string_view key,
+                                         uint64_t h) {
+  while (true) {
+    const int index = getIndex(h, t->buckets);
+    contention.lock(t->mutexArr[index], index);
+    std::unique_lock<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+    if (t->moved[index].load(std::memory_order_relaxed)) {
+      lk.unlock();
+      t = t->next.load();
+      continue;
+    }
+    return t->hashMap[index].erase(key, h);
+  }
+}
+
+void ChainHashMapRehashOpenMp::bulkLoad(const std::string_view *keys,
+                                        size_t n, int threads) {
+  EpochManager::Guard guard;
+  if (threads <= 0) {
+    threads = omp_get_max_threads();
+  }
+  // Grow once to the final size rather than doubling along the way, every
+  // doubling moving all keys inserted so far.
+  while (true) {
+    Table *t = table.load();
+    if (t->next.load() != nullptr) {
+      transferAll(t);
+      continue;
+    }
+    int steps = 0;
+    while (size() + n > getLoadFactor() * double(getMaxCapacity()) * (1 << steps) &&
+           (getBuckets() << steps) < (1 << 30)) {
+      ++steps;
+    }
+    if (steps == 0) {
+      break;
+    }
+    if (startResize(t, true, steps)) {
+      transferAll(t);
+    }
+  }
+  Table *t = table.load();
+  BulkLoad::load(
+      keys, n, hasher, t->buckets,
+      [this, t](uint64_t h) { return uint64_t(getIndex(h, t->buckets)); },
+      [t](uint64_t b) -> VersionedBucket & { return t->hashMap[b]; }, threads,
+      [threads](int tasks, auto fn) {
+        #pragma omp parallel for num_threads(threads) schedule(dynamic)
+        for (int i = 0; i < tasks; ++i) {
+          fn(i);
+        }
+      });
+  count += n;
+}
+
+ChainHashMapRehashOpenMp::Iterator::Iterator()
+    : map(nullptr), t(nullptr), index(0), pos(0) {}
+
+ChainHashMapRehashOpenMp::Iterator::Iterator(const ChainHashMapRehashOpenMp *map)
+    : guard(new EpochManager::Guard()), map(map), t(map->table.load()),
+      index(0), pos(0) {
+  fill();
+}
+
+ChainHashMapRehashOpenMp::Iterator &ChainHashMapRehashOpenMp::Iterator::operator++() {
+  if (++pos == keys.size()) {
+    fill();
+  }
+  return *this;
+}
 
-  // Double capacity under lock
-  int oldBuckets, newBuckets;
+void ChainHashMapRehashOpenMp::Iterator::fill() {
+  keys.clear();
+  pos = 0;
+  while (keys.empty() && index < t->buckets) {
+    map->collectBucket(t, index++, keys);
+  }
+  if (keys.empty()) {
+    map = nullptr;
+    guard.reset();
+  }
+}
+
+ChainHashMapRehashOpenMp::Iterator ChainHashMapRehashOpenMp::begin() const {
+  return Iterator(this);
+}
+
+ChainHashMapRehashOpenMp::Iterator ChainHashMapRehashOpenMp::end() const {
+  return Iterator();
+}
+
+void ChainHashMapRehashOpenMp::parallel_for_each(
+    const std::function<void(std::string_view)> &fn, int threads) const {
+  if (threads <= 0) {
+    threads = omp_get_max_threads();
+  }
+  EpochManager::Guard guard;
+  const Table *t = table.load();
+  const int chunks = (t->buckets + SCAN_CHUNK - 1) / SCAN_CHUNK;
+  #pragma omp parallel num_threads(threads)
   {
-      std::lock_guard<std::mutex> lock(rehashMutex);
-      oldBuckets = getBuckets();
-      doubleBuckets();
-      doubleCapacity();
-      newBuckets = getBuckets();
+    EpochManager::Guard threadGuard;
+    std::vector<VersionedBucket::KeyView> keys;
+    #pragma omp for schedule(dynamic)
+    for (int c = 0; c < chunks; ++c) {
+      const int end = std::min(t->buckets, (c + 1) * SCAN_CHUNK);
+      for (int i = c * SCAN_CHUNK; i < end; ++i) {
+        keys.clear();
+        collectBucket(t, i, keys);
+        for (const VersionedBucket::KeyView &k : keys) {
+          fn(k.key);
+        }
+      }
+    }
+  }
+}
+
+void ChainHashMapRehashOpenMp::collectBucket(
+    const Table *t, int index, std::vector<VersionedBucket::KeyView> &out) const {
+  const size_t start = out.size();
+  // A moved bucket still points at its keys, but next owns them and may
+  // have freed them before our guard was taken, so it is never copied.
+  // Until it is marked moved, its keys can only be retired under our guard.
+  if (!t->moved[index].load(std::memory_order_acquire)) {
+    t->hashMap[index].snapshot(out);
+    // Buckets are moved after they were copied to next, so a copy taken
+    // while the bucket was not yet marked moved is complete.
+    if (!t->moved[index].load()) {
+      return;
+    }
+    out.resize(start);
+  }
+  const Table *next = t->next.load();
+  if (next->buckets > t->buckets) {
+    for (int j = index; j < next->buckets; j += t->buckets) {
+      collectBucket(next, j, out);
+    }
+  } else {
+    // Halving, the next bucket also holds the keys of another old bucket.
+    collectBucket(next, getIndex(index, next->buckets), out);
+    out.erase(std::remove_if(out.begin() + start, out.end(),
+                             [&](const VersionedBucket::KeyView &k) {
+                               return getIndex(k.hash, t->buckets) != index;
+                             }),
+              out.end());
+  }
+}
+
+void ChainHashMapRehashOpenMp::rehash() {
+  EpochManager::Guard guard;
+  while (true) {
+    Table *t = table.load();
+    Table *next = t->next.load();
+    if (next == nullptr) {
+      if (startResize(t)) {
+        transferAll(t);
+        return;
+      }
+      continue;
+    }
+    // Join the running resize; if it is a shrink, double afterwards.
+    transferAll(t);
+    if (next->buckets > t->buckets) {
+      return;
+    }
+  }
+}
+
+void ChainHashMapRehashOpenMp::shrink_to_fit() {
+  EpochManager::Guard guard;
+  while (true) {
+    Table *t = table.load();
+    if (t->next.load() != nullptr) {
+      // Let a running resize finish first.
+      transferAll(t);
+    } else if (!shouldShrink()) {
+      return;
+    } else if (startResize(t, false)) {
+      transferAll(t);
+    }
+  }
+}
+
+void ChainHashMapRehashOpenMp::setAutoShrink(bool enabled) {
+  autoShrink = enabled;
+}
+
+bool ChainHashMapRehashOpenMp::shouldShrink() const {
+  return getBuckets() > minBuckets && getMaxCapacity() > minCapacity &&
+         size() < getLoadFactor() * getMaxCapacity() / 4;
+}
+
+void ChainHashMapRehashOpenMp::maybeShrink(Table *t) {
+  if (autoShrink && shouldShrink() && startResize(t, false) &&
+      mode == STOP_THE_WORLD) {
+    transferAll(t);
   }
+}
 
-  // Create new hash map structure
-  std::vector<std::vector<std::string>> newHashMap(newBuckets);
-  
-  // Parallel rehashing with OpenMP
+void ChainHashMapRehashOpenMp::transferAll(Table *t) {
+  // Parallel rehashing with OpenMP, each thread claims chunks of the old
+  // buckets until none are left.
   #pragma omp parallel
   {
-      // Each thread processes a portion of the old buckets
-      #pragma omp for schedule(dynamic)
-      for (int i = 0; i < oldBuckets; ++i) {
-          // Lock the old bucket while reading
-          std::lock_guard<std::mutex> oldLock(mutexArr[i]);
-          
-          // Create local copy of this bucket's contents
-          auto bucketCopy = hashMap[i];
-          
-          // Release old bucket lock before working with new buckets
-          oldLock.~lock_guard(); // Manual destruction to release early
-          
-          for (const auto &key : bucketCopy) {
-              int newIndex = getIndex(hash(key));
-              
-              // Lock the new bucket while writing
-              std::lock_guard<std::mutex> newLock(mutexArr[newIndex]);
-              newHashMap[newIndex].push_back(key);
-          }
+      while (helpTransfer(t)) {
       }
   }
 
-  // Final update under lock
-  {
-      std::lock_guard<std::mutex> lock(rehashMutex);
-      hashMap = std::move(newHashMap);
-      isRehashing = false;
+  // Chunks claimed by other threads may still be in flight.
+  while (table.load() == t) {
+      if (!helpTransfer(t)) {
+          std::this_thread::yield();
+      }
+  }
+}
+
+bool ChainHashMapRehashOpenMp::startResize(Table *t, bool grow, int steps) {
+  bool expected = false;
+  if (!isRehashing.compare_exchange_strong(expected, true)) {
+    return false;
+  }
+  // The table may have been replaced while we were racing for the flag.
+  if (table.load() != t) {
+    isRehashing = false;
+    return false;
+  }
+  // The size may have changed while we were racing for the flag, too.
+  if (!grow && !shouldShrink()) {
+    isRehashing = false;
+    return false;
   }
+  if (grow) {
+    for (int i = 0; i < steps; ++i) {
+      doubleBuckets();
+      doubleCapacity();
+    }
+  } else {
+    halveBuckets();
+    halveCapacity();
+  }
+  Table *next = new Table(getBuckets());
+  t->resizeStart = std::chrono::steady_clock::now();
+  t->transferIndex.store(t->buckets);
+  t->next.store(next);
+  return true;
 }
 
+bool ChainHashMapRehashOpenMp::helpTransfer(Table *t) {
+  if (t->next.load() == nullptr) {
+    return false;
+  }
+  const int end = t->transferIndex.fetch_sub(TRANSFER_STRIDE);
+  if (end <= 0) {
+    return false;
+  }
+  // Count every thread once per resize.
+  static thread_local const Table *helped = nullptr;
+  if (helped != t) {
+    helped = t;
+    t->helpers.fetch_add(1);
+  }
+  const int begin = std::max(0, end - TRANSFER_STRIDE);
+  for (int i = begin; i < end; ++i) {
+    transferBucket(t, i);
+  }
+  if (t->migrated.fetch_add(end - begin) + (end - begin) == t->buckets) {
+    finishResize(t);
+  }
+  return true;
+}
 
-int ChainHashMapRehashOpenMp::size() const { return count; }
+void ChainHashMapRehashOpenMp::transferBucket(Table *t, int index) {
+  Table *next = t->next.load();
+  std::lock_guard<std::mutex> lk(t->mutexArr[index]);
+  auto target = [&](uint64_t h) -> VersionedBucket & {
+    return next->hashMap[getIndex(h, next->buckets)];
+  };
+  if (next->buckets > t->buckets) {
+    // No lock is needed on the new buckets: writers only reach them once
+    // this bucket is marked moved, and no other old bucket maps onto them.
+    t->hashMap[index].moveKeys(target);
+  } else {
+    // Halving, old buckets index and index + next->buckets share a new
+    // bucket, which writers may already use through the other one.
+    std::lock_guard<std::mutex> nlk(
+        next->mutexArr[getIndex(index, next->buckets)]);
+    t->hashMap[index].moveKeys(target);
+  }
+  t->moved[index].store(true);
+}
+
+void ChainHashMapRehashOpenMp::finishResize(Table *t) {
+  rehashLog.record(std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - t->resizeStart)
+                       .count(),
+                   t->helpers.load());
+  table.store(t->next.load());
+  isRehashing = false;
+  // Readers may still be walking the old buckets.
+  EpochManager::retire(t);
+}
 
-int ChainHashMapRehashOpenMp::getIndex(const int hash) const { return hash % getBuckets(); }
 
-int ChainHashMapRehashOpenMp::hash(const std::string &s) const {
-  /**
-   * Polynomial hashing.
-   * h = ( s[0] + s[1] * p + s[2] * p^2 + s[3] * p^3 + ... ) % mod.
-   */
-  const int p = 97;
-  const long long int mod = 1e9 + 7;
-  long long h = 0;
-  long long pow = 1;
-  for (char c : s) {
-    h += ((c - '!' + 1) * pow) % mod;
-    h %= mod;
-    pow *= p;
-    pow %= mod;
+int ChainHashMapRehashOpenMp::size() const { return count; }
+
+MapStats ChainHashMapRehashOpenMp::stats() const {
+  EpochManager::Guard guard;
+  const Table *t = table.load();
+  MapStats s;
+  s.size = size();
+  // During a resize a bucket's keys are either in t or, once it is marked
+  // moved, in the buckets of the next table it maps to: i, i + t->buckets...
+  // when growing, i alone when halving.
+  const Table *next = t->next.load();
+  for (int i = 0; i < t->buckets; ++i) {
+    if (next == nullptr || !t->moved[i].load()) {
+      s.addBucket(t->hashMap[i].size());
+    } else if (next->buckets > t->buckets) {
+      for (int j = i; j < next->buckets; j += t->buckets) {
+        s.addBucket(next->hashMap[j].size());
+      }
+    } else if (i < next->buckets) {
+      s.addBucket(next->hashMap[i].size());
+    }
   }
-  return h;
+  s.contention = contention.counts();
+  rehashLog.fill(s);
+  return s;
 }
 
+void ChainHashMapRehashOpenMp::collectStats(bool enabled) {
+  contention.enable(enabled);
+}
+
+int ChainHashMapRehashOpenMp::getIndex(const uint64_t hash, const int buckets) const { return hash & (buckets - 1); }
+
+uint64_t ChainHashMapRehashOpenMp::hash(std::string_view s) const { return hasher(s); }
+
 float ChainHashMapRehashOpenMp::getLoadFactor() const {
   return loadFactor;
 }
@@ -166,11 +574,23 @@ int ChainHashMapRehashOpenMp::getMaxCapacity() const {
 }
 
 void ChainHashMapRehashOpenMp::doubleBuckets() {
-  BUCKETS *= 2;
+  BUCKETS = BUCKETS * 2;
 }
 
 void ChainHashMapRehashOpenMp::doubleCapacity() {
-  MAX_CAPACITY *= 2;
+  MAX_CAPACITY = MAX_CAPACITY * 2;
 }
 
-ChainHashMapRehashOpenMp::~ChainHashMapRehashOpenMp() {}
\ No newline at end of file
+void ChainHashMapRehashOpenMp::halveBuckets() {
+  BUCKETS = BUCKETS / 2;
+}
+
+void ChainHashMapRehashOpenMp::halveCapacity() {
+  MAX_CAPACITY = MAX_CAPACITY / 2;
+}
+
+ChainHashMapRehashOpenMp::~ChainHashMapRehashOpenMp() {
+  Table *t = table.load();
+  delete t->next.load();
+  delete t;
+}
@@ -1,53 +1,275 @@
-#ifndef CHAIN_HASH_MAP_REHASH_H
-#define CHAIN_HASH_MAP_REHASH_H
+#ifndef CHAIN_HASH_MAP_REHASH_OPEN_MP_H
+#define CHAIN_HASH_MAP_REHASH_OPEN_MP_H
 #include "AbstractHashMap.h"
+#include "BucketLocks.h"
+#include "EpochManager.h"
+#include "Hasher.h"
+#include "VersionedBucket.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
 #include <list>
+#include <memory>
 #include <vector>
 #include <mutex>
 
 class ChainHashMapRehashOpenMp : public AbstractHashMap {
+  // One generation of the hash map, defined below.
+  struct Table;
 
 public:
-  ChainHashMapRehashOpenMp(float, int, int); //loadFactor, BUCKETS, MAX_CAPACITY
-  bool insert(std::string);
-  bool search(std::string) const;
-  bool remove(std::string);
-  // Re-hashing
+  // How the buckets are moved to the doubled table once the load factor is
+  // exceeded.
+  enum ResizeMode {
+    // The thread which crosses the load factor migrates the whole table with
+    // an OpenMP team.
+    STOP_THE_WORLD,
+    // Old and new tables coexist and every write migrates at most one chunk
+    // of buckets until the resize is done, bounding the latency of any
+    // single operation.
+    COOPERATIVE
+  };
+
+  /**
+   * A weakly consistent iterator over the keys. It never blocks writers and
+   * runs alongside insertions, removals and resizes: every key present for
+   * the whole iteration is visited exactly once, keys inserted or removed
+   * meanwhile may or may not be. Each bucket is copied in one consistent
+   * version, so no key is ever torn.
+   *
+   * The iterator holds an EpochManager::Guard, memory retired meanwhile is
+   * only freed once it is destroyed. Use and destroy it on one thread, and
+   * don't keep it around.
+   */
+  class Iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view *;
+    using reference = const std::string_view &;
+
+    // The current key, valid until the iterator is destroyed.
+    const std::string_view &operator*() const { return keys[pos].key; }
+    const std::string_view *operator->() const { return &keys[pos].key; }
+
+    // Advance to the next key.
+    Iterator &operator++();
+
+    // Iterators only compare equal once both are at the end.
+    bool operator==(const Iterator &other) const {
+      return atEnd() == other.atEnd();
+    }
+    bool operator!=(const Iterator &other) const { return !(*this == other); }
+
+  private:
+    friend class ChainHashMapRehashOpenMp;
+
+    // The end iterator.
+    Iterator();
+
+    // An iterator at the first key of map.
+    explicit Iterator(const ChainHashMapRehashOpenMp *map);
+
+    // Copy the keys of the next non-empty bucket.
+    void fill();
+
+    bool atEnd() const { return map == nullptr; }
+
+    // Keeps the tables and keys alive.
+    std::unique_ptr<EpochManager::Guard> guard;
+
+    // nullptr once at the end.
+    const ChainHashMapRehashOpenMp *map;
+
+    // The table being walked, the current one when the iteration began.
+    const Table *t;
+
+    // Next bucket of t to copy.
+    int index;
+
+    // Keys of the current bucket, and the position in them.
+    std::vector<VersionedBucket::KeyView> keys;
+    size_t pos;
+  };
+
+  ChainHashMapRehashOpenMp(float, int, int, ResizeMode = STOP_THE_WORLD, Hasher = wyHash); //loadFactor, BUCKETS, MAX_CAPACITY, resize mode, hash function
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
+  bool search(std::string_view) const;
+  bool remove(std::string_view);
+  // Batched operations, see AbstractHashMap. Writers check the load factor
+  // and help a cooperative resize once per batch.
+  void insertBatch(std::string *keys, int n, bool *results);
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
+  void removeBatch(const std::string_view *keys, int n, bool *results);
+  // Insert n keys on threads threads (0: the OpenMP default) without
+  // locking. The table is first grown once, straight to a size holding all
+  // keys; the keys are then partitioned by bucket and every bucket is filled
+  // by one thread, see BulkLoad.h. No writer may run meanwhile, searches may.
+  // Like insert(), does not check for keys already in the map.
+  void bulkLoad(const std::string_view *keys, size_t n, int threads = 0);
+  // Weakly consistent iteration over the keys, see Iterator.
+  Iterator begin() const;
+  Iterator end() const;
+  // Call fn(key) for every key with the same guarantees as Iterator, the
+  // buckets being split over threads threads (0: the OpenMP default). fn is
+  // called concurrently from several threads and must not write to the map.
+  void parallel_for_each(const std::function<void(std::string_view)> &fn,
+                         int threads = 0) const;
+  // Re-hashing, returns once the table has been doubled.
   void rehash();
+  // Halve the table while the size is below a quarter of the resize
+  // threshold, down to the initial number of buckets.
+  void shrink_to_fit();
+  // Whether removals halve the table once the size falls below a quarter of
+  // the resize threshold, on by default. The halved table is at most half
+  // full, so shrinking never triggers an immediate regrow.
+  void setAutoShrink(bool);
   int size() const;
+  // Chain lengths, hash quality, bucket lock contention and resize timings,
+  // see AbstractHashMap. Contention is counted per group of buckets,
+  // bucket b in stripe b % CONTENTION_STRIPES.
+  MapStats stats() const;
+  void collectStats(bool);
   float getLoadFactor() const; // To get loadFactor to determine if re-hashing needed
   int getBuckets() const;
   int getMaxCapacity() const;
   void doubleBuckets();
   void doubleCapacity();
+  void halveBuckets();
+  void halveCapacity();
   ~ChainHashMapRehashOpenMp();
 
 private:
+  // Number of buckets a thread migrates in one go.
+  static const int TRANSFER_STRIDE = 16;
+
+  /**
+   * One generation of the hash map. During a resize the current table points
+   * to the next one, half as large or a power of two times larger, and buckets are moved over chunk
+   * by chunk; a bucket which has been moved is marked so and all writes to it
+   * go to next.
+   */
+  struct Table {
+    explicit Table(int);
+
+    // Number of buckets.
+    const int buckets;
+
+    // The hash map data structure behind the scenes. Searches are lock-free
+    // and validated with the bucket's version.
+    std::vector<VersionedBucket> hashMap;
+
+    // Locks to protect access to each of the buckets.
+    std::vector<std::mutex> mutexArr;
+
+    // Whether a bucket has already been migrated to next.
+    std::unique_ptr<std::atomic<bool>[]> moved;
+
+    // The table being migrated to, nullptr when no resize is running.
+    std::atomic<Table *> next;
+
+    // Buckets below this index still have to be handed out for migration.
+    std::atomic<int> transferIndex;
+
+    // Number of buckets migrated so far.
+    std::atomic<int> migrated;
+
+    // When the resize to next started.
+    std::chrono::steady_clock::time_point resizeStart;
+
+    // Number of threads which migrated buckets to next.
+    std::atomic<int> helpers;
+  };
+
   // A value between 0 and 1(inclusive) to determine the load at which a
   // hash map should resize.
   float loadFactor;
-  int BUCKETS;
-  int MAX_CAPACITY;
+  // Number of buckets, always a power of two.
+  std::atomic<int> BUCKETS;
+  std::atomic<int> MAX_CAPACITY;
+
+  // Initial BUCKETS and MAX_CAPACITY, the table never shrinks below them.
+  int minBuckets;
+  int minCapacity;
+
+  std::atomic<bool> autoShrink;
+
+  // The hash function.
+  Hasher hasher;
+
+  // Number of contention counters.
+  static const int CONTENTION_STRIPES = 4096;
+
+  // Contended bucket lock acquisitions, when collected.
+  ContentionCounters contention;
+
+  // Number and durations of the resizes.
+  RehashLog rehashLog;
+  ResizeMode mode;
+
+  // The current table.
+  std::atomic<Table *> table;
+
+  // Set while a resize is being started or running.
+  std::atomic<bool> isRehashing;
+
+  // Start or help a resize before an insertion of n keys. Returns the table
+  // to write to.
+  Table *prepareInsert(int n);
+
+  // Insert a key into the bucket of h, starting at t and following moved
+  // buckets. Caller holds an EpochManager::Guard.
+  void insertKey(Table *t, std::string &&key, uint64_t h);
+
+  // Search the bucket of h, starting at t and following moved buckets.
+  // Caller holds an EpochManager::Guard.
+  bool searchKey(Table *t, std::string_view key, uint64_t h) const;
+
+  // Remove a key from the bucket of h, starting at t and following moved
+  // buckets. Caller holds an EpochManager::Guard.
+  bool removeKey(Table *t, std::string_view key, uint64_t h);
+
+  // Allocate the doubled (or halved) table and publish it as t's next table;
+  // a growing table may be doubled several times, steps times, at once.
+  // Returns false if another thread already started a resize.
+  bool startResize(Table *t, bool grow = true, int steps = 1);
+
+  // Whether the table is sparse enough to be halved.
+  bool shouldShrink() const;
+
+  // Start halving t if it should shrink, after a removal. Caller holds an
+  // EpochManager::Guard.
+  void maybeShrink(Table *t);
+
+  // Claim one chunk of t's buckets and migrate it. Returns false if there was
+  // nothing left to claim.
+  bool helpTransfer(Table *t);
 
-  // The hash map data structure behind the scenes.
-  std::vector<std::vector<std::string>> hashMap;
+  // Migrate every bucket of t with an OpenMP team and wait for the resize to
+  // finish.
+  void transferAll(Table *t);
 
-  // mutex for each bucket
-  std::vector<std::mutex> bucketLocks;
+  // Move the keys of one bucket of t to t->next and mark it moved.
+  void transferBucket(Table *t, int index);
 
-  // Locks to protect access to each of the buckets.
-  mutable std::vector<std::mutex> mutexArr;
+  // Make t->next the current table and retire t.
+  void finishResize(Table *t);
 
-  // global rehash lock
-  std::mutex rehashMutex;
+  // Number of buckets scanned by one task of parallel_for_each().
+  static const int SCAN_CHUNK = 1024;
 
-  // rehash flag
-  bool isRehashing = false;
+  // Append the keys of bucket index of t to out, following the bucket to
+  // the next tables if it was moved. Caller holds an EpochManager::Guard.
+  void collectBucket(const Table *t, int index,
+                     std::vector<VersionedBucket::KeyView> &out) const;
 
   // A utility method to compute the hash of a given string.
-  int hash(const std::string &) const;
+  uint64_t hash(std::string_view) const;
 
-  // A utility method to compute the index of a hash in the hash map.
-  int getIndex(const int hash) const;
+  // A utility method to compute the index of a hash in a table.
+  int getIndex(const uint64_t hash, const int buckets) const;
 };
-#endif // CHAIN_HASH_MAP_REHASH_H
\ No newline at end of file
+#endif // CHAIN_HASH_MAP_REHASH_OPEN_MP_H
@@ -1,11 +1,17 @@
 #include "ChainHashMapRehashThreads.h"
+#include "EpochManager.h"
+#include "Snapshot.h"
 #include <algorithm>
+#include <chrono>
 #include <iterator>
 #include <iostream>
 #include <mutex>
 #include <thread>
 
-ChainHashMapRehashThreads::ChainHashMapRehashThreads(float loadFactor, int BUCKETS, int MAX_CAPACITY) : AbstractHashMap() {
+ChainHashMapRehashThreads::Table::Table(int buckets)
+    : buckets(buckets), hashMap(buckets), mutexArr(buckets) {}
+
+ChainHashMapRehashThreads::ChainHashMapRehashThreads(float loadFactor, int BUCKETS, int MAX_CAPACITY, Hasher hasher, int threads) : AbstractHashMap(), contention(CONTENTION_STRIPES), pool(threads) {
   if (loadFactor < 0 or loadFactor > 1) {
     std::__throw_out_of_range("load factor value is out of range.");
   }
@@ -17,120 +23,293 @@ ChainHashMapRehashThreads::ChainHashMapRehashThreads(float loadFactor, int BUCKE
   }
   this->loadFactor = loadFactor;
   this->count = 0;
-  this->BUCKETS = BUCKETS;
+  // Round the number of buckets up to a power of two so that the index of a
+  // hash is a mask.
+  int buckets = 1;
+  while (buckets < BUCKETS) {
+    buckets *= 2;
+  }
+  this->BUCKETS = buckets;
   this->MAX_CAPACITY = MAX_CAPACITY;
-  hashMap = std::vector<std::vector<std::string>>(getBuckets());
-  mutexArr = std::vector<std::mutex>(BUCKETS);
+  minBuckets = buckets;
+  minCapacity = MAX_CAPACITY;
+  autoShrink = true;
+  this->hasher = hasher;
+  table = new Table(getBuckets());
 }
 
 
-bool ChainHashMapRehashThreads::insert(std::string key) {
+bool ChainHashMapRehashThreads::insert(std::string &&key) {
   // If current loadFactor greater than desired, call rehash
-  // std::lock_guard<std::mutex> g(globalMutex); // Lock global lock
-
   // Now lock to check size and trigger rehash safely
   if (size() + 1 > getLoadFactor() * getMaxCapacity()) {
-    std::lock_guard<std::mutex> lock(rehashMutex);
-    if (size() + 1 > getLoadFactor() * getMaxCapacity()) { 
-      rehash();
+    std::unique_lock<std::shared_mutex> lock(rehashMutex);
+    if (size() + 1 > getLoadFactor() * getMaxCapacity()) {
+      resize(true);
     }
   }
 
-  const int index = getIndex(hash(key));
-  std::lock_guard<std::mutex> lk(mutexArr[index]);
-  hashMap[index].push_back(key);
+  std::shared_lock<std::shared_mutex> lock(rehashMutex);
+  Table *t = table.load();
+  const uint64_t h = hash(key);
+  const int index = getIndex(h, t->buckets);
+  contention.lock(t->mutexArr[index], index);
+  std::lock_guard<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+  t->hashMap[index].push(std::move(key), h);
   ++count;
   return true;
 }
 
-bool ChainHashMapRehashThreads::search(std::string key) const {
-  // std::lock_guard<std::mutex> g(globalMutex); // Lock global lock
-  const int index = getIndex(hash(key));
-  return std::find(hashMap[index].begin(), hashMap[index].end(), key) != hashMap[index].end();
+bool ChainHashMapRehashThreads::search(std::string_view key) const {
+  EpochManager::Guard guard;
+  Table *t = table.load();
+  const uint64_t h = hash(key);
+  const int index = getIndex(h, t->buckets);
+  return t->hashMap[index].contains(key, h);
 }
 
 
-bool ChainHashMapRehashThreads::remove(std::string key) {
-  // std::lock_guard<std::mutex> g(globalMutex); // Lock global lock
-  const int index = getIndex(hash(key));
-  std::lock_guard<std::mutex> lk(mutexArr[index]);
-  std::vector<std::string>::iterator it =
-      std::find(hashMap[index].begin(), hashMap[index].end(), key);
-  // Do nothing if the key doesn't exist.
-  if (it == hashMap[index].end()) {
-    return false;
+bool ChainHashMapRehashThreads::remove(std::string_view key) {
+  {
+    std::shared_lock<std::shared_mutex> lock(rehashMutex);
+    Table *t = table.load();
+    const uint64_t h = hash(key);
+    const int index = getIndex(h, t->buckets);
+    contention.lock(t->mutexArr[index], index);
+    std::lock_guard<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+    // Do nothing if the key doesn't exist.
+    if (!t->hashMap[index].erase(key, h)) {
+      return false;
+    }
+    --count;
   }
-  // Else lock the bucket and erase the element at it.
-  
-  hashMap[index].erase(it);
-  --count;
+  maybeShrink();
   return true;
 }
 
-void ChainHashMapRehashThreads::rehash() {
-    int oldBuckets = getBuckets();
-    auto oldHashMap = hashMap; // Only copy the old hashmap (not mutexes)
+void ChainHashMapRehashThreads::insertBatch(std::string *keys, int n,
+                                            bool *results) {
+  if (size() + n > getLoadFactor() * getMaxCapacity()) {
+    std::unique_lock<std::shared_mutex> lock(rehashMutex);
+    if (size() + n > getLoadFactor() * getMaxCapacity()) {
+      resize(true);
+    }
+  }
 
-    doubleBuckets();
-    doubleCapacity();
+  std::shared_lock<std::shared_mutex> lock(rehashMutex);
+  Table *t = table.load();
+  std::vector<uint64_t> h(n);
+  for (int i = 0; i < n; ++i) {
+    h[i] = hash(keys[i]);
+    __builtin_prefetch(&t->hashMap[getIndex(h[i], t->buckets)]);
+  }
+  for (int i = 0; i < n; ++i) {
+    t->hashMap[getIndex(h[i], t->buckets)].prefetch();
+  }
+  const std::vector<int> order = orderByBucket(h.data(), n, t->buckets - 1);
+  for (int j = 0; j < n;) {
+    const int index = getIndex(h[order[j]], t->buckets);
+    contention.lock(t->mutexArr[index], index);
+    std::lock_guard<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+    for (; j < n && getIndex(h[order[j]], t->buckets) == index; ++j) {
+      const int i = order[j];
+      t->hashMap[index].push(std::move(keys[i]), h[i]);
+      results[i] = true;
+    }
+  }
+  count += n;
+}
 
-    int newBuckets = getBuckets();
-    std::vector<std::vector<std::string>> newHashMap(newBuckets);
-    std::vector<std::mutex> newBucketLocks(newBuckets);
+void ChainHashMapRehashThreads::searchBatch(const std::string_view *keys, int n,
+                                            bool *results) const {
+  EpochManager::Guard guard;
+  Table *t = table.load();
+  uint64_t h[BATCH_CHUNK];
+  for (int base = 0; base < n; base += BATCH_CHUNK) {
+    const int m = std::min(BATCH_CHUNK, n - base);
+    // Overlap the misses on the buckets, then on their entry arrays.
+    for (int i = 0; i < m; ++i) {
+      h[i] = hash(keys[base + i]);
+      __builtin_prefetch(&t->hashMap[getIndex(h[i], t->buckets)]);
+    }
+    for (int i = 0; i < m; ++i) {
+      t->hashMap[getIndex(h[i], t->buckets)].prefetch(h[i]);
+    }
+    for (int i = 0; i < m; ++i) {
+      results[base + i] = t->hashMap[getIndex(h[i], t->buckets)].contains(
+          keys[base + i], h[i]);
+    }
+  }
+}
 
-    // Rebuild mutex array fresh
-    mutexArr = std::vector<std::mutex>(newBuckets);
+void ChainHashMapRehashThreads::removeBatch(const std::string_view *keys, int n,
+                                            bool *results) {
+  std::shared_lock<std::shared_mutex> lock(rehashMutex);
+  Table *t = table.load();
+  std::vector<uint64_t> h(n);
+  for (int i = 0; i < n; ++i) {
+    h[i] = hash(keys[i]);
+    __builtin_prefetch(&t->hashMap[getIndex(h[i], t->buckets)]);
+  }
+  for (int i = 0; i < n; ++i) {
+    t->hashMap[getIndex(h[i], t->buckets)].prefetch();
+  }
+  const std::vector<int> order = orderByBucket(h.data(), n, t->buckets - 1);
+  int removed = 0;
+  for (int j = 0; j < n;) {
+    const int index = getIndex(h[order[j]], t->buckets);
+    contention.lock(t->mutexArr[index], index);
+    std::lock_guard<std::mutex> lk(t->mutexArr[index], std::adopt_lock);
+    for (; j < n && getIndex(h[order[j]], t->buckets) == index; ++j) {
+      const int i = order[j];
+      results[i] = t->hashMap[index].erase(keys[i], h[i]);
+      removed += results[i];
+    }
+  }
+  count -= removed;
+  lock.unlock();
+  maybeShrink();
+}
 
-    // Parallel rehashing
-    const int num_threads = 8;
-    std::vector<std::thread> threads(num_threads);
+void ChainHashMapRehashThreads::rehash() {
+    std::unique_lock<std::shared_mutex> lock(rehashMutex);
+    resize(true);
+}
 
-    auto rehashTask = [&](int thread_id) {
-        for (int i = thread_id; i < oldBuckets; i += num_threads) {
-            for (const auto &key : oldHashMap[i]) {
-                int newIndex = getIndex(hash(key));
-                std::lock_guard<std::mutex> lock(newBucketLocks[newIndex]);
-                newHashMap[newIndex].push_back(key);
-            }
-        }
-    };
+void ChainHashMapRehashThreads::shrink_to_fit() {
+    std::unique_lock<std::shared_mutex> lock(rehashMutex);
+    while (shouldShrink()) {
+        resize(false);
+    }
+}
+
+void ChainHashMapRehashThreads::setAutoShrink(bool enabled) {
+    autoShrink = enabled;
+}
 
-    for (int tid = 0; tid < num_threads; ++tid) {
-        threads[tid] = std::thread(rehashTask, tid);
+bool ChainHashMapRehashThreads::shouldShrink() const {
+    return getBuckets() > minBuckets && getMaxCapacity() > minCapacity &&
+           size() < getLoadFactor() * getMaxCapacity() / 4;
+}
+
+void ChainHashMapRehashThreads::maybeShrink() {
+    if (autoShrink && shouldShrink()) {
+        std::unique_lock<std::shared_mutex> lock(rehashMutex);
+        if (shouldShrink()) {
+            resize(false);
+        }
     }
+}
 
-    for (auto &t : threads) {
-        t.join();
+void ChainHashMapRehashThreads::resize(bool grow) {
+    const auto start = std::chrono::steady_clock::now();
+    Table *oldTable = table.load();
+    int oldBuckets = oldTable->buckets;
+
+    if (grow) {
+        doubleBuckets();
+        doubleCapacity();
+    } else {
+        halveBuckets();
+        halveCapacity();
     }
 
-    // Update the hashMap and bucketLocks
-    hashMap = std::move(newHashMap);
-    bucketLocks = std::move(newBucketLocks);
+    Table *newTable = new Table(getBuckets());
+    auto target = [&](uint64_t h) -> VersionedBucket & {
+        return newTable->hashMap[getIndex(h, newTable->buckets)];
+    };
+
+    // Parallel rehashing over chunks of the smaller table. Growing, old
+    // bucket i only feeds new buckets i and i + oldBuckets; shrinking, new
+    // bucket i is only fed by old buckets i and i + newBuckets. Either way
+    // tasks over disjoint chunks write disjoint new buckets and need no locks.
+    const int span = std::min(oldBuckets, newTable->buckets);
+    const int chunks = (span + REHASH_CHUNK - 1) / REHASH_CHUNK;
+    pool.parallelFor(chunks, [&](int chunk) {
+        const int end = std::min(span, (chunk + 1) * REHASH_CHUNK);
+        for (int i = chunk * REHASH_CHUNK; i < end; ++i) {
+            oldTable->hashMap[i].moveKeys(target);
+            if (!grow) {
+                oldTable->hashMap[i + span].moveKeys(target);
+            }
+        }
+    });
+
+    // Swap in the new table, searches may still be reading the old one.
+    table.store(newTable);
+    EpochManager::retire(oldTable);
+    rehashLog.record(std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count(),
+                     std::min(pool.size(), chunks));
 }
 
 
 int ChainHashMapRehashThreads::size() const { return count; }
 
-int ChainHashMapRehashThreads::getIndex(const int hash) const { return hash % getBuckets(); }
+void ChainHashMapRehashThreads::saveSnapshot(const std::string &path) const {
+  EpochManager::Guard guard;
+  const Table *t = table.load();
+  WorkerPool writers(pool.size());
+  writeSnapshot(
+      path, t->buckets,
+      [t](uint64_t b) -> const VersionedBucket & { return t->hashMap[b]; },
+      hasher, writers);
+}
+
+void ChainHashMapRehashThreads::loadSnapshot(const std::string &path) {
+  SnapshotFile file(path, hasher);
+  std::unique_lock<std::shared_mutex> lock(rehashMutex);
+  while (size() + file.size() > getLoadFactor() * getMaxCapacity()) {
+    resize(true);
+  }
+  Table *t = table.load();
+  pool.parallelFor(file.chunks(), [&](int c) {
+    const uint64_t chunkEnd =
+        std::min(file.buckets(), uint64_t(c + 1) * SnapshotFile::CHUNK);
+    for (uint64_t b = uint64_t(c) * SnapshotFile::CHUNK; b < chunkEnd; ++b) {
+      const uint64_t last = file.first(b + 1);
+      for (uint64_t i = file.first(b); i < last;) {
+        // The keys of a snapshot bucket share one of our buckets unless our
+        // table is larger.
+        const int index = getIndex(file.hash(i), t->buckets);
+        uint64_t end = i + 1;
+        while (end < last && getIndex(file.hash(end), t->buckets) == index) {
+          ++end;
+        }
+        std::lock_guard<std::mutex> lk(t->mutexArr[index]);
+        VersionedBucket &bucket = t->hashMap[index];
+        bucket.reserve(bucket.size() + (end - i));
+        for (; i < end; ++i) {
+          bucket.push(file.key(i), file.hash(i));
+        }
+      }
+    }
+  });
+  count += file.size();
+}
 
-int ChainHashMapRehashThreads::hash(const std::string &s) const {
-  /**
-   * Polynomial hashing.
-   * h = ( s[0] + s[1] * p + s[2] * p^2 + s[3] * p^3 + ... ) % mod.
-   */
-  const int p = 97;
-  const long long int mod = 1e9 + 7;
-  long long h = 0;
-  long long pow = 1;
-  for (char c : s) {
-    h += ((c - '!' + 1) * pow) % mod;
-    h %= mod;
-    pow *= p;
-    pow %= mod;
+MapStats ChainHashMapRehashThreads::stats() const {
+  EpochManager::Guard guard;
+  const Table *t = table.load();
+  MapStats s;
+  s.size = size();
+  for (const VersionedBucket &bucket : t->hashMap) {
+    s.addBucket(bucket.size());
   }
-  return h;
+  s.contention = contention.counts();
+  rehashLog.fill(s);
+  return s;
+}
+
+void ChainHashMapRehashThreads::collectStats(bool enabled) {
+  contention.enable(enabled);
 }
 
+int ChainHashMapRehashThreads::getIndex(const uint64_t hash, const int buckets) const { return hash & (buckets - 1); }
+
+uint64_t ChainHashMapRehashThreads::hash(std::string_view s) const { return hasher(s); }
+
 float ChainHashMapRehashThreads::getLoadFactor() const {
   return loadFactor;
 }
@@ -144,11 +323,19 @@ int ChainHashMapRehashThreads::getMaxCapacity() const {
 }
 
 void ChainHashMapRehashThreads::doubleBuckets() {
-  BUCKETS *= 2;
+  BUCKETS = BUCKETS * 2;
 }
 
 void ChainHashMapRehashThreads::doubleCapacity() {
-  MAX_CAPACITY *= 2;
+  MAX_CAPACITY = MAX_CAPACITY * 2;
+}
+
+void ChainHashMapRehashThreads::halveBuckets() {
+  BUCKETS = BUCKETS / 2;
+}
+
+void ChainHashMapRehashThreads::halveCapacity() {
+  MAX_CAPACITY = MAX_CAPACITY / 2;
 }
 
-ChainHashMapRehashThreads::~ChainHashMapRehashThreads() {}
\ No newline at end of file
+ChainHashMapRehashThreads::~ChainHashMapRehashThreads() { delete table.load(); }
@@ -1,53 +1,132 @@
-#ifndef CHAIN_HASH_MAP_REHASH_H
-#define CHAIN_HASH_MAP_REHASH_H
+#ifndef CHAIN_HASH_MAP_REHASH_THREADS_H
+#define CHAIN_HASH_MAP_REHASH_THREADS_H
 #include "AbstractHashMap.h"
+#include "BucketLocks.h"
+#include "Hasher.h"
+#include "VersionedBucket.h"
+#include "WorkerPool.h"
+#include <atomic>
 #include <list>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
 
 class ChainHashMapRehashThreads : public AbstractHashMap {
 
 public:
-  ChainHashMapRehashThreads(float, int, int); //loadFactor, BUCKETS, MAX_CAPACITY
-  bool insert(std::string);
-  bool search(std::string) const;
-  bool remove(std::string);
+  ChainHashMapRehashThreads(float, int, int, Hasher = wyHash, int threads = 0); //loadFactor, BUCKETS, MAX_CAPACITY, hash function, rehash threads (0: one per hardware thread)
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
+  bool search(std::string_view) const;
+  bool remove(std::string_view);
+  // Batched operations, see AbstractHashMap. Writers check the load factor
+  // and take rehashMutex once per batch.
+  void insertBatch(std::string *keys, int n, bool *results);
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
+  void removeBatch(const std::string_view *keys, int n, bool *results);
   // Re-hashing
   void rehash();
+  // Halve the table while the size is below a quarter of the resize
+  // threshold, down to the initial number of buckets.
+  void shrink_to_fit();
+  // Whether removals halve the table once the size falls below a quarter of
+  // the resize threshold, on by default. The halved table is at most half
+  // full, so shrinking never triggers an immediate regrow.
+  void setAutoShrink(bool);
   int size() const;
+  // Chain lengths, hash quality, bucket lock contention and resize timings,
+  // see AbstractHashMap. Contention is counted per group of buckets,
+  // bucket b in stripe b % CONTENTION_STRIPES.
+  MapStats stats() const;
+  void collectStats(bool);
+  // Write every key with its hash to a snapshot file, bucket by bucket, on
+  // as many threads as the rehash pool. Writers may run meanwhile, each
+  // bucket is saved as it was at one moment of the save.
+  void saveSnapshot(const std::string &path) const;
+  // Add the keys of a snapshot file: grow the table once to fit them, then
+  // rebuild the buckets on the rehash pool from the stored hashes, without
+  // hashing a key. Throws if the snapshot was taken with another hash
+  // function.
+  void loadSnapshot(const std::string &path);
   float getLoadFactor() const; // To get loadFactor to determine if re-hashing needed
   int getBuckets() const;
   int getMaxCapacity() const;
   void doubleBuckets();
   void doubleCapacity();
+  void halveBuckets();
+  void halveCapacity();
   ~ChainHashMapRehashThreads();
 
 private:
+  /**
+   * The buckets and their locks. rehash() builds a new table and swaps it
+   * in; the old one is retired once no search can still be reading it.
+   */
+  struct Table {
+    explicit Table(int);
+
+    // Number of buckets.
+    const int buckets;
+
+    // The hash map data structure behind the scenes. Searches are lock-free
+    // and validated with the bucket's version.
+    std::vector<VersionedBucket> hashMap;
+
+    // Locks to protect access to each of the buckets.
+    std::vector<std::mutex> mutexArr;
+  };
+
   // A value between 0 and 1(inclusive) to determine the load at which a
   // hash map should resize.
   float loadFactor;
-  int BUCKETS;
-  int MAX_CAPACITY;
+  // Number of buckets, always a power of two.
+  std::atomic<int> BUCKETS;
+  std::atomic<int> MAX_CAPACITY;
+
+  // Initial BUCKETS and MAX_CAPACITY, the table never shrinks below them.
+  int minBuckets;
+  int minCapacity;
+
+  std::atomic<bool> autoShrink;
+
+  // The hash function.
+  Hasher hasher;
+
+  // Number of contention counters.
+  static const int CONTENTION_STRIPES = 4096;
+
+  // Contended bucket lock acquisitions, when collected.
+  ContentionCounters contention;
+
+  // Number and durations of the resizes.
+  RehashLog rehashLog;
+
+  // The current table.
+  std::atomic<Table *> table;
+
+  // global rehash lock, writers hold it shared and rehash() exclusively
+  std::shared_mutex rehashMutex;
 
-  // The hash map data structure behind the scenes.
-  std::vector<std::vector<std::string>> hashMap;
+  // Threads migrating the buckets on resize, started by the first resize.
+  WorkerPool pool;
 
-  // mutex for each bucket
-  std::vector<std::mutex> bucketLocks;
+  // Number of old buckets a rehash task migrates.
+  static const int REHASH_CHUNK = 4096;
 
-  // Locks to protect access to each of the buckets.
-  mutable std::vector<std::mutex> mutexArr;
+  // Rebuild the table with twice or half the buckets, caller holds
+  // rehashMutex exclusively.
+  void resize(bool grow);
 
-  // global rehash lock
-  std::mutex rehashMutex;
+  // Whether the table is sparse enough to be halved.
+  bool shouldShrink() const;
 
-  // rehash flag
-  bool isRehashing = false;
+  // Halve the table if it should shrink, after a removal.
+  void maybeShrink();
 
   // A utility method to compute the hash of a given string.
-  int hash(const std::string &) const;
+  uint64_t hash(std::string_view) const;
 
-  // A utility method to compute the index of a hash in the hash map.
-  int getIndex(const int hash) const;
+  // A utility method to compute the index of a hash in a table.
+  int getIndex(const uint64_t hash, const int buckets) const;
 };
-#endif // CHAIN_HASH_MAP_REHASH_H
\ No newline at end of file
+#endif // CHAIN_HASH_MAP_REHASH_THREADS_H
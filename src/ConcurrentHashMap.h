@@ -0,0 +1,374 @@
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+#include "AbstractHashMap.h"
+#include "EpochManager.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Chained hash table shared by ConcurrentHashMap and its Value = void
+ * specialization. Entry is what a node stores inline next to its hash:
+ * std::pair<const Key, Value> for maps and const Key for sets.
+ *
+ * Writers lock one of STRIPES mutexes picked by the hash, so a key keeps its
+ * lock when the table grows. Nodes are never modified once linked; assigning
+ * a value links a new node in place of the old one. Readers take no lock,
+ * they hold an EpochManager::Guard and unlinked nodes are retired through the
+ * EpochManager. Once the load factor is exceeded the entries are copied into
+ * a table twice the size with every stripe locked, and the old table is
+ * retired, so Entry must be copy constructible.
+ *
+ * Lookups take a Lookup: std::string_view for std::string keys, so that they
+ * never allocate, and const Key & otherwise. Hash and Eq must accept it.
+ */
+template <typename Key, typename Entry, typename Hash, typename Eq>
+class ConcurrentHashTable {
+
+public:
+  // Constructor.
+  ConcurrentHashTable(size_t buckets, float loadFactor, const Hash &hash,
+                      const Eq &eq)
+      : loadFactor(loadFactor), hasher(hash), eq(eq), count(0) {
+    if (loadFactor <= 0) {
+      std::__throw_out_of_range("load factor value is out of range.");
+    }
+    // Round the number of buckets up to a power of two.
+    size_t n = 1;
+    while (n < buckets) {
+      n *= 2;
+    }
+    table = new Table(n);
+  }
+
+  // Number of entries.
+  size_t size() const { return count.load(); }
+
+  // Current number of buckets.
+  size_t getBuckets() const {
+    EpochManager::Guard guard;
+    return table.load()->buckets;
+  }
+
+  // Destructor.
+  ~ConcurrentHashTable() { delete table.load(); }
+
+  ConcurrentHashTable(const ConcurrentHashTable &) = delete;
+  ConcurrentHashTable &operator=(const ConcurrentHashTable &) = delete;
+
+  typedef typename std::conditional<std::is_same<Key, std::string>::value,
+                                    std::string_view, const Key &>::type
+      Lookup;
+
+protected:
+  struct Node {
+    template <typename... Args>
+    explicit Node(Args &&...args)
+        : hash(0), next(nullptr), entry(std::forward<Args>(args)...) {}
+
+    // Set once before the node is linked.
+    size_t hash;
+
+    std::atomic<Node *> next;
+
+    Entry entry;
+  };
+
+  static const Key &keyOf(const Key &key) { return key; }
+
+  template <typename V>
+  static const Key &keyOf(const std::pair<const Key, V> &entry) {
+    return entry.first;
+  }
+
+  // Hash of a key, mixed so that the low bits can be used as a mask.
+  size_t hashOf(Lookup key) const {
+    uint64_t h = hasher(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // Returns the node holding key, caller holds an EpochManager::Guard.
+  const Node *findNode(Lookup key, size_t h) const {
+    const Table *t = table.load(std::memory_order_acquire);
+    for (const Node *n = t->heads[h & (t->buckets - 1)].load(
+             std::memory_order_acquire);
+         n != nullptr; n = n->next.load(std::memory_order_acquire)) {
+      if (n->hash == h && eq(keyOf(n->entry), key)) {
+        return n;
+      }
+    }
+    return nullptr;
+  }
+
+  // Link a node whose hash is set. If its key already exists the old node is
+  // replaced when assign is set, else the new node is dropped. Returns true
+  // if the key was inserted.
+  bool link(Node *node, bool assign) {
+    size_t buckets;
+    {
+      std::lock_guard<std::mutex> lk(stripe(node->hash));
+      Table *t = table.load(std::memory_order_relaxed);
+      buckets = t->buckets;
+      std::atomic<Node *> &head = t->heads[node->hash & (buckets - 1)];
+      std::atomic<Node *> *prev = &head;
+      for (Node *n = head.load(std::memory_order_relaxed); n != nullptr;
+           prev = &n->next, n = n->next.load(std::memory_order_relaxed)) {
+        if (n->hash == node->hash &&
+            eq(keyOf(n->entry), keyOf(node->entry))) {
+          if (!assign) {
+            delete node;
+            return false;
+          }
+          node->next.store(n->next.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+          prev->store(node, std::memory_order_release);
+          EpochManager::retire(n);
+          return false;
+        }
+      }
+      node->next.store(head.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+      head.store(node, std::memory_order_release);
+    }
+    if (++count > loadFactor * buckets) {
+      grow();
+    }
+    return true;
+  }
+
+  // Unlink the node holding key. Returns false if the key doesn't exist.
+  bool unlink(Lookup key, size_t h) {
+    std::lock_guard<std::mutex> lk(stripe(h));
+    Table *t = table.load(std::memory_order_relaxed);
+    std::atomic<Node *> *prev = &t->heads[h & (t->buckets - 1)];
+    for (Node *n = prev->load(std::memory_order_relaxed); n != nullptr;
+         prev = &n->next, n = n->next.load(std::memory_order_relaxed)) {
+      if (n->hash == h && eq(keyOf(n->entry), key)) {
+        prev->store(n->next.load(std::memory_order_relaxed),
+                    std::memory_order_release);
+        // Readers may still be standing on n.
+        EpochManager::retire(n);
+        --count;
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct Table {
+    explicit Table(size_t buckets)
+        : buckets(buckets), heads(new std::atomic<Node *>[buckets]) {
+      for (size_t i = 0; i < buckets; ++i) {
+        heads[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    ~Table() {
+      for (size_t i = 0; i < buckets; ++i) {
+        Node *n = heads[i].load();
+        while (n != nullptr) {
+          Node *next = n->next.load();
+          delete n;
+          n = next;
+        }
+      }
+    }
+
+    // Number of buckets, a power of two.
+    const size_t buckets;
+
+    std::unique_ptr<std::atomic<Node *>[]> heads;
+  };
+
+  // Number of writer locks, independent of the number of buckets.
+  static const size_t STRIPES = 256;
+
+  // Average number of entries per bucket at which the table doubles.
+  float loadFactor;
+
+  Hash hasher;
+
+  Eq eq;
+
+  // The current table.
+  std::atomic<Table *> table;
+
+  // Total number of entries.
+  std::atomic<size_t> count;
+
+  // Locks to protect access to the buckets.
+  std::mutex locks[STRIPES];
+
+  std::mutex &stripe(size_t h) { return locks[h & (STRIPES - 1)]; }
+
+  // Copy every entry into a table twice the size and retire the old one.
+  void grow() {
+    for (size_t i = 0; i < STRIPES; ++i) {
+      locks[i].lock();
+    }
+    Table *t = table.load(std::memory_order_relaxed);
+    // Another writer may have grown the table already.
+    if (count > loadFactor * t->buckets) {
+      Table *next = new Table(t->buckets * 2);
+      for (size_t i = 0; i < t->buckets; ++i) {
+        for (Node *n = t->heads[i].load(std::memory_order_relaxed);
+             n != nullptr; n = n->next.load(std::memory_order_relaxed)) {
+          Node *copy = new Node(n->entry);
+          copy->hash = n->hash;
+          std::atomic<Node *> &head = next->heads[n->hash & (next->buckets - 1)];
+          copy->next.store(head.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+          head.store(copy, std::memory_order_relaxed);
+        }
+      }
+      table.store(next, std::memory_order_release);
+      // Readers may still be walking the old table.
+      EpochManager::retire(t);
+    }
+    for (size_t i = STRIPES; i > 0; --i) {
+      locks[i - 1].unlock();
+    }
+  }
+};
+
+// Default hash of ConcurrentHashMap, std::string keys are hashed as
+// std::string_view so that lookups don't have to build a std::string.
+template <typename Key> struct ConcurrentHash : std::hash<Key> {};
+
+template <> struct ConcurrentHash<std::string> {
+  size_t operator()(std::string_view key) const {
+    return std::hash<std::string_view>()(key);
+  }
+};
+
+/**
+ * A generic concurrent key to value map. Values are stored inline next to
+ * their keys, in the same allocation.
+ */
+template <typename Key, typename Value = void,
+          typename Hash = ConcurrentHash<Key>, typename Eq = std::equal_to<>>
+class ConcurrentHashMap
+    : public ConcurrentHashTable<Key, std::pair<const Key, Value>, Hash, Eq> {
+
+  typedef ConcurrentHashTable<Key, std::pair<const Key, Value>, Hash, Eq> Base;
+  typedef typename Base::Node Node;
+  typedef typename Base::Lookup Lookup;
+
+public:
+  // Constructor, loadFactor is the average number of entries per bucket at
+  // which the number of buckets doubles.
+  explicit ConcurrentHashMap(size_t buckets = 1024, float loadFactor = 1,
+                             const Hash &hash = Hash(), const Eq &eq = Eq())
+      : Base(buckets, loadFactor, hash, eq) {}
+
+  // Returns a copy of the value of key, if any.
+  std::optional<Value> find(Lookup key) const {
+    EpochManager::Guard guard;
+    const Node *n = this->findNode(key, this->hashOf(key));
+    if (n == nullptr) {
+      return std::nullopt;
+    }
+    return n->entry.second;
+  }
+
+  // Whether the key exists.
+  bool contains(Lookup key) const {
+    EpochManager::Guard guard;
+    return this->findNode(key, this->hashOf(key)) != nullptr;
+  }
+
+  // Insert the key or replace its value. Returns true if the key was
+  // inserted, false if it was assigned.
+  template <typename V> bool insert_or_assign(const Key &key, V &&value) {
+    Node *n = new Node(key, std::forward<V>(value));
+    n->hash = this->hashOf(n->entry.first);
+    return this->link(n, true);
+  }
+
+  template <typename V> bool insert_or_assign(Key &&key, V &&value) {
+    Node *n = new Node(std::move(key), std::forward<V>(value));
+    n->hash = this->hashOf(n->entry.first);
+    return this->link(n, true);
+  }
+
+  // Construct an entry from the arguments, as std::pair<const Key, Value>,
+  // and insert it unless the key already exists. Returns true if inserted.
+  template <typename... Args> bool emplace(Args &&...args) {
+    Node *n = new Node(std::forward<Args>(args)...);
+    n->hash = this->hashOf(n->entry.first);
+    return this->link(n, false);
+  }
+
+  // Deletion, returns false if the key doesn't exist.
+  bool erase(Lookup key) { return this->unlink(key, this->hashOf(key)); }
+};
+
+// Base of the string set, so it can be used wherever an AbstractHashMap is.
+struct ConcurrentHashSetNoBase {};
+
+template <typename Key>
+using ConcurrentHashSetBase =
+    typename std::conditional<std::is_same<Key, std::string>::value,
+                              AbstractHashMap, ConcurrentHashSetNoBase>::type;
+
+/**
+ * A concurrent set, with the same insert/search/remove/size interface as the
+ * other maps. ConcurrentHashMap<std::string> is an AbstractHashMap.
+ */
+template <typename Key, typename Hash, typename Eq>
+class ConcurrentHashMap<Key, void, Hash, Eq>
+    : public ConcurrentHashTable<Key, const Key, Hash, Eq>,
+      public ConcurrentHashSetBase<Key> {
+
+  typedef ConcurrentHashTable<Key, const Key, Hash, Eq> Base;
+  typedef typename Base::Node Node;
+  typedef typename Base::Lookup Lookup;
+
+public:
+  // Constructor, loadFactor is the average number of keys per bucket at
+  // which the number of buckets doubles.
+  explicit ConcurrentHashMap(size_t buckets = 1024, float loadFactor = 1,
+                             const Hash &hash = Hash(), const Eq &eq = Eq())
+      : Base(buckets, loadFactor, hash, eq) {}
+
+  // Insertion, the key is moved into the set. Returns false if the key
+  // already exists.
+  bool insert(Key &&key) {
+    Node *n = new Node(std::move(key));
+    n->hash = this->hashOf(n->entry);
+    return this->link(n, false);
+  }
+
+  // Insert a copy of a key.
+  bool insert(Lookup key) { return insert(Key(key)); }
+
+  // String literals would be ambiguous between the two above.
+  template <typename K = Key, typename = typename std::enable_if<
+                                  std::is_same<K, std::string>::value>::type>
+  bool insert(const char *key) {
+    return insert(Key(key));
+  }
+
+  // Search.
+  bool search(Lookup key) const {
+    EpochManager::Guard guard;
+    return this->findNode(key, this->hashOf(key)) != nullptr;
+  }
+
+  // Deletion, returns false if the key doesn't exist.
+  bool remove(Lookup key) { return this->unlink(key, this->hashOf(key)); }
+
+  // Size.
+  int size() const { return Base::size(); }
+};
+#endif // CONCURRENT_HASH_MAP_H
@@ -0,0 +1,444 @@
+#include "CuckooHashMap.h"
+#include "EpochManager.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+void destroyKey(void *p) { InlineKey::destroy(static_cast<InlineKey *>(p)); }
+
+} // namespace
+
+CuckooHashMap::Table::Table(int buckets)
+    : buckets(buckets), data(new Bucket[buckets]) {
+  for (int b = 0; b < buckets; ++b) {
+    for (int s = 0; s < SLOTS; ++s) {
+      data[b].tags[s].store(0, std::memory_order_relaxed);
+      data[b].keys[s].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+}
+
+CuckooHashMap::CuckooHashMap(Hasher hasher, int buckets)
+    : AbstractHashMap(), stripes(new Stripe[STRIPES]) {
+  if (buckets < 1) {
+    std::__throw_out_of_range("CuckooHashMap: buckets value is out of range.");
+  }
+  this->hasher = hasher;
+  this->count = 0;
+  // Round the number of buckets up to a power of two so that the index of a
+  // hash is a mask.
+  int n = 1;
+  while (n < buckets) {
+    n *= 2;
+  }
+  table = new Table(n);
+  for (int i = 0; i < STRIPES; ++i) {
+    stripes[i].version.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool CuckooHashMap::insert(std::string &&key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const uint8_t tag = getTag(h);
+  // Allocate before taking any lock.
+  const InlineKey *k = InlineKey::create(key);
+  while (true) {
+    Table *t = table.load();
+    const int b1 = getIndex(h, t->buckets);
+    const int b2 = altIndex(b1, tag, t->buckets);
+    lockPair(b1, b2);
+    // The table may have been doubled while we were waiting.
+    if (table.load() != t) {
+      unlockPair(b1, b2);
+      continue;
+    }
+    Bucket &first = t->data[b1];
+    Bucket &second = t->data[b2];
+    if (findSlot(first, key, tag) >= 0 || findSlot(second, key, tag) >= 0) {
+      unlockPair(b1, b2);
+      InlineKey::destroy(k);
+      return false;
+    }
+    Bucket *bucket = &first;
+    int slot = freeSlot(first);
+    if (slot < 0) {
+      bucket = &second;
+      slot = freeSlot(second);
+    }
+    if (slot >= 0) {
+      beginWrite(b1, b2);
+      bucket->tags[slot].store(tag, std::memory_order_relaxed);
+      bucket->keys[slot].store(k, std::memory_order_release);
+      endWrite(b1, b2);
+      unlockPair(b1, b2);
+      ++count;
+      return true;
+    }
+    unlockPair(b1, b2);
+    // Both buckets are full: make room along a cuckoo path, searched without
+    // any lock, or double the table if there is none.
+    const std::vector<Step> path = findPath(t, b1, b2);
+    if (path.empty()) {
+      grow(t);
+    } else {
+      movePath(t, path);
+    }
+  }
+}
+
+bool CuckooHashMap::search(std::string_view key) const {
+  EpochManager::Guard guard;
+  return find(key, hash(key));
+}
+
+void CuckooHashMap::searchBatch(const std::string_view *keys, int n,
+                                bool *results) const {
+  EpochManager::Guard guard;
+  uint64_t h[BATCH_CHUNK];
+  for (int base = 0; base < n; base += BATCH_CHUNK) {
+    const int m = std::min(BATCH_CHUNK, n - base);
+    // Overlap the misses on both buckets of every key.
+    const Table *t = table.load();
+    for (int i = 0; i < m; ++i) {
+      h[i] = hash(keys[base + i]);
+      const int b1 = getIndex(h[i], t->buckets);
+      __builtin_prefetch(&t->data[b1]);
+      __builtin_prefetch(&t->data[altIndex(b1, getTag(h[i]), t->buckets)]);
+    }
+    for (int i = 0; i < m; ++i) {
+      results[base + i] = find(keys[base + i], h[i]);
+    }
+  }
+}
+
+bool CuckooHashMap::find(std::string_view key, uint64_t h) const {
+  const uint8_t tag = getTag(h);
+  while (true) {
+    const Table *t = table.load();
+    const int b1 = getIndex(h, t->buckets);
+    const int b2 = altIndex(b1, tag, t->buckets);
+    const Stripe &s1 = stripeOf(b1);
+    const Stripe &s2 = stripeOf(b2);
+    const unsigned v1 = s1.version.load(std::memory_order_acquire);
+    const unsigned v2 = s2.version.load(std::memory_order_acquire);
+    // A writer is in the middle of a change.
+    if ((v1 | v2) & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    const bool found = findSlot(t->data[b1], key, tag) >= 0 ||
+                       findSlot(t->data[b2], key, tag) >= 0;
+    // Validate that no writer ran during the scan and that the table wasn't
+    // replaced. A key being moved between its two buckets is written under
+    // both versions.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s1.version.load(std::memory_order_relaxed) == v1 &&
+        s2.version.load(std::memory_order_relaxed) == v2 &&
+        table.load(std::memory_order_relaxed) == t) {
+      return found;
+    }
+  }
+}
+
+bool CuckooHashMap::remove(std::string_view key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const uint8_t tag = getTag(h);
+  while (true) {
+    Table *t = table.load();
+    const int b1 = getIndex(h, t->buckets);
+    const int b2 = altIndex(b1, tag, t->buckets);
+    lockPair(b1, b2);
+    if (table.load() != t) {
+      unlockPair(b1, b2);
+      continue;
+    }
+    for (int b : {b1, b2}) {
+      Bucket &bucket = t->data[b];
+      const int slot = findSlot(bucket, key, tag);
+      if (slot >= 0) {
+        const InlineKey *k = bucket.keys[slot].load(std::memory_order_relaxed);
+        beginWrite(b1, b2);
+        bucket.keys[slot].store(nullptr, std::memory_order_relaxed);
+        endWrite(b1, b2);
+        unlockPair(b1, b2);
+        --count;
+        // Optimistic readers may still be comparing against k.
+        EpochManager::retire(const_cast<InlineKey *>(k), destroyKey);
+        return true;
+      }
+    }
+    // Do nothing if the key doesn't exist.
+    unlockPair(b1, b2);
+    return false;
+  }
+}
+
+std::vector<CuckooHashMap::Step>
+CuckooHashMap::findPath(const Table *t, int b1, int b2) const {
+  // Breadth-first, so the path found is a shortest one and holds the
+  // buckets' locks for as few moves as possible.
+  std::vector<Step> steps;
+  steps.reserve(MAX_SEARCH);
+  steps.push_back({b1, -1, -1, 0});
+  if (b2 != b1) {
+    steps.push_back({b2, -1, -1, 0});
+  }
+  for (size_t i = 0; i < steps.size(); ++i) {
+    const Step step = steps[i];
+    const Bucket &bucket = t->data[step.bucket];
+    if (i >= 2 && freeSlot(bucket) >= 0) {
+      std::vector<Step> path;
+      for (int j = i; j >= 0; j = steps[j].parent) {
+        path.push_back(steps[j]);
+      }
+      std::reverse(path.begin(), path.end());
+      return path;
+    }
+    if (step.depth == MAX_PATH) {
+      continue;
+    }
+    for (int s = 0; s < SLOTS && int(steps.size()) < MAX_SEARCH; ++s) {
+      if (bucket.keys[s].load(std::memory_order_relaxed) == nullptr) {
+        continue;
+      }
+      const uint8_t tag = bucket.tags[s].load(std::memory_order_relaxed);
+      steps.push_back({altIndex(step.bucket, tag, t->buckets), s, int(i),
+                       step.depth + 1});
+    }
+  }
+  return {};
+}
+
+bool CuckooHashMap::movePath(Table *t, const std::vector<Step> &path) {
+  // Move the last key into the free slot first, then the key before it into
+  // the slot just vacated, and so on back to the first bucket.
+  for (size_t i = path.size() - 1; i > 0; --i) {
+    const int from = path[i - 1].bucket;
+    const int to = path[i].bucket;
+    const int slot = path[i].slot;
+    lockPair(from, to);
+    Bucket &source = t->data[from];
+    Bucket &target = t->data[to];
+    const InlineKey *k = source.keys[slot].load(std::memory_order_relaxed);
+    const uint8_t tag = source.tags[slot].load(std::memory_order_relaxed);
+    const int free = freeSlot(target);
+    // Another writer got there first: the slot was emptied or now holds a
+    // key with another second bucket, or the target filled up.
+    if (table.load() != t || k == nullptr ||
+        altIndex(from, tag, t->buckets) != to || free < 0) {
+      unlockPair(from, to);
+      return false;
+    }
+    beginWrite(from, to);
+    target.tags[free].store(tag, std::memory_order_relaxed);
+    target.keys[free].store(k, std::memory_order_release);
+    source.keys[slot].store(nullptr, std::memory_order_relaxed);
+    endWrite(from, to);
+    unlockPair(from, to);
+  }
+  return true;
+}
+
+void CuckooHashMap::grow(Table *t) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < STRIPES; ++i) {
+    stripes[i].mtx.lock();
+  }
+  if (table.load() != t) {
+    for (int i = STRIPES - 1; i >= 0; --i) {
+      stripes[i].mtx.unlock();
+    }
+    return;
+  }
+  // Readers retry until the new table is published.
+  for (int i = 0; i < STRIPES; ++i) {
+    stripes[i].version.store(stripes[i].version.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  int buckets = t->buckets * 2;
+  Table *next = nullptr;
+  while (next == nullptr) {
+    next = new Table(buckets);
+    for (int b = 0; b < t->buckets && next != nullptr; ++b) {
+      for (int s = 0; s < SLOTS; ++s) {
+        const InlineKey *k = t->data[b].keys[s].load(std::memory_order_relaxed);
+        if (k != nullptr && !place(next, k, hash(k->view()))) {
+          // Start over twice as large; every key is still in t.
+          delete next;
+          next = nullptr;
+          buckets *= 2;
+          break;
+        }
+      }
+    }
+  }
+  table.store(next);
+  for (int i = 0; i < STRIPES; ++i) {
+    stripes[i].version.store(stripes[i].version.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_release);
+  }
+  for (int i = STRIPES - 1; i >= 0; --i) {
+    stripes[i].mtx.unlock();
+  }
+  // Readers may still be walking the old buckets.
+  EpochManager::retire(t);
+  rehashLog.record(std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count(),
+                   1);
+}
+
+bool CuckooHashMap::place(Table *t, const InlineKey *key, uint64_t hash) {
+  uint8_t tag = getTag(hash);
+  int b = getIndex(hash, t->buckets);
+  for (int kick = 0; kick < MAX_KICKS; ++kick) {
+    for (int candidate : {b, altIndex(b, tag, t->buckets)}) {
+      Bucket &bucket = t->data[candidate];
+      const int slot = freeSlot(bucket);
+      if (slot >= 0) {
+        bucket.tags[slot].store(tag, std::memory_order_relaxed);
+        bucket.keys[slot].store(key, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    // Evict a key of b, varying the slot, and carry it to its other bucket.
+    Bucket &bucket = t->data[b];
+    const int slot = (kick + tag) % SLOTS;
+    const InlineKey *evicted = bucket.keys[slot].load(std::memory_order_relaxed);
+    const uint8_t evictedTag = bucket.tags[slot].load(std::memory_order_relaxed);
+    bucket.tags[slot].store(tag, std::memory_order_relaxed);
+    bucket.keys[slot].store(key, std::memory_order_relaxed);
+    key = evicted;
+    tag = evictedTag;
+    b = altIndex(b, tag, t->buckets);
+  }
+  return false;
+}
+
+int CuckooHashMap::findSlot(const Bucket &bucket, std::string_view key,
+                            uint8_t tag) {
+  for (int s = 0; s < SLOTS; ++s) {
+    if (bucket.tags[s].load(std::memory_order_relaxed) != tag) {
+      continue;
+    }
+    const InlineKey *k = bucket.keys[s].load(std::memory_order_acquire);
+    if (k != nullptr && k->view() == key) {
+      return s;
+    }
+  }
+  return -1;
+}
+
+int CuckooHashMap::freeSlot(const Bucket &bucket) {
+  for (int s = 0; s < SLOTS; ++s) {
+    if (bucket.keys[s].load(std::memory_order_relaxed) == nullptr) {
+      return s;
+    }
+  }
+  return -1;
+}
+
+void CuckooHashMap::lockPair(int a, int b) const {
+  int sa = a & (STRIPES - 1);
+  int sb = b & (STRIPES - 1);
+  if (sa > sb) {
+    std::swap(sa, sb);
+  }
+  stripes[sa].mtx.lock();
+  if (sb != sa) {
+    stripes[sb].mtx.lock();
+  }
+}
+
+void CuckooHashMap::unlockPair(int a, int b) const {
+  const int sa = a & (STRIPES - 1);
+  const int sb = b & (STRIPES - 1);
+  stripes[sa].mtx.unlock();
+  if (sb != sa) {
+    stripes[sb].mtx.unlock();
+  }
+}
+
+void CuckooHashMap::beginWrite(int a, int b) const {
+  Stripe &sa = stripeOf(a);
+  Stripe &sb = stripeOf(b);
+  sa.version.store(sa.version.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  if (&sb != &sa) {
+    sb.version.store(sb.version.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void CuckooHashMap::endWrite(int a, int b) const {
+  Stripe &sa = stripeOf(a);
+  Stripe &sb = stripeOf(b);
+  sa.version.store(sa.version.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  if (&sb != &sa) {
+    sb.version.store(sb.version.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+  }
+}
+
+int CuckooHashMap::size() const { return count; }
+
+int CuckooHashMap::capacity() const { return table.load()->buckets * SLOTS; }
+
+double CuckooHashMap::loadFactor() const {
+  return double(size()) / capacity();
+}
+
+MapStats CuckooHashMap::stats() const {
+  EpochManager::Guard guard;
+  const Table *t = table.load();
+  MapStats s;
+  s.size = size();
+  for (int b = 0; b < t->buckets; ++b) {
+    unsigned used = 0;
+    for (int slot = 0; slot < SLOTS; ++slot) {
+      used += t->data[b].keys[slot].load(std::memory_order_relaxed) != nullptr;
+    }
+    s.addBucket(used);
+  }
+  rehashLog.fill(s);
+  return s;
+}
+
+CuckooHashMap::Stripe &CuckooHashMap::stripeOf(int bucket) const {
+  return stripes[bucket & (STRIPES - 1)];
+}
+
+uint8_t CuckooHashMap::getTag(uint64_t hash) { return hash >> 56; }
+
+int CuckooHashMap::getIndex(uint64_t hash, int buckets) {
+  return hash & (buckets - 1);
+}
+
+int CuckooHashMap::altIndex(int index, uint8_t tag, int buckets) {
+  // XOR with a function of the tag, so that the alternative of the
+  // alternative is the first bucket again. tag + 1 keeps tag 0 from mapping
+  // a bucket onto itself.
+  return (index ^ ((tag + 1) * 0x5bd1e995u)) & (buckets - 1);
+}
+
+uint64_t CuckooHashMap::hash(std::string_view s) const { return hasher(s); }
+
+CuckooHashMap::~CuckooHashMap() {
+  Table *t = table.load();
+  for (int b = 0; b < t->buckets; ++b) {
+    for (int s = 0; s < SLOTS; ++s) {
+      const InlineKey *k = t->data[b].keys[s].load();
+      if (k != nullptr) {
+        InlineKey::destroy(k);
+      }
+    }
+  }
+  delete t;
+}
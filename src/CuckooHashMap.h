@@ -0,0 +1,192 @@
+#ifndef CUCKOO_HASH_MAP_H
+#define CUCKOO_HASH_MAP_H
+#include "AbstractHashMap.h"
+#include "Hasher.h"
+#include "MapStats.h"
+#include "SlabAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A thread safe bucketized cuckoo hashmap implementation (libcuckoo style).
+ *
+ * Every key lives in one of two candidate buckets of SLOTS slots, each
+ * bucket filling one cache line: an 8-bit tag per slot, taken from the
+ * key's hash, and a pointer to the key, an InlineKey from the SlabAllocator.
+ * The second bucket is derived from the first and the tag alone (partial
+ * key cuckoo hashing), so keys can be moved without hashing them again.
+ * A search reads at most two buckets and only compares key bytes on a tag
+ * match; no chains, so load factors above 90% are reached.
+ *
+ * Buckets are guarded by lock stripes, each with a version counter.
+ * Searches take no lock: they read both buckets optimistically and retry if
+ * either stripe's version was odd or changed. An insertion locks the
+ * stripes of its two buckets only; if both are full, a cuckoo path to a
+ * free slot is searched breadth-first without any lock, then applied one
+ * move at a time from the free end, each move locking just the two buckets
+ * it touches and checking that the path is still valid. When no path is
+ * found the table is doubled with all stripes held.
+ *
+ * Removed keys and replaced tables go to the EpochManager.
+ */
+class CuckooHashMap : public AbstractHashMap {
+
+public:
+  // Slots per bucket, with their tags they fill one 64-byte cache line.
+  static const int SLOTS = 7;
+
+  // Initial number of buckets unless given to the constructor.
+  // For 1e6 elements, the load would be about 0.5.
+  static const int DEFAULT_BUCKETS = 256 * 1024;
+
+  // Constructor. Buckets are rounded up to a power of two.
+  CuckooHashMap(Hasher = wyHash, int buckets = DEFAULT_BUCKETS);
+
+  // Insertion. Returns false if the key is already in the map.
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
+
+  // Search.
+  bool search(std::string_view) const;
+
+  // Deletion.
+  bool remove(std::string_view);
+
+  // Batched search, see AbstractHashMap.
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
+
+  // Size.
+  int size() const;
+
+  // Number of slots.
+  int capacity() const;
+
+  // Slots in use, size() / capacity().
+  double loadFactor() const;
+
+  // Bucket occupancy (as chain lengths) and growths, see AbstractHashMap.
+  MapStats stats() const;
+
+  // Destructor.
+  ~CuckooHashMap();
+
+  CuckooHashMap(const CuckooHashMap &) = delete;
+  CuckooHashMap &operator=(const CuckooHashMap &) = delete;
+
+private:
+  // Number of lock stripes, bucket b is guarded by stripe b % STRIPES.
+  static const int STRIPES = 8192;
+
+  // Longest cuckoo path, in moves.
+  static const int MAX_PATH = 5;
+
+  // Most buckets visited by one breadth-first path search.
+  static const int MAX_SEARCH = 512;
+
+  // Most evictions placing one key while a table is doubled.
+  static const int MAX_KICKS = 512;
+
+  struct alignas(64) Bucket {
+    std::atomic<uint8_t> tags[SLOTS];
+    // nullptr for a free slot.
+    std::atomic<const InlineKey *> keys[SLOTS];
+  };
+
+  // One generation of the hash map. Keys are freed by the map, not here,
+  // as a doubled table takes them over.
+  struct Table {
+    explicit Table(int buckets);
+
+    // Number of buckets, a power of two.
+    const int buckets;
+
+    // The buckets.
+    std::unique_ptr<Bucket[]> data;
+  };
+
+  // A lock with the version of the buckets it guards, odd while they are
+  // being changed.
+  struct alignas(64) Stripe {
+    std::mutex mtx;
+    std::atomic<unsigned> version;
+  };
+
+  // A bucket on a cuckoo path, reached by moving the key in slot of the
+  // previous step's bucket here.
+  struct Step {
+    int bucket;
+    // Unused for a first bucket.
+    int slot;
+    // Index of the previous step in the search, -1 for a first bucket.
+    int parent;
+    // Number of moves from a first bucket.
+    int depth;
+  };
+
+  // The hash function. The low bits of a hash pick the first bucket, the
+  // top 8 bits are the tag.
+  Hasher hasher;
+
+  // The current table.
+  std::atomic<Table *> table;
+
+  // STRIPES lock stripes.
+  std::unique_ptr<Stripe[]> stripes;
+
+  // Number and durations of the growths.
+  RehashLog rehashLog;
+
+  // A utility method to compute the hash of a given string.
+  uint64_t hash(std::string_view) const;
+
+  // Tag of a hash.
+  static uint8_t getTag(uint64_t hash);
+
+  // First bucket of a hash in a table of the given size.
+  static int getIndex(uint64_t hash, int buckets);
+
+  // The other bucket of a key in bucket index with the given tag.
+  static int altIndex(int index, uint8_t tag, int buckets);
+
+  // Stripe of a bucket.
+  Stripe &stripeOf(int bucket) const;
+
+  // Lock the stripes of two buckets in order, once if they share one.
+  void lockPair(int a, int b) const;
+  void unlockPair(int a, int b) const;
+
+  // Enter and leave a write section on two locked buckets: their stripes'
+  // versions are odd in between.
+  void beginWrite(int a, int b) const;
+  void endWrite(int a, int b) const;
+
+  // Lock-free search of a key with the given hash. Caller holds an
+  // EpochManager::Guard.
+  bool find(std::string_view, uint64_t hash) const;
+
+  // Slot of key in a bucket, -1 if it isn't there. Lock-free callers
+  // validate the result with the versions.
+  static int findSlot(const Bucket &, std::string_view key, uint8_t tag);
+
+  // First free slot of a bucket, -1 if it is full.
+  static int freeSlot(const Bucket &);
+
+  // Search both buckets of t for a free slot at the end of a path of moves,
+  // without locking. Returns the path, first bucket first, or an empty one.
+  std::vector<Step> findPath(const Table *t, int b1, int b2) const;
+
+  // Apply a path from its free end. Returns false if a concurrent writer
+  // changed a bucket on it.
+  bool movePath(Table *t, const std::vector<Step> &path);
+
+  // Double t with every stripe held, unless it was replaced already.
+  void grow(Table *t);
+
+  // Place a key in t without locking, for a table nobody else sees yet.
+  // Returns false if no free slot was found.
+  static bool place(Table *t, const InlineKey *key, uint64_t hash);
+};
+#endif // CUCKOO_HASH_MAP_H
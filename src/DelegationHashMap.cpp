@@ -0,0 +1,334 @@
+#include "DelegationHashMap.h"
+#include "NumaTopology.h"
+#include <chrono>
+
+namespace {
+
+// Unique ids of the maps.
+std::atomic<uint64_t> nextId(1);
+
+// Polls of an idle server, or of a waiting client, before it starts
+// yielding.
+const int SPINS = 64;
+
+// Yields of an idle server before it starts sleeping.
+const int YIELDS = 1024;
+
+// Sleep of an idle server between two polls.
+const std::chrono::microseconds IDLE_SLEEP(50);
+
+} // namespace
+
+/**
+ * Thread local state: the clients the thread registered, with the id of
+ * their map. Exiting threads hand their clients back for reuse.
+ */
+struct DelegationThreadState {
+  std::vector<std::pair<uint64_t, std::shared_ptr<DelegationHashMap::Client>>>
+      clients;
+
+  ~DelegationThreadState() {
+    for (auto &c : clients) {
+      c.second->owned.store(false, std::memory_order_release);
+    }
+  }
+};
+
+DelegationHashMap::DelegationHashMap(int servers, Hasher hasher)
+    : AbstractHashMap(), id(nextId++), clientCount(0), ready(0), stop(false) {
+  if (servers < 1) {
+    std::__throw_out_of_range("servers value is out of range.");
+  }
+  this->hasher = hasher;
+  this->servers.resize(servers);
+  for (int s = 0; s < servers; ++s) {
+    this->servers[s].thread = std::thread(&DelegationHashMap::serve, this, s);
+  }
+  while (ready.load(std::memory_order_acquire) < servers) {
+    std::this_thread::yield();
+  }
+}
+
+void DelegationHashMap::serve(int s) {
+  // Build the shard on its server, on the server's node.
+  if (NumaTopology::nodes() > 1) {
+    NumaTopology::pin(s % NumaTopology::nodes());
+  }
+  servers[s].shard.reset(new ChainHashMap(hasher));
+  ChainHashMap &shard = *servers[s].shard;
+  ready.fetch_add(1, std::memory_order_release);
+
+  int idle = 0;
+  while (true) {
+    // Read stop first: a request queued before it was set is then seen by
+    // this pass.
+    const bool stopping = stop.load(std::memory_order_acquire);
+    const int n = clientCount.load(std::memory_order_acquire);
+    int work = 0;
+    for (int c = 0; c < n; ++c) {
+      work += drain(clients[c]->rings[s], shard);
+    }
+    if (work > 0) {
+      idle = 0;
+    } else if (stopping) {
+      // Clients are gone and every ring is empty.
+      return;
+    } else if (++idle < SPINS) {
+      cpuRelax();
+    } else if (idle < SPINS + YIELDS) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+  }
+}
+
+int DelegationHashMap::drain(Ring &ring, ChainHashMap &shard) {
+  const uint64_t head = ring.head.load(std::memory_order_acquire);
+  const uint64_t first = ring.completed.load(std::memory_order_relaxed);
+  for (uint64_t t = first; t < head; ++t) {
+    Request &r = ring.slots[t % RING_SIZE];
+    bool result = false;
+    switch (r.op) {
+    case INSERT:
+      result = shard.insert(std::move(r.key));
+      break;
+    case SEARCH:
+      result = shard.search(r.view);
+      break;
+    case REMOVE:
+      result = shard.remove(r.view);
+      break;
+    }
+    if (r.result != nullptr) {
+      *r.result = result;
+    }
+    if (r.done) {
+      r.done(result);
+      r.done = nullptr;
+    }
+  }
+  // Answer the whole run at once.
+  if (head != first) {
+    ring.completed.store(head, std::memory_order_release);
+  }
+  return head - first;
+}
+
+DelegationHashMap::Client &DelegationHashMap::client() const {
+  static thread_local DelegationThreadState state;
+  for (auto &c : state.clients) {
+    if (c.first == id) {
+      return *c.second;
+    }
+  }
+  // Forget the clients of destroyed maps.
+  for (size_t i = 0; i < state.clients.size();) {
+    if (state.clients[i].second->detached.load(std::memory_order_acquire)) {
+      state.clients[i] = std::move(state.clients.back());
+      state.clients.pop_back();
+    } else {
+      ++i;
+    }
+  }
+
+  std::lock_guard<std::mutex> lk(registerMtx);
+  // Take over the client of an exited thread, its rings are drained by the
+  // servers regardless.
+  for (const std::shared_ptr<Client> &c : ownedClients) {
+    bool expected = false;
+    if (c->owned.compare_exchange_strong(expected, true,
+                                         std::memory_order_acquire)) {
+      state.clients.push_back({id, c});
+      return *c;
+    }
+  }
+  const int n = clientCount.load(std::memory_order_relaxed);
+  if (n == MAX_CLIENTS) {
+    std::__throw_runtime_error("DelegationHashMap: too many clients.");
+  }
+  std::shared_ptr<Client> c = std::make_shared<Client>(servers.size());
+  ownedClients.push_back(c);
+  clients[n] = c.get();
+  clientCount.store(n + 1, std::memory_order_release);
+  state.clients.push_back({id, c});
+  return *c;
+}
+
+uint64_t DelegationHashMap::submit(Client &c, uint64_t hash, Op op,
+                                   std::string &&key, std::string_view view,
+                                   bool *result,
+                                   std::function<void(bool)> done) const {
+  Ring &ring = c.rings[getServer(hash)];
+  const uint64_t ticket = ring.head.load(std::memory_order_relaxed);
+  // Wait for the slot to be answered if the ring is full.
+  if (ticket >= RING_SIZE) {
+    wait(ring, ticket - RING_SIZE);
+  }
+  Request &r = ring.slots[ticket % RING_SIZE];
+  r.op = op;
+  r.key = std::move(key);
+  // A null view means the request owns its key.
+  r.view = view.data() == nullptr ? std::string_view(r.key) : view;
+  r.result = result;
+  r.done = std::move(done);
+  ring.head.store(ticket + 1, std::memory_order_release);
+  return ticket;
+}
+
+void DelegationHashMap::wait(const Ring &ring, uint64_t ticket) {
+  for (int i = 0; ring.completed.load(std::memory_order_acquire) <= ticket;
+       ++i) {
+    if (i < SPINS) {
+      cpuRelax();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool DelegationHashMap::call(Op op, std::string &&key,
+                             std::string_view view) const {
+  Client &c = client();
+  const uint64_t h = hash(view.data() == nullptr ? key : view);
+  bool result;
+  const uint64_t ticket =
+      submit(c, h, op, std::move(key), view, &result, nullptr);
+  wait(c.rings[getServer(h)], ticket);
+  return result;
+}
+
+void DelegationHashMap::submitAsync(Op op, std::string &&key,
+                                    std::function<void(bool)> done) const {
+  const uint64_t h = hash(key);
+  submit(client(), h, op, std::move(key), std::string_view(), nullptr,
+         std::move(done));
+}
+
+bool DelegationHashMap::insert(std::string &&key) {
+  return call(INSERT, std::move(key), std::string_view());
+}
+
+bool DelegationHashMap::search(std::string_view key) const {
+  return call(SEARCH, std::string(), key);
+}
+
+bool DelegationHashMap::remove(std::string_view key) {
+  return call(REMOVE, std::string(), key);
+}
+
+void DelegationHashMap::insertBatch(std::string *keys, int n, bool *results) {
+  Client &c = client();
+  // Last ticket queued at each server, plus one; 0 if none.
+  std::vector<uint64_t> last(servers.size(), 0);
+  for (int i = 0; i < n; ++i) {
+    const uint64_t h = hash(keys[i]);
+    last[getServer(h)] = submit(c, h, INSERT, std::move(keys[i]),
+                                std::string_view(), &results[i], nullptr) +
+                         1;
+  }
+  for (size_t s = 0; s < servers.size(); ++s) {
+    if (last[s] > 0) {
+      wait(c.rings[s], last[s] - 1);
+    }
+  }
+}
+
+void DelegationHashMap::searchBatch(const std::string_view *keys, int n,
+                                    bool *results) const {
+  Client &c = client();
+  std::vector<uint64_t> last(servers.size(), 0);
+  for (int i = 0; i < n; ++i) {
+    const uint64_t h = hash(keys[i]);
+    last[getServer(h)] =
+        submit(c, h, SEARCH, std::string(), keys[i], &results[i], nullptr) + 1;
+  }
+  for (size_t s = 0; s < servers.size(); ++s) {
+    if (last[s] > 0) {
+      wait(c.rings[s], last[s] - 1);
+    }
+  }
+}
+
+void DelegationHashMap::removeBatch(const std::string_view *keys, int n,
+                                    bool *results) {
+  Client &c = client();
+  std::vector<uint64_t> last(servers.size(), 0);
+  for (int i = 0; i < n; ++i) {
+    const uint64_t h = hash(keys[i]);
+    last[getServer(h)] =
+        submit(c, h, REMOVE, std::string(), keys[i], &results[i], nullptr) + 1;
+  }
+  for (size_t s = 0; s < servers.size(); ++s) {
+    if (last[s] > 0) {
+      wait(c.rings[s], last[s] - 1);
+    }
+  }
+}
+
+std::future<bool> DelegationHashMap::insertAsync(std::string key) {
+  auto promise = std::make_shared<std::promise<bool>>();
+  std::future<bool> future = promise->get_future();
+  submitAsync(INSERT, std::move(key),
+              [promise](bool result) { promise->set_value(result); });
+  return future;
+}
+
+std::future<bool> DelegationHashMap::searchAsync(std::string_view key) const {
+  auto promise = std::make_shared<std::promise<bool>>();
+  std::future<bool> future = promise->get_future();
+  submitAsync(SEARCH, std::string(key),
+              [promise](bool result) { promise->set_value(result); });
+  return future;
+}
+
+std::future<bool> DelegationHashMap::removeAsync(std::string_view key) {
+  auto promise = std::make_shared<std::promise<bool>>();
+  std::future<bool> future = promise->get_future();
+  submitAsync(REMOVE, std::string(key),
+              [promise](bool result) { promise->set_value(result); });
+  return future;
+}
+
+void DelegationHashMap::insertAsync(std::string key,
+                                    std::function<void(bool)> done) {
+  submitAsync(INSERT, std::move(key), std::move(done));
+}
+
+void DelegationHashMap::searchAsync(std::string_view key,
+                                    std::function<void(bool)> done) const {
+  submitAsync(SEARCH, std::string(key), std::move(done));
+}
+
+void DelegationHashMap::removeAsync(std::string_view key,
+                                    std::function<void(bool)> done) {
+  submitAsync(REMOVE, std::string(key), std::move(done));
+}
+
+int DelegationHashMap::size() const {
+  int total = 0;
+  for (const Server &s : servers) {
+    total += s.shard->size();
+  }
+  return total;
+}
+
+int DelegationHashMap::serverCount() const { return servers.size(); }
+
+uint64_t DelegationHashMap::hash(std::string_view s) const { return hasher(s); }
+
+int DelegationHashMap::getServer(const uint64_t hash) const {
+  // Scale the high 32 bits, the shards use the low bits for their buckets.
+  return ((hash >> 32) * servers.size()) >> 32;
+}
+
+DelegationHashMap::~DelegationHashMap() {
+  stop.store(true, std::memory_order_release);
+  for (Server &s : servers) {
+    s.thread.join();
+  }
+  std::lock_guard<std::mutex> lk(registerMtx);
+  for (const std::shared_ptr<Client> &c : ownedClients) {
+    c->detached.store(true, std::memory_order_release);
+  }
+}
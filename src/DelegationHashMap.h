@@ -0,0 +1,168 @@
+#ifndef DELEGATION_HASH_MAP_H
+#define DELEGATION_HASH_MAP_H
+#include "AbstractHashMap.h"
+#include "BucketLocks.h"
+#include "ChainHashMap.h"
+#include "Hasher.h"
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A hashmap where every shard is owned by one server thread and all other
+ * threads delegate their operations to the owners.
+ *
+ * Each client thread gets one single producer, single consumer ring per
+ * server. A client writes a request into its ring and publishes it by moving
+ * the head; the server takes every request published since its last visit,
+ * applies them to its single threaded shard and answers the whole run with
+ * one store of the ring's completion counter. Clients never touch shard
+ * memory, so there are no locks and hot buckets stay in their server's
+ * cache.
+ *
+ * The synchronous methods wait for their answer. The asynchronous ones
+ * return as soon as the request is queued and complete a std::future or call
+ * a callback on the server thread, which must not call back into the map.
+ * The batch methods queue a whole batch before waiting for it.
+ */
+class DelegationHashMap : public AbstractHashMap {
+
+public:
+  // Constructor.
+  DelegationHashMap(int servers, Hasher = wyHash); // number of server threads, hash function
+
+  // Insertion.
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
+
+  // Search.
+  bool search(std::string_view) const;
+
+  // Deletion.
+  bool remove(std::string_view);
+
+  // Batched operations, see AbstractHashMap.
+  void insertBatch(std::string *keys, int n, bool *results);
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
+  void removeBatch(const std::string_view *keys, int n, bool *results);
+
+  // Asynchronous operations, the key is copied into the request.
+  std::future<bool> insertAsync(std::string);
+  std::future<bool> searchAsync(std::string_view) const;
+  std::future<bool> removeAsync(std::string_view);
+
+  // Asynchronous operations calling done(result) on the server thread.
+  void insertAsync(std::string, std::function<void(bool)> done);
+  void searchAsync(std::string_view, std::function<void(bool)> done) const;
+  void removeAsync(std::string_view, std::function<void(bool)> done);
+
+  // Size.
+  int size() const;
+
+  // Number of server threads.
+  int serverCount() const;
+
+  // Destructor, answers every queued request before the servers stop.
+  ~DelegationHashMap();
+
+  // Maximum number of threads which can use a map over its lifetime at the
+  // same time.
+  static const int MAX_CLIENTS = 512;
+
+  // Number of requests a client can have queued at one server.
+  static const int RING_SIZE = 256;
+
+private:
+  enum Op { INSERT, SEARCH, REMOVE };
+
+  struct Request {
+    Op op;
+    // Owned key, for insertions and asynchronous requests.
+    std::string key;
+    // Key to use, points into key or at the waiting client's key.
+    std::string_view view;
+    // Where to store the result for a waiting client, else nullptr.
+    bool *result;
+    // Called with the result for asynchronous requests.
+    std::function<void(bool)> done;
+  };
+
+  // Requests of one client to one server.
+  struct Ring {
+    // Number of requests published, written by the client.
+    alignas(CACHE_LINE) std::atomic<uint64_t> head{0};
+    // Number of requests answered, written by the server.
+    alignas(CACHE_LINE) std::atomic<uint64_t> completed{0};
+    alignas(CACHE_LINE) Request slots[RING_SIZE];
+  };
+
+  // A client thread's rings, one per server.
+  struct Client {
+    explicit Client(int servers) : rings(new Ring[servers]) {}
+    std::unique_ptr<Ring[]> rings;
+    // Whether a live thread owns the client.
+    std::atomic<bool> owned{true};
+    // Set once the map is destroyed.
+    std::atomic<bool> detached{false};
+  };
+
+  // A shard and the thread owning it.
+  struct Server {
+    std::unique_ptr<ChainHashMap> shard;
+    std::thread thread;
+  };
+
+  // Unique id of the map, thread local client handles are keyed by it.
+  const uint64_t id;
+
+  Hasher hasher;
+
+  std::vector<Server> servers;
+
+  // Clients registered so far; servers poll the first clientCount. Threads
+  // register on their first operation, searches included.
+  mutable Client *clients[MAX_CLIENTS];
+  mutable std::atomic<int> clientCount;
+  mutable std::vector<std::shared_ptr<Client>> ownedClients;
+  mutable std::mutex registerMtx;
+
+  // Number of servers whose shard is built.
+  std::atomic<int> ready;
+
+  std::atomic<bool> stop;
+
+  // Loop of server s.
+  void serve(int s);
+
+  // Answer the requests published on a ring, returns how many there were.
+  int drain(Ring &, ChainHashMap &);
+
+  // The calling thread's client, registered on first use.
+  Client &client() const;
+
+  // Queue a request at the server of a hash and return its ticket.
+  uint64_t submit(Client &, uint64_t hash, Op, std::string &&key,
+                  std::string_view view, bool *result,
+                  std::function<void(bool)> done) const;
+
+  // Wait until a ring has answered the request with a ticket.
+  static void wait(const Ring &, uint64_t ticket);
+
+  // Queue an asynchronous request.
+  void submitAsync(Op, std::string &&key, std::function<void(bool)> done) const;
+
+  // Run a synchronous request.
+  bool call(Op, std::string &&key, std::string_view view) const;
+
+  // A utility method to compute the hash of a given string.
+  uint64_t hash(std::string_view) const;
+
+  // Server owning a hash, from its high bits.
+  int getServer(const uint64_t hash) const;
+
+  friend struct DelegationThreadState;
+};
+#endif // DELEGATION_HASH_MAP_H
@@ -0,0 +1,133 @@
+#include "EpochManager.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Memory waiting for a grace period.
+struct Retired {
+  void *p;
+  void (*deleter)(void *);
+  uint64_t epoch;
+};
+
+// Memory left behind by threads which exited before it could be freed. It is
+// freed by whichever thread collects next, or at program exit.
+struct Orphans {
+  std::mutex mtx;
+  std::vector<Retired> list;
+  ~Orphans() {
+    for (Retired &r : list) {
+      r.deleter(r.p);
+    }
+  }
+};
+
+Orphans &orphans() {
+  static Orphans o;
+  return o;
+}
+
+// Free every entry of the list which was retired at least two epochs ago.
+void freeExpired(std::vector<Retired> &list, uint64_t epoch) {
+  auto it = std::partition(list.begin(), list.end(), [epoch](const Retired &r) {
+    return r.epoch + 2 > epoch;
+  });
+  for (auto jt = it; jt != list.end(); ++jt) {
+    jt->deleter(jt->p);
+  }
+  list.erase(it, list.end());
+}
+
+} // namespace
+
+EpochManager::Slot EpochManager::slots[EpochManager::MAX_THREADS];
+std::atomic<uint64_t> EpochManager::globalEpoch(1);
+
+/**
+ * Thread local state: the claimed announcement slot, the Guard nesting depth
+ * and the memory this thread retired.
+ */
+struct EpochThreadState {
+  int slot = -1;
+  int nest = 0;
+  std::vector<Retired> limbo;
+
+  EpochThreadState() {
+    // Make sure the orphan list outlives every thread's state.
+    orphans();
+    for (int i = 0; i < EpochManager::MAX_THREADS; ++i) {
+      bool expected = false;
+      if (EpochManager::slots[i].used.compare_exchange_strong(expected,
+                                                               true)) {
+        slot = i;
+        return;
+      }
+    }
+    std::__throw_runtime_error("EpochManager: too many threads.");
+  }
+
+  ~EpochThreadState() {
+    EpochManager::slots[slot].epoch.store(0);
+    if (!limbo.empty()) {
+      Orphans &o = orphans();
+      std::lock_guard<std::mutex> lk(o.mtx);
+      o.list.insert(o.list.end(), limbo.begin(), limbo.end());
+    }
+    EpochManager::slots[slot].used.store(false);
+  }
+};
+
+static EpochThreadState &threadState() {
+  thread_local EpochThreadState state;
+  return state;
+}
+
+EpochManager::Guard::Guard() {
+  EpochThreadState &ts = threadState();
+  if (ts.nest++ == 0) {
+    slots[ts.slot].epoch.store(globalEpoch.load());
+    // The announcement must be visible before any shared pointer is read.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+EpochManager::Guard::~Guard() {
+  EpochThreadState &ts = threadState();
+  if (--ts.nest == 0) {
+    slots[ts.slot].epoch.store(0, std::memory_order_release);
+  }
+}
+
+void EpochManager::retire(void *p, void (*deleter)(void *)) {
+  EpochThreadState &ts = threadState();
+  ts.limbo.push_back({p, deleter, globalEpoch.load()});
+  if (ts.limbo.size() % 64 == 0) {
+    collect();
+  }
+}
+
+void EpochManager::collect() {
+  EpochThreadState &ts = threadState();
+  tryAdvance();
+  const uint64_t epoch = globalEpoch.load();
+  freeExpired(ts.limbo, epoch);
+  Orphans &o = orphans();
+  std::unique_lock<std::mutex> lk(o.mtx, std::try_to_lock);
+  if (lk.owns_lock()) {
+    freeExpired(o.list, epoch);
+  }
+}
+
+void EpochManager::tryAdvance() {
+  uint64_t epoch = globalEpoch.load();
+  for (int i = 0; i < MAX_THREADS; ++i) {
+    const uint64_t e = slots[i].epoch.load();
+    if (e != 0 && e != epoch) {
+      return;
+    }
+  }
+  globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+}
@@ -0,0 +1,61 @@
+#ifndef EPOCH_MANAGER_H
+#define EPOCH_MANAGER_H
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Epoch based memory reclamation shared by the concurrent hash maps.
+ *
+ * A thread holds a Guard while it dereferences memory that other threads may
+ * unlink concurrently. Unlinked memory is handed to retire() instead of being
+ * deleted, and is only freed once every thread that could still see it has
+ * dropped its Guard.
+ */
+class EpochManager {
+
+public:
+  // Pins the calling thread to the current epoch. Guards may be nested.
+  class Guard {
+  public:
+    Guard();
+    ~Guard();
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+  };
+
+  // Defer deleting an object until no pinned thread can still reach it.
+  template <typename T> static void retire(T *p) {
+    retire(const_cast<void *>(static_cast<const void *>(p)),
+           [](void *q) { delete static_cast<T *>(q); });
+  }
+
+  // Defer calling deleter(p) until no pinned thread can still reach p.
+  static void retire(void *p, void (*deleter)(void *));
+
+  // Try to advance the epoch and free whatever this thread retired that is
+  // now safe to free.
+  static void collect();
+
+private:
+  // Maximum number of threads which can be registered at the same time.
+  static const int MAX_THREADS = 512;
+
+  // Per thread announcement, padded so pinning never shares a cache line.
+  struct alignas(64) Slot {
+    // 0 when the thread is not pinned, else the epoch it pinned.
+    std::atomic<uint64_t> epoch;
+    // Whether a live thread owns this slot.
+    std::atomic<bool> used;
+  };
+
+  static Slot slots[MAX_THREADS];
+
+  // The global epoch, starts at 1.
+  static std::atomic<uint64_t> globalEpoch;
+
+  // Advance the global epoch if every pinned thread has observed it.
+  static void tryAdvance();
+
+  friend struct EpochThreadState;
+};
+#endif // EPOCH_MANAGER_H
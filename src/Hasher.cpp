@@ -0,0 +1,106 @@
+#include "Hasher.h"
+#include <cstring>
+
+uint64_t polynomialHash(std::string_view s) {
+  /**
+   * Polynomial hashing.
+   * h = ( s[0] + s[1] * p + s[2] * p^2 + s[3] * p^3 + ... ) % mod.
+   */
+  const int p = 97;
+  const long long int mod = 1e9 + 7;
+  long long h = 0;
+  long long pow = 1;
+  for (char c : s) {
+    h += ((c - '!' + 1) * pow) % mod;
+    h %= mod;
+    pow *= p;
+    pow %= mod;
+  }
+  return h;
+}
+
+uint64_t fnv1aHash(std::string_view s) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (char c : s) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+namespace {
+
+const uint64_t WY_SECRET[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                               0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+inline void wyMum(uint64_t *a, uint64_t *b) {
+  __uint128_t r = *a;
+  r *= *b;
+  *a = static_cast<uint64_t>(r);
+  *b = static_cast<uint64_t>(r >> 64);
+}
+
+inline uint64_t wyMix(uint64_t a, uint64_t b) {
+  wyMum(&a, &b);
+  return a ^ b;
+}
+
+inline uint64_t read8(const uint8_t *p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+inline uint64_t read4(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline uint64_t read3(const uint8_t *p, size_t k) {
+  return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+}
+
+} // namespace
+
+uint64_t wyHash(std::string_view s) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(s.data());
+  const size_t len = s.size();
+  uint64_t seed = wyMix(WY_SECRET[0], WY_SECRET[1]);
+  uint64_t a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+      b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = read3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = wyMix(read8(p) ^ WY_SECRET[1], read8(p + 8) ^ seed);
+        see1 = wyMix(read8(p + 16) ^ WY_SECRET[2], read8(p + 24) ^ see1);
+        see2 = wyMix(read8(p + 32) ^ WY_SECRET[3], read8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wyMix(read8(p) ^ WY_SECRET[1], read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read8(p + i - 16);
+    b = read8(p + i - 8);
+  }
+  a ^= WY_SECRET[1];
+  b ^= seed;
+  wyMum(&a, &b);
+  return wyMix(a ^ WY_SECRET[0] ^ len, b ^ WY_SECRET[1]);
+}
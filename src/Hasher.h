@@ -0,0 +1,23 @@
+#ifndef HASHER_H
+#define HASHER_H
+#include <cstdint>
+#include <string_view>
+
+/**
+ * A hash function policy. Every map takes a Hasher in its constructor and
+ * maps the 64-bit result to a bucket with a power-of-two mask, so the low
+ * bits of the hash must be well mixed.
+ */
+typedef uint64_t (*Hasher)(std::string_view);
+
+// The original polynomial hash, h = sum(s[i] * 97^i) % (1e9 + 7). Only 30
+// bits wide and one division per character; kept for comparison.
+uint64_t polynomialHash(std::string_view);
+
+// FNV-1a, one multiply per byte.
+uint64_t fnv1aHash(std::string_view);
+
+// wyhash (final version 4), reads 8 bytes at a time. The default.
+uint64_t wyHash(std::string_view);
+
+#endif // HASHER_H
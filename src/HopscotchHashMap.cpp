@@ -0,0 +1,387 @@
+#include "HopscotchHashMap.h"
+#include "EpochManager.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// Marks a slot claimed by an insertion, never dereferenced.
+const InlineKey *const BUSY = reinterpret_cast<const InlineKey *>(uintptr_t(1));
+
+// Bit of distance d in a hop bitmap.
+uint64_t bit(int d) { return uint64_t(1) << d; }
+
+void destroyKey(void *p) { InlineKey::destroy(static_cast<InlineKey *>(p)); }
+
+} // namespace
+
+HopscotchHashMap::Table::Table(int buckets)
+    : buckets(buckets), data(new Bucket[buckets]) {
+  for (int b = 0; b < buckets; ++b) {
+    data[b].hop.store(0, std::memory_order_relaxed);
+    data[b].tag.store(0, std::memory_order_relaxed);
+    data[b].key.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+HopscotchHashMap::HopscotchHashMap(Hasher hasher, int buckets)
+    : AbstractHashMap(), segments(new Segment[SEGMENTS]) {
+  if (buckets < 1) {
+    std::__throw_out_of_range(
+        "HopscotchHashMap: buckets value is out of range.");
+  }
+  this->hasher = hasher;
+  this->count = 0;
+  // A power of two, and at least one neighborhood so that the slots of a
+  // neighborhood are distinct.
+  int n = NEIGHBORHOOD;
+  while (n < buckets) {
+    n *= 2;
+  }
+  table = new Table(n);
+  for (int i = 0; i < SEGMENTS; ++i) {
+    segments[i].timestamp.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool HopscotchHashMap::insert(std::string &&key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const uint32_t tag = getTag(h);
+  // Allocate before taking any lock.
+  const InlineKey *k = InlineKey::create(key);
+  while (true) {
+    Table *t = table.load();
+    const int mask = t->buckets - 1;
+    const int home = getIndex(h, t->buckets);
+    Segment &segment = segmentOf(home);
+    segment.mtx.lock();
+    // The table may have been doubled while we were waiting.
+    if (table.load() != t) {
+      segment.mtx.unlock();
+      continue;
+    }
+    if (findSlot(t, home, key, tag) >= 0) {
+      segment.mtx.unlock();
+      InlineKey::destroy(k);
+      return false;
+    }
+    // Claim the closest free slot which can be hopped into the
+    // neighborhood. Other insertions probe the same slots under other
+    // segments' locks, hence the CAS.
+    int d = -1;
+    bool busy = false;
+    const int range = std::min(ADD_RANGE, t->buckets);
+    for (int e = 0; e < range && d < 0 && !busy; ++e) {
+      std::atomic<const InlineKey *> &free = t->data[(home + e) & mask].key;
+      const InlineKey *expected = nullptr;
+      if (free.load(std::memory_order_relaxed) != nullptr ||
+          !free.compare_exchange_strong(expected, BUSY)) {
+        continue;
+      }
+      d = e;
+      while (d >= NEIGHBORHOOD) {
+        const int next = hop(t, home, d);
+        if (next < 0) {
+          // Give the slot back and try a farther one.
+          t->data[(home + d) & mask].key.store(nullptr,
+                                               std::memory_order_relaxed);
+          busy = next == -2;
+          d = -1;
+          break;
+        }
+        d = next;
+      }
+    }
+    if (d < 0) {
+      segment.mtx.unlock();
+      // Wait for the busy segment, or make room.
+      if (busy) {
+        std::this_thread::yield();
+      } else {
+        grow(t);
+      }
+      continue;
+    }
+    Bucket &slot = t->data[(home + d) & mask];
+    slot.tag.store(tag, std::memory_order_relaxed);
+    slot.key.store(k, std::memory_order_release);
+    Bucket &bucket = t->data[home];
+    bucket.hop.store(bucket.hop.load(std::memory_order_relaxed) | bit(d),
+                     std::memory_order_release);
+    segment.mtx.unlock();
+    ++count;
+    return true;
+  }
+}
+
+int HopscotchHashMap::hop(Table *t, int home, int free) {
+  const int mask = t->buckets - 1;
+  const Segment &own = segmentOf(home);
+  bool busy = false;
+  // The farthest bucket first, so that the slot moves back as far as
+  // possible.
+  for (int d = NEIGHBORHOOD - 1; d > 0; --d) {
+    const int i = (home + free - d) & mask;
+    Segment &segment = segmentOf(i);
+    const bool locked = &segment != &own;
+    if (locked && !segment.mtx.try_lock()) {
+      busy = true;
+      continue;
+    }
+    const int freed = moveKey(t, i, d, &segment.timestamp);
+    if (locked) {
+      segment.mtx.unlock();
+    }
+    if (freed >= 0) {
+      return free - d + freed;
+    }
+  }
+  return busy ? -2 : -1;
+}
+
+int HopscotchHashMap::moveKey(Table *t, int i, int d,
+                              std::atomic<unsigned> *timestamp) {
+  const int mask = t->buckets - 1;
+  Bucket &bucket = t->data[i];
+  const uint64_t hop = bucket.hop.load(std::memory_order_relaxed);
+  const uint64_t before = hop & (bit(d) - 1);
+  if (before == 0) {
+    return -1;
+  }
+  const int e = __builtin_ctzll(before);
+  Bucket &source = t->data[(i + e) & mask];
+  Bucket &target = t->data[(i + d) & mask];
+  target.tag.store(source.tag.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+  target.key.store(source.key.load(std::memory_order_relaxed),
+                   std::memory_order_release);
+  bucket.hop.store(hop | bit(d), std::memory_order_release);
+  if (timestamp != nullptr) {
+    // A search which then misses the old slot sees the new timestamp.
+    timestamp->fetch_add(1, std::memory_order_acq_rel);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  source.key.store(BUSY, std::memory_order_relaxed);
+  bucket.hop.store(bucket.hop.load(std::memory_order_relaxed) & ~bit(e),
+                   std::memory_order_release);
+  return e;
+}
+
+bool HopscotchHashMap::search(std::string_view key) const {
+  EpochManager::Guard guard;
+  return find(key, hash(key));
+}
+
+void HopscotchHashMap::searchBatch(const std::string_view *keys, int n,
+                                   bool *results) const {
+  EpochManager::Guard guard;
+  uint64_t h[BATCH_CHUNK];
+  for (int base = 0; base < n; base += BATCH_CHUNK) {
+    const int m = std::min(BATCH_CHUNK, n - base);
+    // Overlap the misses on the home buckets.
+    const Table *t = table.load();
+    for (int i = 0; i < m; ++i) {
+      h[i] = hash(keys[base + i]);
+      __builtin_prefetch(&t->data[getIndex(h[i], t->buckets)]);
+    }
+    for (int i = 0; i < m; ++i) {
+      results[base + i] = find(keys[base + i], h[i]);
+    }
+  }
+}
+
+bool HopscotchHashMap::find(std::string_view key, uint64_t h) const {
+  const uint32_t tag = getTag(h);
+  while (true) {
+    const Table *t = table.load();
+    const int home = getIndex(h, t->buckets);
+    const Segment &segment = segmentOf(home);
+    const unsigned timestamp =
+        segment.timestamp.load(std::memory_order_acquire);
+    if (findSlot(t, home, key, tag) >= 0) {
+      return true;
+    }
+    // The key may have been moved under the search, or the table replaced.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (segment.timestamp.load(std::memory_order_relaxed) == timestamp &&
+        table.load(std::memory_order_relaxed) == t) {
+      return false;
+    }
+  }
+}
+
+int HopscotchHashMap::findSlot(const Table *t, int home, std::string_view key,
+                               uint32_t tag) {
+  const int mask = t->buckets - 1;
+  uint64_t hop = t->data[home].hop.load(std::memory_order_acquire);
+  while (hop != 0) {
+    const int d = __builtin_ctzll(hop);
+    const Bucket &slot = t->data[(home + d) & mask];
+    if (slot.tag.load(std::memory_order_relaxed) == tag) {
+      const InlineKey *k = slot.key.load(std::memory_order_acquire);
+      if (k != nullptr && k != BUSY && k->view() == key) {
+        return d;
+      }
+    }
+    hop &= hop - 1;
+  }
+  return -1;
+}
+
+bool HopscotchHashMap::remove(std::string_view key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const uint32_t tag = getTag(h);
+  while (true) {
+    Table *t = table.load();
+    const int home = getIndex(h, t->buckets);
+    Segment &segment = segmentOf(home);
+    segment.mtx.lock();
+    if (table.load() != t) {
+      segment.mtx.unlock();
+      continue;
+    }
+    const int d = findSlot(t, home, key, tag);
+    // Do nothing if the key doesn't exist.
+    if (d < 0) {
+      segment.mtx.unlock();
+      return false;
+    }
+    Bucket &bucket = t->data[home];
+    Bucket &slot = t->data[(home + d) & (t->buckets - 1)];
+    const InlineKey *k = slot.key.load(std::memory_order_relaxed);
+    bucket.hop.store(bucket.hop.load(std::memory_order_relaxed) & ~bit(d),
+                     std::memory_order_release);
+    slot.key.store(nullptr, std::memory_order_release);
+    segment.mtx.unlock();
+    --count;
+    // Lock-free searches may still be comparing against k.
+    EpochManager::retire(const_cast<InlineKey *>(k), destroyKey);
+    return true;
+  }
+}
+
+void HopscotchHashMap::grow(Table *t) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < SEGMENTS; ++i) {
+    segments[i].mtx.lock();
+  }
+  if (table.load() != t) {
+    for (int i = SEGMENTS - 1; i >= 0; --i) {
+      segments[i].mtx.unlock();
+    }
+    return;
+  }
+  // No insertion holds a claimed slot now, every key of t is a real one.
+  int buckets = t->buckets * 2;
+  Table *next = nullptr;
+  while (next == nullptr) {
+    next = new Table(buckets);
+    for (int b = 0; b < t->buckets; ++b) {
+      const InlineKey *k = t->data[b].key.load(std::memory_order_relaxed);
+      if (k != nullptr && !place(next, k, hash(k->view()))) {
+        // Start over twice as large; every key is still in t.
+        delete next;
+        next = nullptr;
+        buckets *= 2;
+        break;
+      }
+    }
+  }
+  table.store(next);
+  for (int i = SEGMENTS - 1; i >= 0; --i) {
+    segments[i].mtx.unlock();
+  }
+  // Searches may still be walking the old buckets.
+  EpochManager::retire(t);
+  rehashLog.record(std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count(),
+                   1);
+}
+
+bool HopscotchHashMap::place(Table *t, const InlineKey *key, uint64_t hash) {
+  const int mask = t->buckets - 1;
+  const int home = getIndex(hash, t->buckets);
+  const int range = std::min(ADD_RANGE, t->buckets);
+  int d = -1;
+  for (int e = 0; e < range && d < 0; ++e) {
+    if (t->data[(home + e) & mask].key.load(std::memory_order_relaxed) !=
+        nullptr) {
+      continue;
+    }
+    d = e;
+    while (d >= NEIGHBORHOOD) {
+      int i = NEIGHBORHOOD - 1;
+      int freed = -1;
+      while (i > 0 &&
+             (freed = moveKey(t, (home + d - i) & mask, i, nullptr)) < 0) {
+        --i;
+      }
+      if (freed < 0) {
+        // Free the slot moved keys left claimed and try a farther one.
+        t->data[(home + d) & mask].key.store(nullptr,
+                                             std::memory_order_relaxed);
+        d = -1;
+        break;
+      }
+      d = d - i + freed;
+    }
+  }
+  if (d < 0) {
+    return false;
+  }
+  Bucket &slot = t->data[(home + d) & mask];
+  slot.tag.store(getTag(hash), std::memory_order_relaxed);
+  slot.key.store(key, std::memory_order_relaxed);
+  Bucket &bucket = t->data[home];
+  bucket.hop.store(bucket.hop.load(std::memory_order_relaxed) | bit(d),
+                   std::memory_order_relaxed);
+  return true;
+}
+
+int HopscotchHashMap::size() const { return count; }
+
+int HopscotchHashMap::capacity() const { return table.load()->buckets; }
+
+double HopscotchHashMap::loadFactor() const {
+  return double(size()) / capacity();
+}
+
+MapStats HopscotchHashMap::stats() const {
+  EpochManager::Guard guard;
+  const Table *t = table.load();
+  MapStats s;
+  s.size = size();
+  for (int b = 0; b < t->buckets; ++b) {
+    s.addBucket(
+        __builtin_popcountll(t->data[b].hop.load(std::memory_order_relaxed)));
+  }
+  rehashLog.fill(s);
+  return s;
+}
+
+HopscotchHashMap::Segment &HopscotchHashMap::segmentOf(int bucket) const {
+  return segments[(bucket >> SEGMENT_SHIFT) & (SEGMENTS - 1)];
+}
+
+uint32_t HopscotchHashMap::getTag(uint64_t hash) { return hash >> 32; }
+
+int HopscotchHashMap::getIndex(uint64_t hash, int buckets) {
+  return hash & (buckets - 1);
+}
+
+uint64_t HopscotchHashMap::hash(std::string_view s) const { return hasher(s); }
+
+HopscotchHashMap::~HopscotchHashMap() {
+  Table *t = table.load();
+  for (int b = 0; b < t->buckets; ++b) {
+    const InlineKey *k = t->data[b].key.load();
+    if (k != nullptr && k != BUSY) {
+      InlineKey::destroy(k);
+    }
+  }
+  delete t;
+}
@@ -0,0 +1,170 @@
+#ifndef HOPSCOTCH_HASH_MAP_H
+#define HOPSCOTCH_HASH_MAP_H
+#include "AbstractHashMap.h"
+#include "Hasher.h"
+#include "MapStats.h"
+#include "SlabAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/**
+ * A thread safe hopscotch hashmap implementation (Herlihy, Shavit and
+ * Tzafrir).
+ *
+ * Every key lives within NEIGHBORHOOD slots of its home bucket, and every
+ * bucket keeps a hop bitmap of the slots in its neighborhood that hold its
+ * keys. A search only visits the slots its home bucket's bitmap points at,
+ * nearly always on the home bucket's cache line or the next one, however
+ * full the table is; tables fill up to load factors above 0.9.
+ *
+ * An insertion locks the segment of its home bucket, claims the closest
+ * free slot and, while that slot is out of the neighborhood, hops it
+ * backwards: a key of an earlier bucket which may still reach the free slot
+ * moves there, freeing a slot closer to home. A hop locks the segment of the
+ * moved key's home bucket with a try_lock, so writers never wait on each
+ * other in a cycle, and bumps that segment's timestamp. The table is doubled
+ * with every segment held when no hop is possible.
+ *
+ * Searches take no lock. A hit is final; a miss is validated against the
+ * home segment's timestamp and repeated if a key homed there was moved
+ * meanwhile. Removed keys and replaced tables go to the EpochManager.
+ */
+class HopscotchHashMap : public AbstractHashMap {
+
+public:
+  // Slots a key may be from its home bucket, one bit each in a hop bitmap.
+  // With 32, hops start failing at load factors around 0.85.
+  static const int NEIGHBORHOOD = 64;
+
+  // Initial number of buckets unless given to the constructor.
+  // For 1e6 elements, the load would be about 0.5.
+  static const int DEFAULT_BUCKETS = 2 * 1024 * 1024;
+
+  // Constructor. Buckets are rounded up to a power of two.
+  HopscotchHashMap(Hasher = wyHash, int buckets = DEFAULT_BUCKETS);
+
+  // Insertion. Returns false if the key is already in the map.
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
+
+  // Search.
+  bool search(std::string_view) const;
+
+  // Deletion.
+  bool remove(std::string_view);
+
+  // Batched search, see AbstractHashMap.
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
+
+  // Size.
+  int size() const;
+
+  // Number of buckets, one slot each.
+  int capacity() const;
+
+  // Slots in use, size() / capacity().
+  double loadFactor() const;
+
+  // Keys per home bucket (as chain lengths) and growths, see
+  // AbstractHashMap.
+  MapStats stats() const;
+
+  // Destructor.
+  ~HopscotchHashMap();
+
+  HopscotchHashMap(const HopscotchHashMap &) = delete;
+  HopscotchHashMap &operator=(const HopscotchHashMap &) = delete;
+
+private:
+  // Number of segments, each a lock and a timestamp.
+  static const int SEGMENTS = 4096;
+
+  // Consecutive buckets in a segment, so that most hops stay within the
+  // segment already held.
+  static const int SEGMENT_SHIFT = 5;
+
+  // Farthest slot from home probed for a free one before growing.
+  static const int ADD_RANGE = 4096;
+
+  struct Bucket {
+    // Bit d is set if slot index + d holds a key of this bucket.
+    std::atomic<uint64_t> hop;
+    // High 32 bits of the hash of the key in this slot.
+    std::atomic<uint32_t> tag;
+    // nullptr for a free slot, BUSY while claimed by an insertion.
+    std::atomic<const InlineKey *> key;
+  };
+
+  // One generation of the hash map. Keys are freed by the map, not here,
+  // as a doubled table takes them over.
+  struct Table {
+    explicit Table(int buckets);
+
+    // Number of buckets, a power of two.
+    const int buckets;
+
+    // The buckets.
+    std::unique_ptr<Bucket[]> data;
+  };
+
+  // A lock with the number of moves of keys homed in its buckets.
+  struct alignas(64) Segment {
+    std::mutex mtx;
+    std::atomic<unsigned> timestamp;
+  };
+
+  // The hash function.
+  Hasher hasher;
+
+  // The current table.
+  std::atomic<Table *> table;
+
+  // SEGMENTS segments.
+  std::unique_ptr<Segment[]> segments;
+
+  // Number and durations of the growths.
+  RehashLog rehashLog;
+
+  // A utility method to compute the hash of a given string.
+  uint64_t hash(std::string_view) const;
+
+  // Tag of a hash.
+  static uint32_t getTag(uint64_t hash);
+
+  // Home bucket of a hash in a table of the given size.
+  static int getIndex(uint64_t hash, int buckets);
+
+  // Segment of a bucket.
+  Segment &segmentOf(int bucket) const;
+
+  // Lock-free search of a key with the given hash. Caller holds an
+  // EpochManager::Guard.
+  bool find(std::string_view, uint64_t hash) const;
+
+  // Distance from home of the slot holding key in t, -1 if it isn't there.
+  static int findSlot(const Table *t, int home, std::string_view key,
+                      uint32_t tag);
+
+  // Hop the claimed free slot at distance `free` from home one step back
+  // towards its neighborhood, home's segment being held. Returns the new
+  // distance, -1 if no key may move into the slot, or -2 if a key might have
+  // but its segment was busy.
+  int hop(Table *t, int home, int free);
+
+  // Move the first key of bucket i before slot i + d into that free slot,
+  // bumping timestamp if given between writing the key there and freeing
+  // its old slot, which is left claimed. Caller holds i's segment if the
+  // table is shared. Returns the distance of the freed slot from i, -1 if i
+  // has no such key.
+  static int moveKey(Table *t, int i, int d, std::atomic<unsigned> *timestamp);
+
+  // Double t with every segment held, unless it was replaced already.
+  void grow(Table *t);
+
+  // Place a key in t without locking, for a table nobody else sees yet.
+  // Returns false if its neighborhood is full.
+  static bool place(Table *t, const InlineKey *key, uint64_t hash);
+};
+#endif // HOPSCOTCH_HASH_MAP_H
@@ -0,0 +1,108 @@
+#include "MapStats.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+void MapStats::addBucket(unsigned n) {
+  if (n >= chainLengths.size()) {
+    chainLengths.resize(n + 1);
+  }
+  ++chainLengths[n];
+  ++buckets;
+  keys += n;
+}
+
+int MapStats::maxChain() const {
+  return chainLengths.empty() ? 0 : chainLengths.size() - 1;
+}
+
+double MapStats::emptyRatio() const {
+  return buckets == 0 ? 0 : double(chainLengths[0]) / buckets;
+}
+
+double MapStats::loadFactor() const {
+  return buckets == 0 ? 0 : double(keys) / buckets;
+}
+
+double MapStats::chiSquare() const {
+  const double expected = loadFactor();
+  if (expected == 0) {
+    return 0;
+  }
+  double sum = 0;
+  for (size_t n = 0; n < chainLengths.size(); ++n) {
+    sum += chainLengths[n] * (n - expected) * (n - expected) / expected;
+  }
+  return sum;
+}
+
+double MapStats::chiSquareRatio() const {
+  return buckets > 1 ? chiSquare() / (buckets - 1) : 0;
+}
+
+uint64_t MapStats::contended() const {
+  uint64_t sum = 0;
+  for (uint64_t c : contention) {
+    sum += c;
+  }
+  return sum;
+}
+
+void MapStats::print(std::ostream &out) const {
+  out << "Size: " << size << " keys.\n";
+  if (buckets > 0) {
+    out << "Buckets: " << buckets << ", load factor " << loadFactor()
+        << ", empty " << 100 * emptyRatio() << "%, max chain " << maxChain()
+        << ", chi-square/df " << chiSquareRatio() << ".\n";
+    out << "Chain lengths:";
+    for (size_t n = 0; n < chainLengths.size(); ++n) {
+      if (chainLengths[n] > 0) {
+        out << " " << n << ":" << chainLengths[n];
+      }
+    }
+    out << "\n";
+  }
+  if (!contention.empty() && contended() == 0) {
+    out << "Contended locks: none over " << contention.size() << " stripes.\n";
+  } else if (!contention.empty()) {
+    const auto hottest = std::max_element(contention.begin(), contention.end());
+    out << "Contended locks: " << contended() << " acquisitions over "
+        << contention.size() - std::count(contention.begin(), contention.end(),
+                                          uint64_t(0))
+        << " of " << contention.size() << " stripes, hottest stripe "
+        << hottest - contention.begin() << " (" << *hottest << ").\n";
+  }
+  if (rehashes > 0) {
+    out << "Rehashes: " << rehashes << ", " << rehashSeconds * 1000
+        << " ms in total, longest " << maxRehashSeconds * 1000 << " ms, last on "
+        << rehashThreads << " threads.\n";
+  }
+}
+
+void MapStats::dump(const std::string &path) const {
+  if (path == "-") {
+    print(std::cout);
+    return;
+  }
+  std::ofstream file(path, std::ios::app);
+  if (!file) {
+    std::__throw_runtime_error("MapStats: cannot open the dump file.");
+  }
+  print(file);
+}
+
+void RehashLog::record(double seconds, int threads) {
+  std::lock_guard<std::mutex> lk(mtx);
+  ++count;
+  total += seconds;
+  longest = std::max(longest, seconds);
+  this->threads = threads;
+}
+
+void RehashLog::fill(MapStats &stats) const {
+  std::lock_guard<std::mutex> lk(mtx);
+  stats.rehashes = count;
+  stats.rehashSeconds = total;
+  stats.maxRehashSeconds = longest;
+  stats.rehashThreads = threads;
+}
@@ -0,0 +1,96 @@
+#ifndef MAP_STATS_H
+#define MAP_STATS_H
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * A snapshot of a hash map's internals, returned by AbstractHashMap::stats().
+ *
+ * The bucket fields are gathered by walking the buckets when stats() is
+ * called, so they cost nothing until then; maps without chained buckets leave
+ * them empty. Lock contention is only counted after collectStats(true).
+ * Writers running during stats() make the snapshot approximate, not unsafe.
+ */
+struct MapStats {
+  // Number of keys.
+  long size = 0;
+
+  // Number of buckets, 0 for maps without chained buckets.
+  long buckets = 0;
+
+  // Keys found walking the buckets.
+  long keys = 0;
+
+  // chainLengths[n] is the number of buckets holding n keys.
+  std::vector<long> chainLengths;
+
+  // Contended lock acquisitions per lock stripe, empty unless collected.
+  std::vector<uint64_t> contention;
+
+  // Resizes so far, their total and longest duration in seconds, and the
+  // number of threads which migrated buckets in the last one.
+  long rehashes = 0;
+  double rehashSeconds = 0;
+  double maxRehashSeconds = 0;
+  int rehashThreads = 0;
+
+  // Add a bucket holding n keys.
+  void addBucket(unsigned n);
+
+  // Longest chain.
+  int maxChain() const;
+
+  // Fraction of the buckets which are empty.
+  double emptyRatio() const;
+
+  // Keys per bucket.
+  double loadFactor() const;
+
+  // Pearson's chi-square statistic of the chain lengths against the keys
+  // spread uniformly over the buckets.
+  double chiSquare() const;
+
+  // chiSquare() over its degrees of freedom, buckets - 1. Close to 1 for a
+  // hash which spreads the keys like a random function, far above 1 when
+  // they cluster.
+  double chiSquareRatio() const;
+
+  // Total number of contended lock acquisitions.
+  uint64_t contended() const;
+
+  // Write the snapshot as text.
+  void print(std::ostream &) const;
+
+  // Append the snapshot to a file, or write it to stdout for "-".
+  void dump(const std::string &path) const;
+};
+
+/**
+ * Number and durations of a map's resizes, recorded by the thread which
+ * completes each resize.
+ */
+class RehashLog {
+
+public:
+  // Record a resize.
+  void record(double seconds, int threads);
+
+  // Copy the counts into a snapshot.
+  void fill(MapStats &) const;
+
+private:
+  mutable std::mutex mtx;
+
+  long count = 0;
+
+  double total = 0;
+
+  double longest = 0;
+
+  // Threads of the last resize.
+  int threads = 0;
+};
+#endif // MAP_STATS_H
@@ -0,0 +1,105 @@
+#include "NumaTopology.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Parse a kernel CPU or node list such as "0-3,8-11".
+std::vector<int> parseList(const std::string &list) {
+  std::vector<int> ids;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    const size_t dash = range.find('-');
+    const int first = std::stoi(range.substr(0, dash));
+    const int last =
+        dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int id = first; id <= last; ++id) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+bool readLine(const std::string &path, std::string &line) {
+  std::ifstream file(path);
+  return bool(std::getline(file, line));
+}
+
+} // namespace
+
+NumaTopology::Topology::Topology() {
+  const std::string root = "/sys/devices/system/node/";
+  std::string line;
+  if (readLine(root + "online", line)) {
+    for (int node : parseList(line)) {
+      std::string cpuList;
+      if (!readLine(root + "node" + std::to_string(node) + "/cpulist",
+                    cpuList)) {
+        cpus.clear();
+        break;
+      }
+      // Memory-only nodes have no CPUs to run shards on.
+      std::vector<int> ids = parseList(cpuList);
+      if (!ids.empty()) {
+        cpus.push_back(ids);
+      }
+    }
+  }
+  if (cpus.empty()) {
+    std::vector<int> all;
+    const int n = std::max(1u, std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < n; ++cpu) {
+      all.push_back(cpu);
+    }
+    cpus.push_back(all);
+  }
+}
+
+const NumaTopology::Topology &NumaTopology::topology() {
+  static const Topology t;
+  return t;
+}
+
+int NumaTopology::nodes() { return topology().cpus.size(); }
+
+const std::vector<int> &NumaTopology::cpus(int node) {
+  return topology().cpus[node];
+}
+
+int NumaTopology::currentNode() {
+#ifdef __linux__
+  const int cpu = sched_getcpu();
+  const Topology &t = topology();
+  for (int node = 0; node < int(t.cpus.size()); ++node) {
+    for (int c : t.cpus[node]) {
+      if (c == cpu) {
+        return node;
+      }
+    }
+  }
+#endif
+  return 0;
+}
+
+bool NumaTopology::pin(int node) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus(node)) {
+    CPU_SET(cpu, &set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
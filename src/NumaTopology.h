@@ -0,0 +1,46 @@
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+#include <thread>
+#include <vector>
+
+/**
+ * The NUMA nodes of the machine and their CPUs, read once from
+ * /sys/devices/system/node. Where that is missing (single node machines,
+ * containers without /sys, other systems) the machine is reported as a
+ * single node holding every CPU, and pinning does nothing.
+ */
+class NumaTopology {
+
+public:
+  // Number of nodes, at least 1.
+  static int nodes();
+
+  // CPUs of a node.
+  static const std::vector<int> &cpus(int node);
+
+  // Node of the CPU the calling thread runs on, 0 if unknown.
+  static int currentNode();
+
+  // Restrict the calling thread to the CPUs of a node. Returns false if
+  // threads can't be pinned here.
+  static bool pin(int node);
+
+  // Run f() on a thread pinned to a node and wait for it. Memory f() touches
+  // first is placed on that node by the default first-touch policy.
+  template <typename F> static void runOn(int node, F f) {
+    std::thread t([node, &f]() {
+      pin(node);
+      f();
+    });
+    t.join();
+  }
+
+private:
+  struct Topology {
+    std::vector<std::vector<int>> cpus;
+    Topology();
+  };
+
+  static const Topology &topology();
+};
+#endif // NUMA_TOPOLOGY_H
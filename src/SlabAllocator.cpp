@@ -0,0 +1,140 @@
+#include "SlabAllocator.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+std::atomic<SlabAllocator::Cache *> SlabAllocator::caches(nullptr);
+std::atomic<size_t> SlabAllocator::reservedBytes(0);
+
+namespace {
+
+// Size class of a block of size bytes, size is at most MAX_SMALL.
+inline int sizeClassOf(size_t size) {
+  return size == 0 ? 0 : (size - 1) / SlabAllocator::ALIGNMENT;
+}
+
+} // namespace
+
+/**
+ * Hands the calling thread's cache back for adoption when the thread exits.
+ * Blocks the thread frees after that go through the cache's return lists
+ * like any other thread's frees.
+ */
+struct SlabThreadState {
+  // Cache owned by the calling thread.
+  static thread_local SlabAllocator::Cache *cache;
+
+  bool live = true;
+
+  ~SlabThreadState() {
+    if (cache != nullptr) {
+      cache->owned.store(false, std::memory_order_release);
+      cache = nullptr;
+    }
+    live = false;
+  }
+};
+
+thread_local SlabAllocator::Cache *SlabThreadState::cache = nullptr;
+
+SlabAllocator::Cache *SlabAllocator::threadCache() {
+  if (SlabThreadState::cache != nullptr) {
+    return SlabThreadState::cache;
+  }
+  // Register the exit hook. A thread which allocates again from a later
+  // thread_local destructor keeps its new cache for good.
+  static thread_local SlabThreadState state;
+  (void)state.live;
+  for (Cache *c = caches.load(std::memory_order_acquire); c != nullptr;
+       c = c->next) {
+    bool expected = false;
+    if (c->owned.compare_exchange_strong(expected, true,
+                                         std::memory_order_acquire)) {
+      return SlabThreadState::cache = c;
+    }
+  }
+  Cache *c = new Cache();
+  c->next = caches.load(std::memory_order_relaxed);
+  while (!caches.compare_exchange_weak(c->next, c, std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+  }
+  return SlabThreadState::cache = c;
+}
+
+void *SlabAllocator::allocate(size_t size) {
+  if (size > MAX_SMALL) {
+    if (void *p = std::malloc(size)) {
+      return p;
+    }
+    throw std::bad_alloc();
+  }
+  Cache *c = threadCache();
+  const int cls = sizeClassOf(size);
+  if (c->local[cls] == nullptr &&
+      c->remote[cls].load(std::memory_order_relaxed) != nullptr) {
+    // Take over everything other threads gave back.
+    c->local[cls] = c->remote[cls].exchange(nullptr, std::memory_order_acquire);
+  }
+  if (FreeBlock *b = c->local[cls]) {
+    c->local[cls] = b->next;
+    return b;
+  }
+  const size_t blockSize = (cls + 1) * ALIGNMENT;
+  if (c->bump[cls] != nullptr && c->bump[cls] + blockSize <= c->bumpEnd[cls]) {
+    void *p = c->bump[cls];
+    c->bump[cls] += blockSize;
+    return p;
+  }
+  return refill(c, cls);
+}
+
+void *SlabAllocator::refill(Cache *c, int cls) {
+  void *memory = std::aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  reservedBytes.fetch_add(SLAB_SIZE, std::memory_order_relaxed);
+  Slab *slab = new (memory) Slab{c, cls};
+  const size_t blockSize = (cls + 1) * ALIGNMENT;
+  char *first = reinterpret_cast<char *>(slab + 1);
+  c->bump[cls] = first + blockSize;
+  c->bumpEnd[cls] = static_cast<char *>(memory) + SLAB_SIZE;
+  return first;
+}
+
+void SlabAllocator::deallocate(void *p, size_t size) {
+  if (size > MAX_SMALL) {
+    std::free(p);
+    return;
+  }
+  const Slab *slab = reinterpret_cast<const Slab *>(
+      reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(SLAB_SIZE) - 1));
+  FreeBlock *b = static_cast<FreeBlock *>(p);
+  Cache *owner = slab->owner;
+  const int cls = slab->sizeClass;
+  if (owner == SlabThreadState::cache) {
+    b->next = owner->local[cls];
+    owner->local[cls] = b;
+    return;
+  }
+  b->next = owner->remote[cls].load(std::memory_order_relaxed);
+  while (!owner->remote[cls].compare_exchange_weak(
+      b->next, b, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+}
+
+size_t SlabAllocator::reserved() {
+  return reservedBytes.load(std::memory_order_relaxed);
+}
+
+const InlineKey *InlineKey::create(std::string_view key) {
+  const uint32_t n = key.size();
+  InlineKey *k = new (SlabAllocator::allocate(blockSize(n))) InlineKey();
+  k->length = n;
+  std::memcpy(k + 1, key.data(), n);
+  return k;
+}
+
+void InlineKey::destroy(const InlineKey *k) {
+  SlabAllocator::deallocate(const_cast<InlineKey *>(k), blockSize(k->length));
+}
@@ -0,0 +1,112 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * A per-thread slab allocator for small, short-lived blocks such as keys and
+ * chain nodes.
+ *
+ * Each thread owns a cache which carves SLAB_SIZE slabs into blocks of one
+ * size class and keeps a free list per class, so allocating and freeing on
+ * the owning thread takes no lock and no atomic. A block freed by another
+ * thread (for example by the EpochManager of whichever thread collected it)
+ * is pushed onto a lock-free return list of its owner, which the owner takes
+ * over in one exchange once its own free list is empty.
+ *
+ * Caches outlive their threads: a new thread adopts the cache of an exited
+ * one, together with its free blocks. Slabs are never given back to the
+ * system. Blocks larger than MAX_SMALL come from malloc.
+ */
+class SlabAllocator {
+
+public:
+  // Size of a slab, slabs are aligned to it.
+  static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+  // Blocks are ALIGNMENT aligned, and their sizes are rounded up to it.
+  static constexpr size_t ALIGNMENT = 16;
+
+  // Largest block served from slabs.
+  static constexpr size_t MAX_SMALL = 512;
+
+  // Allocate size bytes.
+  static void *allocate(size_t size);
+
+  // Free a block, size must be the size it was allocated with.
+  static void deallocate(void *p, size_t size);
+
+  // Bytes of slabs taken from the system so far.
+  static size_t reserved();
+
+private:
+  static constexpr int CLASSES = MAX_SMALL / ALIGNMENT;
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  struct Cache;
+
+  // Header at the start of every slab.
+  struct alignas(ALIGNMENT) Slab {
+    Cache *owner;
+    int sizeClass;
+  };
+
+  struct alignas(64) Cache {
+    // Free blocks, only touched by the owning thread.
+    FreeBlock *local[CLASSES] = {};
+    // Blocks freed by other threads.
+    std::atomic<FreeBlock *> remote[CLASSES] = {};
+    // Unused tail of the current slab of each class.
+    char *bump[CLASSES] = {};
+    char *bumpEnd[CLASSES] = {};
+    // Whether a live thread owns the cache.
+    std::atomic<bool> owned{true};
+    // Next cache in the list of all caches.
+    Cache *next = nullptr;
+  };
+
+  // Every cache ever created.
+  static std::atomic<Cache *> caches;
+
+  static std::atomic<size_t> reservedBytes;
+
+  // Cache of the calling thread, adopted or created on first use.
+  static Cache *threadCache();
+
+  // Carve a block of a class out of a fresh slab.
+  static void *refill(Cache *, int sizeClass);
+
+  friend struct SlabThreadState;
+};
+
+/**
+ * A key stored in a single SlabAllocator block: its length followed by its
+ * bytes.
+ */
+class InlineKey {
+
+public:
+  // Copy a key into a new block.
+  static const InlineKey *create(std::string_view);
+
+  // Free a key made by create().
+  static void destroy(const InlineKey *);
+
+  std::string_view view() const {
+    return std::string_view(reinterpret_cast<const char *>(this + 1), length);
+  }
+
+private:
+  InlineKey() = default;
+
+  // Size of the block holding a key of n bytes.
+  static size_t blockSize(uint32_t n) { return sizeof(InlineKey) + n; }
+
+  uint32_t length;
+};
+#endif // SLAB_ALLOCATOR_H
@@ -0,0 +1,160 @@
+#include "Snapshot.h"
+#include "EpochManager.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Number of buckets counted and copied by one task of a parallel save.
+const uint64_t CHUNK = 4096;
+
+} // namespace
+
+void writeSnapshot(const std::string &path, uint64_t buckets,
+                   const std::function<const VersionedBucket &(uint64_t)> &bucket,
+                   Hasher hasher, WorkerPool &pool) {
+  // Pinned for the whole save, so that keys removed after they were copied
+  // out of their bucket are not freed before they are written.
+  EpochManager::Guard guard;
+  // Copy one version of every bucket, then lay the buckets out one after the
+  // other. Both passes use the same copy, so writers may change the buckets
+  // meanwhile without the counts and the keys disagreeing.
+  const int chunks = (buckets + CHUNK - 1) / CHUNK;
+  std::vector<std::vector<VersionedBucket::KeyView>> views(chunks);
+  std::vector<uint64_t> first(buckets + 1);
+  std::vector<uint64_t> start(buckets + 1);
+  pool.parallelFor(chunks, [&](int c) {
+    for (uint64_t b = c * CHUNK; b < std::min(buckets, (c + 1) * CHUNK); ++b) {
+      const size_t keys = views[c].size();
+      bucket(b).snapshot(views[c]);
+      uint64_t bytes = 0;
+      for (size_t i = keys; i < views[c].size(); ++i) {
+        bytes += views[c][i].key.size();
+      }
+      first[b + 1] = views[c].size() - keys;
+      start[b + 1] = bytes;
+    }
+  });
+  for (uint64_t b = 0; b < buckets; ++b) {
+    first[b + 1] += first[b];
+    start[b + 1] += start[b];
+  }
+  const uint64_t count = first[buckets];
+  const uint64_t keyBytes = start[buckets];
+  const uint64_t length = SnapshotHeader::bytesStart(buckets, count) + keyBytes;
+
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::__throw_runtime_error("writeSnapshot: cannot create the file.");
+  }
+  if (ftruncate(fd, length) != 0) {
+    ::close(fd);
+    std::__throw_runtime_error("writeSnapshot: cannot size the file.");
+  }
+  void *map = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    std::__throw_runtime_error("writeSnapshot: cannot map the file.");
+  }
+  char *base = static_cast<char *>(map);
+  SnapshotHeader header = {};
+  std::memcpy(header.magic, SnapshotHeader::MAGIC, sizeof(header.magic));
+  header.buckets = buckets;
+  header.count = count;
+  header.keyBytes = keyBytes;
+  header.check = hasher(SnapshotHeader::CHECK_KEY);
+  std::memcpy(base, &header, sizeof(header));
+  std::memcpy(base + SnapshotHeader::firstStart(), first.data(),
+              (buckets + 1) * 8);
+  uint64_t *hashes = reinterpret_cast<uint64_t *>(
+      base + SnapshotHeader::hashesStart(buckets));
+  uint64_t *offsets = reinterpret_cast<uint64_t *>(
+      base + SnapshotHeader::offsetsStart(buckets, count));
+  char *bytes = base + SnapshotHeader::bytesStart(buckets, count);
+  offsets[count] = keyBytes;
+  pool.parallelFor(chunks, [&](int c) {
+    // The keys of a chunk are consecutive in the file.
+    uint64_t i = first[c * CHUNK];
+    uint64_t offset = start[c * CHUNK];
+    for (const VersionedBucket::KeyView &v : views[c]) {
+      hashes[i] = v.hash;
+      offsets[i] = offset;
+      std::memcpy(bytes + offset, v.key.data(), v.key.size());
+      ++i;
+      offset += v.key.size();
+    }
+  });
+  munmap(map, length);
+}
+
+SnapshotFile::SnapshotFile(const std::string &path, Hasher hasher) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::__throw_runtime_error("SnapshotFile: cannot open the file.");
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SnapshotHeader)) {
+    ::close(fd);
+    std::__throw_runtime_error("SnapshotFile: truncated file.");
+  }
+  length = st.st_size;
+#ifdef MAP_POPULATE
+  // Read the whole file in now, at disk speed, rather than fault it in page
+  // by page while loading.
+  const int mapFlags = MAP_PRIVATE | MAP_POPULATE;
+#else
+  const int mapFlags = MAP_PRIVATE;
+#endif
+  map = mmap(nullptr, length, PROT_READ, mapFlags, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    std::__throw_runtime_error("SnapshotFile: cannot map the file.");
+  }
+  const char *base = static_cast<const char *>(map);
+  header = reinterpret_cast<const SnapshotHeader *>(base);
+  // The bounds on buckets and count keep bytesStart() from overflowing, and
+  // the tables must fit before keyBytes is compared with what is left.
+  const uint64_t tablesEnd =
+      SnapshotHeader::bytesStart(header->buckets, header->count);
+  if (std::memcmp(header->magic, SnapshotHeader::MAGIC, 8) != 0 ||
+      header->buckets > length / 8 || header->count > length / 8 ||
+      tablesEnd > length || header->keyBytes != length - tablesEnd) {
+    munmap(map, length);
+    std::__throw_runtime_error("SnapshotFile: not a snapshot.");
+  }
+  if (header->check != hasher(SnapshotHeader::CHECK_KEY)) {
+    munmap(map, length);
+    std::__throw_runtime_error(
+        "SnapshotFile: snapshot of a map with another hash function.");
+  }
+  firsts = reinterpret_cast<const uint64_t *>(base +
+                                              SnapshotHeader::firstStart());
+  hashes = reinterpret_cast<const uint64_t *>(
+      base + SnapshotHeader::hashesStart(header->buckets));
+  offsets = reinterpret_cast<const uint64_t *>(
+      base + SnapshotHeader::offsetsStart(header->buckets, header->count));
+  bytes = base + SnapshotHeader::bytesStart(header->buckets, header->count);
+  // first(b) and key(i) trust the tables, check that they cut the keys and
+  // the key bytes exactly.
+  bool valid = firsts[0] == 0 && firsts[header->buckets] == header->count;
+  for (uint64_t b = 0; b < header->buckets && valid; ++b) {
+    valid = firsts[b] <= firsts[b + 1];
+  }
+  valid = valid && offsets[0] == 0 &&
+          offsets[header->count] == header->keyBytes;
+  for (uint64_t i = 0; i < header->count && valid; ++i) {
+    valid = offsets[i] <= offsets[i + 1];
+  }
+  if (!valid) {
+    munmap(map, length);
+    std::__throw_runtime_error("SnapshotFile: corrupt bucket or key table.");
+  }
+}
+
+SnapshotFile::~SnapshotFile() { munmap(map, length); }
@@ -0,0 +1,108 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "Hasher.h"
+#include "VersionedBucket.h"
+#include "WorkerPool.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * Layout of a snapshot file of a chained hash map:
+ *
+ *   SnapshotHeader
+ *   uint64_t first[buckets + 1]   bucket b holds keys [first[b], first[b + 1])
+ *   uint64_t hashes[count]        hash of key i
+ *   uint64_t offsets[count + 1]   key i is bytes [offsets[i], offsets[i + 1])
+ *   char bytes[keyBytes]          the keys, back to back
+ *
+ * The keys are laid out bucket by bucket and stored with their hashes, so
+ * loading a snapshot copies key bytes but never hashes a key. All integers
+ * are little endian, the sections are 8-byte aligned.
+ */
+struct SnapshotHeader {
+  static constexpr char MAGIC[8] = {'H', 'M', 'S', 'N', 'A', 'P', '1', '\n'};
+
+  // Key hashed into check, to tell the hash function of a snapshot.
+  static constexpr std::string_view CHECK_KEY = "snapshot";
+
+  char magic[8];
+  uint64_t buckets;
+  uint64_t count;
+  uint64_t keyBytes;
+  // Hash of CHECK_KEY, a snapshot only loads into a map hashing the same.
+  uint64_t check;
+
+  // Offsets of the sections, in bytes from the start of the file.
+  static uint64_t firstStart() { return sizeof(SnapshotHeader); }
+  static uint64_t hashesStart(uint64_t buckets) {
+    return firstStart() + (buckets + 1) * 8;
+  }
+  static uint64_t offsetsStart(uint64_t buckets, uint64_t count) {
+    return hashesStart(buckets) + count * 8;
+  }
+  static uint64_t bytesStart(uint64_t buckets, uint64_t count) {
+    return offsetsStart(buckets, count) + (count + 1) * 8;
+  }
+};
+
+/**
+ * Write a snapshot of a map's buckets to path, bucket(b) being bucket b of
+ * buckets. The pool counts and then copies chunks of buckets in parallel,
+ * straight into a mapping of the file. Writers may run meanwhile: each
+ * bucket is written as one consistent version of it, copied lock-free.
+ */
+void writeSnapshot(const std::string &path, uint64_t buckets,
+                   const std::function<const VersionedBucket &(uint64_t)> &bucket,
+                   Hasher, WorkerPool &);
+
+/**
+ * A snapshot file mapped read-only. Throws if the file is not a snapshot or
+ * was written with another hash function.
+ */
+class SnapshotFile {
+
+public:
+  // Number of buckets rebuilt by one task of a parallel load.
+  static const int CHUNK = 4096;
+
+  // Constructor, maps the file.
+  SnapshotFile(const std::string &path, Hasher);
+
+  // Number of buckets of the map the snapshot was taken of.
+  uint64_t buckets() const { return header->buckets; }
+
+  // Number of keys.
+  uint64_t size() const { return header->count; }
+
+  // First key of bucket b, and one past its last key at first(b + 1).
+  uint64_t first(uint64_t b) const { return firsts[b]; }
+
+  // Hash of key i.
+  uint64_t hash(uint64_t i) const { return hashes[i]; }
+
+  // Key i.
+  std::string_view key(uint64_t i) const {
+    return std::string_view(bytes + offsets[i], offsets[i + 1] - offsets[i]);
+  }
+
+  // Number of chunks of CHUNK buckets.
+  int chunks() const { return (buckets() + CHUNK - 1) / CHUNK; }
+
+  // Destructor, unmaps the file.
+  ~SnapshotFile();
+
+  SnapshotFile(const SnapshotFile &) = delete;
+  SnapshotFile &operator=(const SnapshotFile &) = delete;
+
+private:
+  void *map;
+  size_t length;
+  const SnapshotHeader *header;
+  const uint64_t *firsts;
+  const uint64_t *hashes;
+  const uint64_t *offsets;
+  const char *bytes;
+};
+#endif // SNAPSHOT_H
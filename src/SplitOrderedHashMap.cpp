@@ -0,0 +1,237 @@
+#include "SplitOrderedHashMap.h"
+#include "EpochManager.h"
+
+namespace {
+
+// Pointer tagging helpers, the lowest bit of a link marks its owner deleted.
+inline bool isMarked(uintptr_t p) { return p & 1; }
+
+template <typename T> inline T *pointer(uintptr_t p) {
+  return reinterpret_cast<T *>(p & ~uintptr_t(1));
+}
+
+inline uint64_t reverseBits(uint64_t x) {
+  x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+  x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+  return __builtin_bswap64(x);
+}
+
+} // namespace
+
+SplitOrderedHashMap::Node::Node(uint64_t soKey, std::string key)
+    : soKey(soKey), key(std::move(key)), next(0) {}
+
+SplitOrderedHashMap::SplitOrderedHashMap(float loadFactor, int BUCKETS,
+                                         Hasher hasher)
+    : AbstractHashMap() {
+  if (loadFactor <= 0) {
+    std::__throw_out_of_range("load factor value is out of range.");
+  }
+  if (BUCKETS < 1 || uint32_t(BUCKETS) > MAX_BUCKETS) {
+    std::__throw_out_of_range("BUCKETS value is out of range.");
+  }
+  this->loadFactor = loadFactor;
+  this->hasher = hasher;
+  // Round the number of buckets up to a power of two.
+  uint32_t buckets = 1;
+  while (buckets < uint32_t(BUCKETS)) {
+    buckets <<= 1;
+  }
+  this->BUCKETS = buckets;
+  for (int s = 0; s < SEGMENTS; ++s) {
+    segments[s] = nullptr;
+  }
+  // Bucket 0's sentinel is the head of the whole list.
+  segments[0] = new std::atomic<Node *>[1];
+  segments[0][0] = new Node(sentinelKey(0), "");
+}
+
+bool SplitOrderedHashMap::insert(std::string &&key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const uint32_t buckets = BUCKETS.load();
+  Node *head = getBucket(h & (buckets - 1));
+  Node *node = new Node(regularKey(h), std::move(key));
+  if (insertNode(head, node) != node) {
+    delete node;
+    return false;
+  }
+  // Grow by publishing a larger bucket count; buckets are filled lazily.
+  if (++count > loadFactor * buckets && buckets < MAX_BUCKETS) {
+    uint32_t expected = buckets;
+    BUCKETS.compare_exchange_strong(expected, buckets * 2);
+  }
+  return true;
+}
+
+bool SplitOrderedHashMap::search(std::string_view key) const {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  Node *head = getBucket(h & (BUCKETS.load() - 1));
+  std::atomic<uintptr_t> *prev;
+  Node *curr;
+  return find(head, regularKey(h), key, prev, curr);
+}
+
+bool SplitOrderedHashMap::remove(std::string_view key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const uint64_t soKey = regularKey(h);
+  Node *head = getBucket(h & (BUCKETS.load() - 1));
+  std::atomic<uintptr_t> *prev;
+  Node *curr;
+  while (true) {
+    // Do nothing if the key doesn't exist.
+    if (!find(head, soKey, key, prev, curr)) {
+      return false;
+    }
+    // Logically delete curr by marking its next link.
+    uintptr_t next = curr->next.load();
+    if (isMarked(next) ||
+        !curr->next.compare_exchange_strong(next, next | 1)) {
+      continue;
+    }
+    // Then try to unlink it; if that fails a later find will.
+    uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+    if (prev->compare_exchange_strong(expected, next)) {
+      EpochManager::retire(curr);
+    } else {
+      find(head, soKey, key, prev, curr);
+    }
+    --count;
+    return true;
+  }
+}
+
+int SplitOrderedHashMap::size() const { return count; }
+
+int SplitOrderedHashMap::getBuckets() const { return BUCKETS; }
+
+std::atomic<SplitOrderedHashMap::Node *> &
+SplitOrderedHashMap::bucketSlot(uint32_t bucket) const {
+  const int s = bucket == 0 ? 0 : 32 - __builtin_clz(bucket);
+  const uint32_t offset = s == 0 ? 0 : bucket - (1u << (s - 1));
+  std::atomic<Node *> *segment = segments[s].load();
+  if (segment == nullptr) {
+    const uint32_t length = s == 0 ? 1 : 1u << (s - 1);
+    std::atomic<Node *> *fresh = new std::atomic<Node *>[length];
+    for (uint32_t i = 0; i < length; ++i) {
+      fresh[i].store(nullptr, std::memory_order_relaxed);
+    }
+    if (segments[s].compare_exchange_strong(segment, fresh)) {
+      segment = fresh;
+    } else {
+      delete[] fresh;
+    }
+  }
+  return segment[offset];
+}
+
+SplitOrderedHashMap::Node *SplitOrderedHashMap::getBucket(uint32_t bucket) const {
+  Node *sentinel = bucketSlot(bucket).load();
+  if (sentinel == nullptr) {
+    sentinel = initializeBucket(bucket);
+  }
+  return sentinel;
+}
+
+SplitOrderedHashMap::Node *
+SplitOrderedHashMap::initializeBucket(uint32_t bucket) const {
+  // The parent bucket is the bucket with the highest set bit cleared; the
+  // new sentinel splits the parent's keys in split order.
+  const uint32_t parent = bucket & ~(1u << (31 - __builtin_clz(bucket)));
+  Node *head = getBucket(parent);
+  Node *sentinel = new Node(sentinelKey(bucket), "");
+  Node *existing = insertNode(head, sentinel);
+  if (existing != sentinel) {
+    delete sentinel;
+    sentinel = existing;
+  }
+  Node *expected = nullptr;
+  bucketSlot(bucket).compare_exchange_strong(expected, sentinel);
+  return sentinel;
+}
+
+SplitOrderedHashMap::Node *SplitOrderedHashMap::insertNode(Node *head,
+                                                           Node *node) const {
+  std::atomic<uintptr_t> *prev;
+  Node *curr;
+  while (true) {
+    if (find(head, node->soKey, node->key, prev, curr)) {
+      return curr;
+    }
+    node->next.store(reinterpret_cast<uintptr_t>(curr));
+    uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+    if (prev->compare_exchange_strong(expected,
+                                      reinterpret_cast<uintptr_t>(node))) {
+      return node;
+    }
+  }
+}
+
+bool SplitOrderedHashMap::find(Node *head, uint64_t soKey,
+                               std::string_view key,
+                               std::atomic<uintptr_t> *&prev,
+                               Node *&curr) const {
+  // Sentinels never carry a key, so comparing soKey alone is enough for them.
+  const bool sentinel = (soKey & 1) == 0;
+retry:
+  prev = &head->next;
+  curr = pointer<Node>(prev->load());
+  while (curr != nullptr) {
+    const uintptr_t next = curr->next.load();
+    // prev was changed or its owner got deleted under us.
+    if (prev->load() != reinterpret_cast<uintptr_t>(curr)) {
+      goto retry;
+    }
+    if (isMarked(next)) {
+      // curr is logically deleted, help unlink it.
+      uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+      if (!prev->compare_exchange_strong(expected, next & ~uintptr_t(1))) {
+        goto retry;
+      }
+      EpochManager::retire(curr);
+      curr = pointer<Node>(next);
+      continue;
+    }
+    if (curr->soKey > soKey) {
+      return false;
+    }
+    if (curr->soKey == soKey) {
+      if (sentinel) {
+        return true;
+      }
+      // Keys with the same hash are kept sorted by the key itself.
+      const int cmp = curr->key.compare(key);
+      if (cmp >= 0) {
+        return cmp == 0;
+      }
+    }
+    prev = &curr->next;
+    curr = pointer<Node>(next);
+  }
+  return false;
+}
+
+uint64_t SplitOrderedHashMap::regularKey(uint64_t hash) {
+  return reverseBits(hash | (1ull << 63));
+}
+
+uint64_t SplitOrderedHashMap::sentinelKey(uint32_t bucket) {
+  return reverseBits(bucket);
+}
+
+uint64_t SplitOrderedHashMap::hash(std::string_view s) const { return hasher(s); }
+
+SplitOrderedHashMap::~SplitOrderedHashMap() {
+  Node *curr = segments[0][0].load();
+  while (curr != nullptr) {
+    Node *next = pointer<Node>(curr->next.load());
+    delete curr;
+    curr = next;
+  }
+  for (int s = 0; s < SEGMENTS; ++s) {
+    delete[] segments[s].load();
+  }
+}
@@ -0,0 +1,107 @@
+#ifndef SPLIT_ORDERED_HASH_MAP_H
+#define SPLIT_ORDERED_HASH_MAP_H
+#include "AbstractHashMap.h"
+#include "Hasher.h"
+#include <atomic>
+#include <cstdint>
+
+/**
+ * A lock-free, resizable hashmap based on Shalev and Shavit's split-ordered
+ * lists.
+ *
+ * All keys live in a single lock-free linked list (Michael's algorithm),
+ * sorted by the bit reversal of their hash. Every bucket is a pointer to a
+ * sentinel node inside that list, so doubling the number of buckets never
+ * moves a key: a new bucket's sentinel is lazily spliced in after its parent
+ * bucket's sentinel the first time the bucket is used.
+ *
+ * Unlinked nodes are freed through the EpochManager.
+ */
+class SplitOrderedHashMap : public AbstractHashMap {
+
+public:
+  // Constructor, loadFactor is the average number of keys per bucket at
+  // which the number of buckets doubles.
+  SplitOrderedHashMap(float, int, Hasher = wyHash); // loadFactor, BUCKETS, hash function
+
+  // Insertion, returns false if the key already exists.
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
+
+  // Search.
+  bool search(std::string_view) const;
+
+  // Deletion.
+  bool remove(std::string_view);
+
+  // Size.
+  int size() const;
+
+  // Current number of buckets.
+  int getBuckets() const;
+
+  // Destructor.
+  ~SplitOrderedHashMap();
+
+private:
+  // A node of the split-ordered list, either a bucket sentinel or a key.
+  struct Node {
+    Node(uint64_t, std::string);
+
+    // Bit reversed hash; odd for keys, even for sentinels.
+    const uint64_t soKey;
+
+    // The key, empty for sentinels.
+    const std::string key;
+
+    // Next node, the lowest bit marks this node as logically deleted.
+    std::atomic<uintptr_t> next;
+  };
+
+  // Buckets are stored in lazily allocated segments so the bucket array
+  // never has to be copied: segment 0 holds bucket 0 and segment s > 0
+  // holds buckets [2^(s-1), 2^s).
+  static const int SEGMENTS = 31;
+
+  // Largest number of buckets the segments can hold.
+  static const uint32_t MAX_BUCKETS = 1u << 30;
+
+  float loadFactor;
+
+  // The hash function.
+  Hasher hasher;
+
+  // Current number of buckets, always a power of two.
+  std::atomic<uint32_t> BUCKETS;
+
+  mutable std::atomic<std::atomic<Node *> *> segments[SEGMENTS];
+
+  // Returns the sentinel of a bucket, initializing it if needed.
+  Node *getBucket(uint32_t) const;
+
+  // Splice the sentinel of a bucket into the list.
+  Node *initializeBucket(uint32_t) const;
+
+  // Returns the slot holding a bucket's sentinel.
+  std::atomic<Node *> &bucketSlot(uint32_t) const;
+
+  // Michael's list search starting at head. On return prev is the link
+  // pointing to curr, the first node not smaller than (soKey, key).
+  // Marked nodes met on the way are unlinked and retired.
+  bool find(Node *head, uint64_t soKey, std::string_view key,
+            std::atomic<uintptr_t> *&prev, Node *&curr) const;
+
+  // Insert a node after head, returns the node with the same key on
+  // failure, or node itself on success.
+  Node *insertNode(Node *head, Node *node) const;
+
+  // Split-order key of a regular key.
+  static uint64_t regularKey(uint64_t hash);
+
+  // Split-order key of a bucket sentinel.
+  static uint64_t sentinelKey(uint32_t bucket);
+
+  // A utility method to compute the hash of a given string.
+  uint64_t hash(std::string_view) const;
+};
+#endif // SPLIT_ORDERED_HASH_MAP_H
@@ -0,0 +1,302 @@
+#include "SwissHashMap.h"
+#include "EpochManager.h"
+#include <algorithm>
+#include <chrono>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Eight EMPTY control bytes.
+const uint64_t EMPTY_WORD = 0x8080808080808080ull;
+
+void destroyKey(void *p) { InlineKey::destroy(static_cast<InlineKey *>(p)); }
+
+} // namespace
+
+SwissHashMap::Table::Table(int slots)
+    : slots(slots), groups(slots / GROUP_WIDTH),
+      ctrl(new std::atomic<uint64_t>[slots / 8]),
+      keys(new std::atomic<const InlineKey *>[slots]),
+      growthLeft(slots / 8 * MAX_LOAD) {
+  for (int w = 0; w < slots / 8; ++w) {
+    ctrl[w].store(EMPTY_WORD, std::memory_order_relaxed);
+  }
+  for (int s = 0; s < slots; ++s) {
+    keys[s].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+SwissHashMap::SwissHashMap(Hasher hasher, int slots)
+    : AbstractHashMap(), mutexArr(LOCKS) {
+  if (slots < 1) {
+    std::__throw_out_of_range("SwissHashMap: slots value is out of range.");
+  }
+  this->hasher = hasher;
+  this->count = 0;
+  int n = GROUP_WIDTH;
+  while (n < slots) {
+    n *= 2;
+  }
+  table = new Table(n);
+}
+
+bool SwissHashMap::insert(std::string &&key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const int8_t tag = h >> 57;
+  // Allocate before taking any lock.
+  const InlineKey *k = InlineKey::create(key);
+  while (true) {
+    Table *t = table.load();
+    int group = h & (t->groups - 1);
+    bool replaced = false;
+    // Triangular probing over the groups visits every group exactly once as
+    // the number of groups is a power of two.
+    for (int i = 1; i <= t->groups; ++i) {
+      std::lock_guard<std::mutex> lk(lockOf(group));
+      // The table may have been doubled while we were probing.
+      if (table.load() != t) {
+        replaced = true;
+        break;
+      }
+      uint32_t mask = matchEmptyOrDeleted(t, group);
+      if (mask) {
+        const int bit = __builtin_ctz(mask);
+        // Reusing a tombstone is free, an EMPTY slot must be left to take.
+        if ((match(t, group, EMPTY) >> bit & 1) &&
+            t->growthLeft.fetch_sub(1) <= 0) {
+          t->growthLeft.fetch_add(1);
+          break;
+        }
+        const int slot = group * GROUP_WIDTH + bit;
+        // Publish the key before the control byte which makes it visible to
+        // lock-free searches.
+        t->keys[slot].store(k, std::memory_order_release);
+        setCtrl(t, slot, tag);
+        ++count;
+        return true;
+      }
+      group = (group + i) & (t->groups - 1);
+    }
+    // No EMPTY slot may be taken, or every slot is taken.
+    if (!replaced) {
+      rehash(t);
+    }
+  }
+}
+
+bool SwissHashMap::search(std::string_view key) const {
+  EpochManager::Guard guard;
+  return find(key, hash(key));
+}
+
+void SwissHashMap::searchBatch(const std::string_view *keys, int n,
+                               bool *results) const {
+  EpochManager::Guard guard;
+  uint64_t h[BATCH_CHUNK];
+  for (int base = 0; base < n; base += BATCH_CHUNK) {
+    const int m = std::min(BATCH_CHUNK, n - base);
+    // Overlap the misses on the first group's control bytes and slots.
+    const Table *t = table.load();
+    for (int i = 0; i < m; ++i) {
+      h[i] = hash(keys[base + i]);
+      const int group = h[i] & (t->groups - 1);
+      __builtin_prefetch(t->ctrl.get() + group * (GROUP_WIDTH / 8));
+      __builtin_prefetch(t->keys.get() + group * GROUP_WIDTH);
+    }
+    for (int i = 0; i < m; ++i) {
+      results[base + i] = find(keys[base + i], h[i]);
+    }
+  }
+}
+
+bool SwissHashMap::find(std::string_view key, uint64_t h) const {
+  const int8_t tag = h >> 57;
+  const Table *t = table.load();
+  int group = h & (t->groups - 1);
+  for (int i = 1; i <= t->groups; ++i) {
+    uint32_t mask = match(t, group, tag);
+    while (mask) {
+      const int slot = group * GROUP_WIDTH + __builtin_ctz(mask);
+      // The slot may have been reused since its control byte was read; the
+      // key compared is then another live or retired key, never freed
+      // memory.
+      const InlineKey *k = t->keys[slot].load(std::memory_order_acquire);
+      if (k != nullptr && k->view() == key) {
+        return true;
+      }
+      mask &= mask - 1;
+    }
+    // A key is never placed past a group which still has an empty slot.
+    if (match(t, group, EMPTY)) {
+      return false;
+    }
+    group = (group + i) & (t->groups - 1);
+  }
+  return false;
+}
+
+bool SwissHashMap::remove(std::string_view key) {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  const int8_t tag = h >> 57;
+  while (true) {
+    Table *t = table.load();
+    int group = h & (t->groups - 1);
+    bool replaced = false;
+    for (int i = 1; i <= t->groups; ++i) {
+      std::lock_guard<std::mutex> lk(lockOf(group));
+      if (table.load() != t) {
+        replaced = true;
+        break;
+      }
+      uint32_t mask = match(t, group, tag);
+      const bool hasEmpty = match(t, group, EMPTY) != 0;
+      while (mask) {
+        const int slot = group * GROUP_WIDTH + __builtin_ctz(mask);
+        const InlineKey *k = t->keys[slot].load(std::memory_order_relaxed);
+        if (k->view() == key) {
+          // A group with an empty slot has never been full, so no probe ever
+          // continued past it and the slot can go straight back to EMPTY.
+          setCtrl(t, slot, hasEmpty ? EMPTY : DELETED);
+          if (hasEmpty) {
+            t->growthLeft.fetch_add(1);
+          }
+          t->keys[slot].store(nullptr, std::memory_order_relaxed);
+          --count;
+          // Lock-free searches may still be comparing against k.
+          EpochManager::retire(const_cast<InlineKey *>(k), destroyKey);
+          return true;
+        }
+        mask &= mask - 1;
+      }
+      // Do nothing if the key doesn't exist.
+      if (hasEmpty) {
+        return false;
+      }
+      group = (group + i) & (t->groups - 1);
+    }
+    if (!replaced) {
+      return false;
+    }
+  }
+}
+
+void SwissHashMap::rehash(Table *t) {
+  const auto start = std::chrono::steady_clock::now();
+  for (std::mutex &m : mutexArr) {
+    m.lock();
+  }
+  if (table.load() != t) {
+    for (std::mutex &m : mutexArr) {
+      m.unlock();
+    }
+    return;
+  }
+  // Tombstones are left behind.
+  const bool same = count <= t->slots / 32 * REHASH_LOAD;
+  Table *next = new Table(same ? t->slots : t->slots * 2);
+  for (int s = 0; s < t->slots; ++s) {
+    const InlineKey *k = t->keys[s].load(std::memory_order_relaxed);
+    if (k != nullptr) {
+      place(next, k, hash(k->view()));
+    }
+  }
+  table.store(next);
+  for (std::mutex &m : mutexArr) {
+    m.unlock();
+  }
+  // Searches may still be probing the old groups.
+  EpochManager::retire(t);
+  rehashLog.record(std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count(),
+                   1);
+}
+
+void SwissHashMap::place(Table *t, const InlineKey *key, uint64_t hash) {
+  int group = hash & (t->groups - 1);
+  for (int i = 1;; ++i) {
+    const uint32_t mask = match(t, group, EMPTY);
+    if (mask) {
+      const int slot = group * GROUP_WIDTH + __builtin_ctz(mask);
+      t->keys[slot].store(key, std::memory_order_relaxed);
+      setCtrl(t, slot, hash >> 57);
+      t->growthLeft.fetch_sub(1, std::memory_order_relaxed);
+      return;
+    }
+    group = (group + i) & (t->groups - 1);
+  }
+}
+
+int SwissHashMap::size() const { return count; }
+
+int SwissHashMap::capacity() const { return table.load()->slots; }
+
+MapStats SwissHashMap::stats() const {
+  MapStats s;
+  s.size = size();
+  rehashLog.fill(s);
+  return s;
+}
+
+std::mutex &SwissHashMap::lockOf(int group) {
+  return mutexArr[group & (LOCKS - 1)];
+}
+
+uint32_t SwissHashMap::match(const Table *t, int group, int8_t c) {
+  const uint64_t lo = t->ctrl[group * 2].load(std::memory_order_acquire);
+  const uint64_t hi = t->ctrl[group * 2 + 1].load(std::memory_order_acquire);
+#ifdef __SSE2__
+  const __m128i v = _mm_set_epi64x(hi, lo);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; ++i) {
+    const int8_t b = (i < 8 ? lo : hi) >> (i % 8 * 8);
+    mask |= uint32_t(b == c) << i;
+  }
+  return mask;
+#endif
+}
+
+uint32_t SwissHashMap::matchEmptyOrDeleted(const Table *t, int group) {
+  // EMPTY and DELETED are the only control bytes with the sign bit set.
+  const uint64_t lo = t->ctrl[group * 2].load(std::memory_order_acquire);
+  const uint64_t hi = t->ctrl[group * 2 + 1].load(std::memory_order_acquire);
+#ifdef __SSE2__
+  return _mm_movemask_epi8(_mm_set_epi64x(hi, lo));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; ++i) {
+    const int8_t b = (i < 8 ? lo : hi) >> (i % 8 * 8);
+    mask |= uint32_t(b < 0) << i;
+  }
+  return mask;
+#endif
+}
+
+void SwissHashMap::setCtrl(Table *t, int slot, int8_t c) {
+  std::atomic<uint64_t> &word = t->ctrl[slot / 8];
+  const int shift = slot % 8 * 8;
+  // Only the holder of the group's lock writes its words.
+  const uint64_t w = word.load(std::memory_order_relaxed);
+  word.store((w & ~(uint64_t(0xff) << shift)) |
+                 uint64_t(uint8_t(c)) << shift,
+             std::memory_order_release);
+}
+
+uint64_t SwissHashMap::hash(std::string_view s) const { return hasher(s); }
+
+SwissHashMap::~SwissHashMap() {
+  Table *t = table.load();
+  for (int s = 0; s < t->slots; ++s) {
+    const InlineKey *k = t->keys[s].load();
+    if (k != nullptr) {
+      InlineKey::destroy(k);
+    }
+  }
+  delete t;
+}
@@ -0,0 +1,155 @@
+#ifndef SWISS_HASH_MAP_H
+#define SWISS_HASH_MAP_H
+#include "AbstractHashMap.h"
+#include "Hasher.h"
+#include "MapStats.h"
+#include "SlabAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A thread safe open addressing hashmap implementation (Swiss table style).
+ *
+ * Slots are organised in groups of GROUP_WIDTH. Every slot has a one byte
+ * control entry which is either EMPTY, DELETED or the top 7 bits of the key's
+ * hash. A probe loads the 16 control bytes of a group and compares them all
+ * against the hash tag at once (one SSE2 compare, or a scalar loop where SSE2
+ * is not available), so full string compares only happen on tag matches.
+ *
+ * Writers lock the group they modify; searches take no locks. The control
+ * bytes are read as two atomic words per group, and slots hold immutable
+ * InlineKeys which are only freed through the EpochManager, so a search may
+ * race with a writer reusing the slot it is comparing.
+ *
+ * A removed key leaves a tombstone unless its group still has an EMPTY
+ * slot, and tombstones end no probe, so MAX_LOAD bounds the slots in use
+ * and the tombstones together rather than the keys alone. Once an insertion would go past it, the table is rebuilt with
+ * every lock held and the tombstones dropped: at the same size if the keys
+ * take at most REHASH_LOAD of it, else doubled.
+ */
+class SwissHashMap : public AbstractHashMap {
+
+public:
+  // Initial number of slots unless given to the constructor.
+  // For 1e6 elements, the load would be about 0.5.
+  static const int DEFAULT_SLOTS = 2 * 1024 * 1024;
+
+  // Constructor. Slots are rounded up to a power of two, at least one group.
+  SwissHashMap(Hasher = wyHash, int slots = DEFAULT_SLOTS);
+
+  // Insertion.
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
+
+  // Search.
+  bool search(std::string_view) const;
+
+  // Deletion.
+  bool remove(std::string_view);
+
+  // Batched search, see AbstractHashMap. Batched writers use the default
+  // loop as a probe may lock several groups.
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
+
+  // Size.
+  int size() const;
+
+  // Number of slots.
+  int capacity() const;
+
+  // Size and rebuilds, see AbstractHashMap.
+  MapStats stats() const;
+
+  // Destructor.
+  ~SwissHashMap();
+
+  SwissHashMap(const SwissHashMap &) = delete;
+  SwissHashMap &operator=(const SwissHashMap &) = delete;
+
+private:
+  // Number of slots probed together.
+  static const int GROUP_WIDTH = 16;
+
+  // Largest share of the slots in use or tombstones, in eighths, before the
+  // table is rebuilt.
+  static const int MAX_LOAD = 7;
+
+  // Largest share of the slots in use, in 32nds, for which a rebuild keeps
+  // the size of the table rather than doubling it.
+  static const int REHASH_LOAD = 25;
+
+  // Number of group locks, group g is guarded by lock g % LOCKS.
+  static const int LOCKS = 4096;
+
+  // Control byte for a slot which has never been used.
+  static const int8_t EMPTY = -128;
+
+  // Control byte for a slot whose key was removed (tombstone).
+  static const int8_t DELETED = -2;
+
+  // One generation of the hash map. Keys are freed by the map, not here,
+  // as a doubled table takes them over.
+  struct Table {
+    explicit Table(int slots);
+
+    // Total number of slots, a power of two.
+    const int slots;
+
+    // Total number of groups, slots / GROUP_WIDTH.
+    const int groups;
+
+    // One control byte per slot, 8 per word, two words per group.
+    std::unique_ptr<std::atomic<uint64_t>[]> ctrl;
+
+    // The keys behind the scenes, nullptr unless the control byte is a tag.
+    std::unique_ptr<std::atomic<const InlineKey *>[]> keys;
+
+    // EMPTY slots which insertions may still take before the table is
+    // rebuilt, MAX_LOAD of the slots at first. Taking a tombstone instead
+    // leaves it as it is.
+    std::atomic<int> growthLeft;
+  };
+
+  // The hash function. The top 7 bits of a hash are its tag, the low bits
+  // pick the first group to probe.
+  Hasher hasher;
+
+  // The current table.
+  std::atomic<Table *> table;
+
+  // Locks to protect access to each of the groups.
+  std::vector<std::mutex> mutexArr;
+
+  // Number and durations of the rebuilds.
+  RehashLog rehashLog;
+
+  // A utility method to compute the hash of a given string.
+  uint64_t hash(std::string_view) const;
+
+  // Lock-free search of a key with the given hash. Caller holds an
+  // EpochManager::Guard.
+  bool find(std::string_view, uint64_t hash) const;
+
+  // Lock of a group.
+  std::mutex &lockOf(int group);
+
+  // Bitmask of the slots in a group whose control byte equals the given one.
+  static uint32_t match(const Table *, int group, int8_t);
+
+  // Bitmask of the slots in a group which are EMPTY or DELETED.
+  static uint32_t matchEmptyOrDeleted(const Table *, int group);
+
+  // Set the control byte of a slot, its group's lock being held.
+  static void setCtrl(Table *, int slot, int8_t);
+
+  // Rebuild t without its tombstones with every lock held, doubled unless
+  // its keys take at most REHASH_LOAD of it, unless it was replaced already.
+  void rehash(Table *t);
+
+  // Place a key in t without locking, for a table nobody else sees yet.
+  static void place(Table *t, const InlineKey *key, uint64_t hash);
+};
+#endif // SWISS_HASH_MAP_H
@@ -1,64 +1,271 @@
 #include "ThreadSafeChainHashMap.h"
+#include "BulkLoad.h"
+#include "EpochManager.h"
+#include "NumaTopology.h"
+#include "Snapshot.h"
 #include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <numeric>
 
-ThreadSafeChainHashMap::ThreadSafeChainHashMap() : AbstractHashMap() {
-  hashMap = std::vector<std::list<std::string>>(BUCKETS);
-  mutexArr = std::vector<std::mutex>(BUCKETS);
+ThreadSafeChainHashMap::Shard::Shard(int buckets, LockStripes::Kind lockKind,
+                                     int stripes)
+    : hashMap(buckets), locks(lockKind, std::min(stripes, buckets)) {}
+
+ThreadSafeChainHashMap::ThreadSafeChainHashMap(Hasher hasher,
+                                               LockStripes::Kind lockKind,
+                                               int stripes, int shards)
+    : AbstractHashMap() {
+  if (shards == NUMA_NODES) {
+    shards = NumaTopology::nodes();
+  }
+  if (shards < 1 || shards > BUCKETS || stripes < 1) {
+    std::__throw_out_of_range("shards or stripes value is out of range.");
+  }
+  this->hasher = hasher;
+  shardBuckets = BUCKETS;
+  while (shardBuckets > 1 && shardBuckets / 2 >= BUCKETS / shards) {
+    shardBuckets /= 2;
+  }
+  const int shardStripes = std::max(1, stripes / shards);
+  this->shards.resize(shards);
+  for (int i = 0; i < shards; ++i) {
+    auto build = [&]() {
+      this->shards[i].reset(new Shard(shardBuckets, lockKind, shardStripes));
+    };
+    // Construct the buckets on the shard's node so their pages land there.
+    if (NumaTopology::nodes() > 1) {
+      NumaTopology::runOn(nodeOfShard(i), build);
+    } else {
+      build();
+    }
+  }
 }
 
-bool ThreadSafeChainHashMap::insert(std::string key) {
-  const int index = getIndex(hash(key));
-  std::lock_guard<std::mutex> lk(mutexArr[index]);
-  hashMap[index].push_back(key);
+bool ThreadSafeChainHashMap::insert(std::string &&key) {
+  const uint64_t h = hash(key);
+  Shard &shard = *shards[getShard(h)];
+  const int index = getIndex(h);
+  LockStripes::Guard lk(shard.locks, shard.locks.stripeOf(index));
+  shard.hashMap[index].push(std::move(key), h);
   ++count;
   return true;
 }
 
-bool ThreadSafeChainHashMap::search(std::string key) const {
-  const int index = getIndex(hash(key));
-  return std::find(hashMap[index].begin(), hashMap[index].end(), key) !=
-         hashMap[index].end();
+bool ThreadSafeChainHashMap::search(std::string_view key) const {
+  EpochManager::Guard guard;
+  const uint64_t h = hash(key);
+  return shards[getShard(h)]->hashMap[getIndex(h)].contains(key, h);
 }
 
-bool ThreadSafeChainHashMap::remove(std::string key) {
-  const int index = getIndex(hash(key));
-  std::list<std::string>::iterator it =
-      std::find(hashMap[index].begin(), hashMap[index].end(), key);
+bool ThreadSafeChainHashMap::remove(std::string_view key) {
+  const uint64_t h = hash(key);
+  Shard &shard = *shards[getShard(h)];
+  const int index = getIndex(h);
+  LockStripes::Guard lk(shard.locks, shard.locks.stripeOf(index));
   // Do nothing if the key doesn't exist.
-  if (it == hashMap[index].end()) {
+  if (!shard.hashMap[index].erase(key, h)) {
     return false;
   }
-  // Else lock the bucket and erase the element at it.
-  std::lock_guard<std::mutex> lk(mutexArr[index]);
-  hashMap[index].erase(it);
   --count;
   return true;
 }
 
+void ThreadSafeChainHashMap::insertBatch(std::string *keys, int n,
+                                         bool *results) {
+  std::vector<uint64_t> h(n);
+  for (int i = 0; i < n; ++i) {
+    h[i] = hash(keys[i]);
+    __builtin_prefetch(&shards[getShard(h[i])]->hashMap[getIndex(h[i])]);
+  }
+  for (int i = 0; i < n; ++i) {
+    shards[getShard(h[i])]->hashMap[getIndex(h[i])].prefetch();
+  }
+  const std::vector<int> order = orderByLock(h);
+  for (int j = 0; j < n;) {
+    const int lock = getLock(h[order[j]]);
+    Shard &shard = *shards[getShard(h[order[j]])];
+    LockStripes::Guard lk(shard.locks,
+                          shard.locks.stripeOf(getIndex(h[order[j]])));
+    for (; j < n && getLock(h[order[j]]) == lock; ++j) {
+      const int i = order[j];
+      shard.hashMap[getIndex(h[i])].push(std::move(keys[i]), h[i]);
+      results[i] = true;
+    }
+  }
+  count += n;
+}
+
+void ThreadSafeChainHashMap::searchBatch(const std::string_view *keys, int n,
+                                         bool *results) const {
+  EpochManager::Guard guard;
+  uint64_t h[BATCH_CHUNK];
+  for (int base = 0; base < n; base += BATCH_CHUNK) {
+    const int m = std::min(BATCH_CHUNK, n - base);
+    // Overlap the misses on the buckets, then on their entry arrays.
+    for (int i = 0; i < m; ++i) {
+      h[i] = hash(keys[base + i]);
+      __builtin_prefetch(&shards[getShard(h[i])]->hashMap[getIndex(h[i])]);
+    }
+    for (int i = 0; i < m; ++i) {
+      shards[getShard(h[i])]->hashMap[getIndex(h[i])].prefetch(h[i]);
+    }
+    for (int i = 0; i < m; ++i) {
+      results[base + i] = shards[getShard(h[i])]->hashMap[getIndex(h[i])]
+                              .contains(keys[base + i], h[i]);
+    }
+  }
+}
+
+void ThreadSafeChainHashMap::removeBatch(const std::string_view *keys, int n,
+                                         bool *results) {
+  std::vector<uint64_t> h(n);
+  for (int i = 0; i < n; ++i) {
+    h[i] = hash(keys[i]);
+    __builtin_prefetch(&shards[getShard(h[i])]->hashMap[getIndex(h[i])]);
+  }
+  for (int i = 0; i < n; ++i) {
+    shards[getShard(h[i])]->hashMap[getIndex(h[i])].prefetch();
+  }
+  const std::vector<int> order = orderByLock(h);
+  int removed = 0;
+  for (int j = 0; j < n;) {
+    const int lock = getLock(h[order[j]]);
+    Shard &shard = *shards[getShard(h[order[j]])];
+    LockStripes::Guard lk(shard.locks,
+                          shard.locks.stripeOf(getIndex(h[order[j]])));
+    for (; j < n && getLock(h[order[j]]) == lock; ++j) {
+      const int i = order[j];
+      results[i] = shard.hashMap[getIndex(h[i])].erase(keys[i], h[i]);
+      removed += results[i];
+    }
+  }
+  count -= removed;
+}
+
 int ThreadSafeChainHashMap::size() const { return count; }
 
-int ThreadSafeChainHashMap::getIndex(const int hash) const {
-  return hash % BUCKETS;
-}
-
-int ThreadSafeChainHashMap::hash(const std::string &s) const {
-  /**
-   * Polynomial hashing.
-   * h = ( s[0] + s[1] * p + s[2] * p^2 + s[3] * p^3 + ... ) % mod.
-   */
-  const int p = 97;
-  const long long int mod = 1e9 + 7;
-  long long h = 0;
-  long long pow = 1;
-  for (char c : s) {
-    h += ((c - '!' + 1) * pow) % mod;
-    h %= mod;
-    pow *= p;
-    pow %= mod;
+MapStats ThreadSafeChainHashMap::stats() const {
+  MapStats s;
+  s.size = size();
+  for (const auto &shard : shards) {
+    for (const VersionedBucket &bucket : shard->hashMap) {
+      s.addBucket(bucket.size());
+    }
+    const std::vector<uint64_t> contended = shard->locks.contended();
+    s.contention.insert(s.contention.end(), contended.begin(), contended.end());
+  }
+  return s;
+}
+
+void ThreadSafeChainHashMap::collectStats(bool enabled) {
+  for (auto &shard : shards) {
+    shard->locks.countContention(enabled);
   }
-  return h;
 }
 
+void ThreadSafeChainHashMap::saveSnapshot(const std::string &path,
+                                          int threads) const {
+  WorkerPool pool(threads);
+  // Bucket b is bucket b % shardBuckets of shard b / shardBuckets.
+  writeSnapshot(
+      path, uint64_t(shards.size()) * shardBuckets,
+      [this](uint64_t b) -> const VersionedBucket & {
+        return shards[b / shardBuckets]->hashMap[b % shardBuckets];
+      },
+      hasher, pool);
+}
+
+void ThreadSafeChainHashMap::loadSnapshot(const std::string &path,
+                                          int threads) {
+  SnapshotFile file(path, hasher);
+  WorkerPool pool(threads);
+  pool.parallelFor(file.chunks(), [&](int c) {
+    const uint64_t chunkEnd =
+        std::min(file.buckets(), uint64_t(c + 1) * SnapshotFile::CHUNK);
+    for (uint64_t b = uint64_t(c) * SnapshotFile::CHUNK; b < chunkEnd; ++b) {
+      const uint64_t last = file.first(b + 1);
+      for (uint64_t i = file.first(b); i < last;) {
+        // The keys of a snapshot bucket share one of our buckets, unless the
+        // map it was taken of had another layout.
+        const uint64_t h = file.hash(i);
+        const int shard = getShard(h);
+        const int index = getIndex(h);
+        uint64_t end = i + 1;
+        while (end < last && getShard(file.hash(end)) == shard &&
+               getIndex(file.hash(end)) == index) {
+          ++end;
+        }
+        Shard &s = *shards[shard];
+        LockStripes::Guard lk(s.locks, s.locks.stripeOf(index));
+        VersionedBucket &bucket = s.hashMap[index];
+        bucket.reserve(bucket.size() + (end - i));
+        for (; i < end; ++i) {
+          bucket.push(file.key(i), file.hash(i));
+        }
+      }
+    }
+  });
+  count += file.size();
+}
+
+void ThreadSafeChainHashMap::bulkLoad(const std::string_view *keys, size_t n,
+                                      int threads) {
+  WorkerPool pool(threads);
+  // Buckets are numbered shard by shard.
+  BulkLoad::load(
+      keys, n, hasher, uint64_t(shards.size()) * shardBuckets,
+      [this](uint64_t h) {
+        return uint64_t(getShard(h)) * shardBuckets + getIndex(h);
+      },
+      [this](uint64_t b) -> VersionedBucket & {
+        return shards[b / shardBuckets]->hashMap[b % shardBuckets];
+      },
+      pool.size(),
+      [&pool](int tasks, const std::function<void(int)> &fn) {
+        pool.parallelFor(tasks, fn);
+      });
+  count += n;
+}
+
+int ThreadSafeChainHashMap::shardCount() const { return shards.size(); }
+
+int ThreadSafeChainHashMap::shardOf(std::string_view key) const {
+  return getShard(hash(key));
+}
+
+int ThreadSafeChainHashMap::nodeOfShard(int shard) const {
+  return shard % NumaTopology::nodes();
+}
+
+int ThreadSafeChainHashMap::getShard(const uint64_t hash) const {
+  // Scale the high 32 bits, the low bits pick the bucket.
+  return ((hash >> 32) * shards.size()) >> 32;
+}
+
+int ThreadSafeChainHashMap::getIndex(const uint64_t hash) const {
+  return hash & (shardBuckets - 1);
+}
+
+int ThreadSafeChainHashMap::getLock(const uint64_t hash) const {
+  const LockStripes &locks = shards[getShard(hash)]->locks;
+  return getShard(hash) * locks.size() + locks.stripeOf(getIndex(hash));
+}
+
+std::vector<int>
+ThreadSafeChainHashMap::orderByLock(const std::vector<uint64_t> &hashes) const {
+  const int n = hashes.size();
+  std::vector<int> locks(n);
+  for (int i = 0; i < n; ++i) {
+    locks[i] = getLock(hashes[i]);
+  }
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return locks[a] < locks[b]; });
+  return order;
+}
+
+uint64_t ThreadSafeChainHashMap::hash(std::string_view s) const { return hasher(s); }
+
 ThreadSafeChainHashMap::~ThreadSafeChainHashMap() {}
\ No newline at end of file
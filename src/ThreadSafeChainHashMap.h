@@ -1,49 +1,124 @@
 #ifndef THREAD_SAFE_CHAIN_HASH_MAP_H
 #define THREAD_SAFE_CHAIN_HASH_MAP_H
 #include "AbstractHashMap.h"
-#include <list>
-#include <mutex>
+#include "BucketLocks.h"
+#include "Hasher.h"
+#include "VersionedBucket.h"
+#include <memory>
 #include <vector>
 
 /**
- * A thread safe chain hashmap implementation.
+ * A thread safe chain hashmap implementation. Writers lock the bucket's
+ * stripe, searches are lock-free and validated with the bucket's version.
+ *
+ * The hash space can be split into shards, each with its own buckets and
+ * locks. With one shard per NUMA node, every shard is allocated and first
+ * touched by a thread pinned to its node; threads pinned to the node of
+ * shardOf(key) then only touch local memory for that key.
  */
 class ThreadSafeChainHashMap : public AbstractHashMap {
 
 public:
-  // Constructor.
-  ThreadSafeChainHashMap();
+  // Number of lock stripes unless given to the constructor.
+  static const int DEFAULT_STRIPES = 64 * 1024;
+
+  // Number of shards for one shard per NUMA node.
+  static const int NUMA_NODES = 0;
+
+  // Constructor. Buckets and stripes are split evenly over the shards.
+  ThreadSafeChainHashMap(Hasher = wyHash,
+                         LockStripes::Kind = LockStripes::MUTEX,
+                         int stripes = DEFAULT_STRIPES, int shards = 1);
 
   // Insertion.
-  bool insert(std::string);
+  bool insert(std::string &&);
+  using AbstractHashMap::insert;
 
   // Search.
-  bool search(std::string) const;
+  bool search(std::string_view) const;
 
   // Deletion.
-  bool remove(std::string);
+  bool remove(std::string_view);
+
+  // Batched operations, see AbstractHashMap.
+  void insertBatch(std::string *keys, int n, bool *results);
+  void searchBatch(const std::string_view *keys, int n, bool *results) const;
+  void removeBatch(const std::string_view *keys, int n, bool *results);
 
   // Size.
   int size() const;
 
+  // Chain lengths, hash quality and lock contention, see AbstractHashMap.
+  // Stripes are numbered shard by shard.
+  MapStats stats() const;
+  void collectStats(bool);
+
+  // Write every key with its hash to a snapshot file, bucket by bucket, on
+  // threads threads (0: one per hardware thread). Writers may run
+  // meanwhile, each bucket is saved as it was at one moment of the save.
+  void saveSnapshot(const std::string &path, int threads = 0) const;
+
+  // Add the keys of a snapshot file, rebuilding the buckets in parallel from
+  // the stored hashes without hashing a key. Throws if the snapshot was
+  // taken with another hash function.
+  void loadSnapshot(const std::string &path, int threads = 0);
+
+  // Insert n keys on threads threads (0: one per hardware thread) without
+  // locking: the keys are partitioned by bucket and every bucket is filled
+  // by one thread, see BulkLoad.h. No writer may run meanwhile, searches
+  // may. Like insert(), does not check for keys already in the map.
+  void bulkLoad(const std::string_view *keys, size_t n, int threads = 0);
+
+  // Number of shards.
+  int shardCount() const;
+
+  // Shard holding a key.
+  int shardOf(std::string_view) const;
+
+  // NUMA node a shard was placed on.
+  int nodeOfShard(int shard) const;
+
   // Destructor.
   ~ThreadSafeChainHashMap();
 
 private:
-  // Totat number of initial buckets for hash map.
+  // Totat number of initial buckets for hash map, a power of two.
   // For 1e7 elements, avg bucket size would be 10.
   const int BUCKETS = 1024 * 1024;
 
-  // The hash map data structure behind the scenes.
-  std::vector<std::list<std::string>> hashMap;
+  // The hash function.
+  Hasher hasher;
+
+  // A slice of the hash space.
+  struct Shard {
+    Shard(int buckets, LockStripes::Kind, int stripes);
+
+    // The hash map data structure behind the scenes.
+    std::vector<VersionedBucket> hashMap;
+
+    // Locks to protect access to the buckets, shared by stripes of buckets.
+    LockStripes locks;
+  };
 
-  // Locks to protect access to each of the buckets.
-  std::vector<std::mutex> mutexArr;
+  std::vector<std::unique_ptr<Shard>> shards;
+
+  // Number of buckets of each shard, a power of two.
+  int shardBuckets;
 
   // A utility method to compute the hash of a given string.
-  int hash(const std::string &) const;
+  uint64_t hash(std::string_view) const;
+
+  // Shard of a hash, from its high bits.
+  int getShard(const uint64_t hash) const;
+
+  // A utility method to compute the index of a hash in its shard.
+  int getIndex(const uint64_t hash) const;
+
+  // Lock stripe of a hash across all shards, for grouping batches.
+  int getLock(const uint64_t hash) const;
 
-  // A utility method to compute the index of a hash in the hash map.
-  int getIndex(const int hash) const;
+  // Positions 0..n-1 of a batch ordered by getLock(), shard included, so
+  // that a writer takes each stripe once.
+  std::vector<int> orderByLock(const std::vector<uint64_t> &hashes) const;
 };
 #endif // THREAD_SAFE_CHAIN_HASH_MAP_H
\ No newline at end of file
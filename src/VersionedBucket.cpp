@@ -0,0 +1,178 @@
+#include "VersionedBucket.h"
+#include "EpochManager.h"
+#include <thread>
+
+namespace {
+
+template <typename T> void deleteArray(void *p) { delete[] static_cast<T *>(p); }
+
+void destroyKey(void *p) { InlineKey::destroy(static_cast<InlineKey *>(p)); }
+
+} // namespace
+
+VersionedBucket::VersionedBucket()
+    : version(0), length(0), capacity(0), ownsKeys(true), filter(0),
+      entries(nullptr) {}
+
+bool VersionedBucket::contains(std::string_view key, uint64_t hash) const {
+  while (true) {
+    const unsigned before = version.load(std::memory_order_acquire);
+    // A writer is in the middle of a change.
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    // length is read before entries: an array is always published before
+    // length grows past the previous array's capacity. A hash missing from
+    // the filter is decided without touching the array at all.
+    const bool mayContain =
+        filter.load(std::memory_order_relaxed) & filterBit(hash);
+    const unsigned n = mayContain ? length.load(std::memory_order_acquire) : 0;
+    const Entry *e = mayContain ? entries.load(std::memory_order_acquire)
+                                : nullptr;
+    bool found = false;
+    for (unsigned i = 0; i < n; ++i) {
+      if (e[i].hash.load(std::memory_order_relaxed) == hash &&
+          e[i].key.load(std::memory_order_relaxed)->view() == key) {
+        found = true;
+        break;
+      }
+    }
+    // Validate that no writer ran during the scan.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version.load(std::memory_order_relaxed) == before) {
+      return found;
+    }
+  }
+}
+
+void VersionedBucket::snapshot(std::vector<KeyView> &out) const {
+  const size_t start = out.size();
+  while (true) {
+    const unsigned before = version.load(std::memory_order_acquire);
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    const unsigned n = length.load(std::memory_order_acquire);
+    const Entry *e = entries.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; ++i) {
+      out.push_back({e[i].key.load(std::memory_order_relaxed)->view(),
+                     e[i].hash.load(std::memory_order_relaxed)});
+    }
+    // Validate that no writer ran during the copy.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version.load(std::memory_order_relaxed) == before) {
+      return;
+    }
+    out.resize(start);
+  }
+}
+
+void VersionedBucket::push(std::string_view key, uint64_t hash) {
+  // Allocate before the write section, readers retry while it is open.
+  append(InlineKey::create(key), hash);
+}
+
+void VersionedBucket::append(const InlineKey *k, uint64_t hash) {
+  const unsigned n = length.load(std::memory_order_relaxed);
+  Entry *e = entries.load(std::memory_order_relaxed);
+  if (n == capacity) {
+    e = grow(capacity == 0 ? 2 : capacity * 2);
+  }
+  beginWrite();
+  e[n].hash.store(hash, std::memory_order_relaxed);
+  e[n].key.store(k, std::memory_order_relaxed);
+  length.store(n + 1, std::memory_order_release);
+  filter.store(filter.load(std::memory_order_relaxed) | filterBit(hash),
+               std::memory_order_relaxed);
+  endWrite();
+}
+
+void VersionedBucket::reserve(unsigned n) {
+  if (n > capacity) {
+    grow(n);
+  }
+}
+
+VersionedBucket::Entry *VersionedBucket::grow(unsigned capacity) {
+  // Grow into a new array; readers may still be scanning the old one.
+  const unsigned n = length.load(std::memory_order_relaxed);
+  Entry *e = entries.load(std::memory_order_relaxed);
+  this->capacity = capacity;
+  Entry *grown = new Entry[capacity];
+  for (unsigned i = 0; i < n; ++i) {
+    grown[i].hash.store(e[i].hash.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    grown[i].key.store(e[i].key.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+  }
+  entries.store(grown, std::memory_order_release);
+  if (e != nullptr) {
+    EpochManager::retire(e, deleteArray<Entry>);
+  }
+  return grown;
+}
+
+bool VersionedBucket::erase(std::string_view key, uint64_t hash) {
+  const unsigned n = length.load(std::memory_order_relaxed);
+  Entry *e = entries.load(std::memory_order_relaxed);
+  for (unsigned i = 0; i < n; ++i) {
+    const InlineKey *k = e[i].key.load(std::memory_order_relaxed);
+    if (e[i].hash.load(std::memory_order_relaxed) == hash && k->view() == key) {
+      // Move the last entry into the hole.
+      beginWrite();
+      e[i].hash.store(e[n - 1].hash.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+      e[i].key.store(e[n - 1].key.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+      length.store(n - 1, std::memory_order_relaxed);
+      // Rebuild the filter, other hashes may share the erased key's bit.
+      uint64_t bits = 0;
+      for (unsigned j = 0; j + 1 < n; ++j) {
+        bits |= filterBit(e[j].hash.load(std::memory_order_relaxed));
+      }
+      filter.store(bits, std::memory_order_relaxed);
+      endWrite();
+      // Optimistic readers may still be comparing against k.
+      EpochManager::retire(const_cast<InlineKey *>(k), destroyKey);
+      return true;
+    }
+  }
+  return false;
+}
+
+void VersionedBucket::prefetch() const {
+  // A prefetch never faults, so a stale pointer is harmless.
+  __builtin_prefetch(entries.load(std::memory_order_relaxed));
+}
+
+void VersionedBucket::prefetch(uint64_t hash) const {
+  if (filter.load(std::memory_order_relaxed) & filterBit(hash)) {
+    prefetch();
+  }
+}
+
+unsigned VersionedBucket::size() const {
+  return length.load(std::memory_order_relaxed);
+}
+
+void VersionedBucket::beginWrite() {
+  version.store(version.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void VersionedBucket::endWrite() {
+  version.store(version.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+}
+
+VersionedBucket::~VersionedBucket() {
+  const unsigned n = length.load();
+  Entry *e = entries.load();
+  for (unsigned i = 0; ownsKeys && i < n; ++i) {
+    InlineKey::destroy(e[i].key.load());
+  }
+  delete[] e;
+}
@@ -0,0 +1,139 @@
+#ifndef VERSIONED_BUCKET_H
+#define VERSIONED_BUCKET_H
+#include "SlabAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * A hash map bucket guarded by a version counter (seqlock).
+ *
+ * The bucket is a contiguous array of (hash, key) entries, each key being a
+ * single InlineKey block from the SlabAllocator. Writers must hold
+ * the bucket's lock; they make the version odd while they change the array
+ * and even again afterwards. Readers take no lock and write no shared
+ * memory: they scan optimistically and retry if the version was odd or
+ * changed under them. Keys are only compared when the stored hash matches.
+ *
+ * The bucket also keeps a 64-bit filter next to its version, one bit set
+ * per hash held (bits 40 to 45 of the hash pick it), so most searches for
+ * a missing key end on the bucket's own cache line without loading the
+ * entry array.
+ *
+ * Removed keys and outgrown arrays are handed to the EpochManager, so
+ * readers must hold an EpochManager::Guard while they scan.
+ */
+class VersionedBucket {
+
+public:
+  // Constructor.
+  VersionedBucket();
+
+  // Lock-free search.
+  bool contains(std::string_view, uint64_t hash) const;
+
+  // Insertion, caller holds the bucket lock. The key is copied into one
+  // slab block.
+  void push(std::string_view, uint64_t hash);
+
+  // Deletion, caller holds the bucket lock. Returns false if the key
+  // doesn't exist.
+  bool erase(std::string_view, uint64_t hash);
+
+  // Make room for n keys in all, caller holds the bucket lock. Bulk loads
+  // size the entry array once instead of doubling it.
+  void reserve(unsigned n);
+
+  // A key and its hash, copied out of the bucket.
+  struct KeyView {
+    std::string_view key;
+    uint64_t hash;
+  };
+
+  // Lock-free copy of one consistent version of the keys, appended to out.
+  // The keys stay valid while the caller holds its EpochManager::Guard.
+  void snapshot(std::vector<KeyView> &out) const;
+
+  // Call f(key, hash) for every key, caller holds the bucket lock.
+  template <typename F> void forEach(F f) const {
+    const unsigned n = length.load(std::memory_order_relaxed);
+    const Entry *e = entries.load(std::memory_order_relaxed);
+    for (unsigned i = 0; i < n; ++i) {
+      f(e[i].key.load(std::memory_order_relaxed)->view(),
+        e[i].hash.load(std::memory_order_relaxed));
+    }
+  }
+
+  // Move every key into the bucket target(hash) of another table, without
+  // copying it. This bucket keeps its entries for readers that are still
+  // scanning it, but no longer frees the keys. The caller holds both
+  // buckets' locks, or otherwise owns them.
+  template <typename F> void moveKeys(F target) {
+    const unsigned n = length.load(std::memory_order_relaxed);
+    const Entry *e = entries.load(std::memory_order_relaxed);
+    for (unsigned i = 0; i < n; ++i) {
+      const uint64_t h = e[i].hash.load(std::memory_order_relaxed);
+      VersionedBucket &to = target(h);
+      to.append(e[i].key.load(std::memory_order_relaxed), h);
+    }
+    ownsKeys = false;
+  }
+
+  // Prefetch the entry array. Call it once the bucket itself is in cache, so
+  // that loading the array pointer doesn't miss.
+  void prefetch() const;
+
+  // Prefetch the entry array for a search of hash, unless the filter rules
+  // the hash out.
+  void prefetch(uint64_t hash) const;
+
+  // Number of keys.
+  unsigned size() const;
+
+  // Destructor, frees the keys directly.
+  ~VersionedBucket();
+
+  VersionedBucket(const VersionedBucket &) = delete;
+  VersionedBucket &operator=(const VersionedBucket &) = delete;
+
+private:
+  struct Entry {
+    std::atomic<uint64_t> hash;
+    std::atomic<const InlineKey *> key;
+  };
+
+  // Odd while a writer is changing the bucket.
+  std::atomic<unsigned> version;
+
+  // Number of entries in use.
+  std::atomic<unsigned> length;
+
+  // Number of entries allocated, only used by writers.
+  unsigned capacity;
+
+  // Whether the destructor frees the keys, false once they were moved out.
+  bool ownsKeys;
+
+  // filterBit() of every hash in the bucket.
+  std::atomic<uint64_t> filter;
+
+  std::atomic<Entry *> entries;
+
+  // Append a key the bucket now owns, caller holds the bucket lock.
+  void append(const InlineKey *, uint64_t hash);
+
+  // Move the entries to a new array of the given capacity, caller holds the
+  // bucket lock. Returns the new array.
+  Entry *grow(unsigned capacity);
+
+  // Bit of a hash in the filter.
+  static uint64_t filterBit(uint64_t hash) {
+    return uint64_t(1) << ((hash >> 40) & 63);
+  }
+
+  // Enter and leave a write section.
+  void beginWrite();
+  void endWrite();
+};
+#endif // VERSIONED_BUCKET_H
@@ -0,0 +1,83 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads)
+    : threads(threads > 0
+                  ? threads
+                  : std::max(1, int(std::thread::hardware_concurrency()))) {}
+
+void WorkerPool::parallelFor(int chunks, const std::function<void(int)> &task) {
+  if (chunks <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> job(jobMtx);
+  if (threads == 1 || chunks == 1) {
+    for (int c = 0; c < chunks; ++c) {
+      task(c);
+    }
+    return;
+  }
+  // Start the workers on first use.
+  if (workers.empty()) {
+    for (int i = 1; i < threads; ++i) {
+      workers.push_back(std::thread(&WorkerPool::loop, this));
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    this->task = &task;
+    this->chunks = chunks;
+    next.store(0, std::memory_order_relaxed);
+    running = workers.size();
+    ++generation;
+  }
+  wake.notify_all();
+  work();
+  // Workers still hold a pointer to task until they report back.
+  std::unique_lock<std::mutex> lk(mtx);
+  finished.wait(lk, [this]() { return running == 0; });
+  this->task = nullptr;
+}
+
+void WorkerPool::work() {
+  for (int c = next.fetch_add(1, std::memory_order_relaxed); c < chunks;
+       c = next.fetch_add(1, std::memory_order_relaxed)) {
+    (*task)(c);
+  }
+}
+
+void WorkerPool::loop() {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(mtx);
+      wake.wait(lk, [&]() { return stop || generation != seen; });
+      if (stop) {
+        return;
+      }
+      seen = generation;
+    }
+    work();
+    bool last;
+    {
+      std::lock_guard<std::mutex> lk(mtx);
+      last = --running == 0;
+    }
+    if (last) {
+      finished.notify_one();
+    }
+  }
+}
+
+int WorkerPool::size() const { return threads; }
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    stop = true;
+  }
+  wake.notify_all();
+  for (std::thread &t : workers) {
+    t.join();
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads for bulk operations such as rehashing.
+ *
+ * The threads are only started by the first parallelFor() and then wait for
+ * work, so a resize costs a wake-up instead of a thread creation. The calling
+ * thread works on the job too, and one job runs at a time.
+ */
+class WorkerPool {
+
+public:
+  // Constructor, 0 threads means one per hardware thread. The calling
+  // thread counts as one of them.
+  explicit WorkerPool(int threads = 0);
+
+  // Call task(chunk) for every chunk in [0, chunks) and return once all have
+  // run. Chunks are handed out one at a time, so uneven chunks balance out.
+  void parallelFor(int chunks, const std::function<void(int)> &task);
+
+  // Number of threads working on a job, the caller included.
+  int size() const;
+
+  // Destructor, stops the workers.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+private:
+  const int threads;
+
+  std::vector<std::thread> workers;
+
+  // Serializes jobs.
+  std::mutex jobMtx;
+
+  // Guards the job description and wakes the workers.
+  std::mutex mtx;
+  std::condition_variable wake;
+  std::condition_variable finished;
+
+  // Incremented for every job, workers wait for it to change.
+  uint64_t generation = 0;
+
+  bool stop = false;
+
+  // The current job.
+  const std::function<void(int)> *task = nullptr;
+  int chunks = 0;
+
+  // Next chunk to hand out.
+  std::atomic<int> next{0};
+
+  // Number of workers still running the current job.
+  int running = 0;
+
+  // Take chunks of the current job until there are none left.
+  void work();
+
+  // Loop of a worker thread.
+  void loop();
+};
+#endif // WORKER_POOL_H
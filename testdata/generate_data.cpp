@@ -1,68 +1,665 @@
+#include "../src/Hasher.h"
+#include "../src/WorkerPool.h"
+#include "../tests/KeyFile.h"
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
-#include <map>
+#include <sstream>
 #include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
-std::string generate_string() {
-  std::string s;
-  // Generate a random length between 1 and 100;
-  int len = rand() % 100 + 1;
-  for (uint16_t i = 1; i <= len; ++i) {
-    // Generate a random character between ascii values of 33 and 122 inclusive.
-    int ascii = rand() % 90 + 33;
-    s += char(ascii);
+/**
+ * Generates the test data: insert.txt, search.txt and delete.txt, one
+ * "key flag" line per key, where flag tells whether the key is inserted.
+ * --format=binary writes insert.bin, search.bin and delete.bin instead (see
+ * tests/KeyFile.h), which the test applications map rather than parse.
+ *
+ * Every random choice comes from a counter based generator seeded with
+ * (--seed, what is drawn, its index), so the output only depends on the
+ * options, not on the number of threads. Key i is made from its own stream;
+ * keys which collide with a key of lower index are drawn again from the next
+ * stream of i until all are unique. The files list the keys in the orders of
+ * seeded Feistel permutations, which take no memory, so nothing is stored
+ * per key but a 64-bit fingerprint and the stream number, about 33 bytes
+ * per key at the peak of the uniqueness check.
+ *
+ * By default search.txt holds every key once, like insert.txt. With --zipf
+ * or --hit-ratio it holds --searches lookups instead: a lookup hits with
+ * probability --hit-ratio and picks its key among the inserted (or the
+ * missing) keys with Zipf skew, so hot keys repeat.
+ *
+ *   generate_data.out --count=100000000 --length=normal:24:8 --alphabet=alnum
+ *                     --prefixes=1000 --zipf=0.99 --hit-ratio=0.9 --seed=7
+ */
+
+struct Options {
+  uint64_t count = 1000000;
+  uint64_t seed = 1;
+  // Key length distribution.
+  enum { UNIFORM, NORMAL, FIXED } length = UNIFORM;
+  double lengthA = 1, lengthB = 100;
+  std::string alphabet;
+  // Number of URL-like shared prefixes, 0 for none.
+  uint64_t prefixes = 0;
+  // Fraction of the keys which are inserted.
+  double inserted = 0.5;
+  // Skewed search file: lookups, hit ratio, Zipf exponent (0 is uniform).
+  bool skewed = false;
+  uint64_t searches = 0;
+  double hitRatio = -1;
+  double zipf = 0;
+  int threads = std::max(1, int(std::thread::hardware_concurrency()));
+  std::string out = ".";
+  enum { TEXT, BINARY, BOTH } format = TEXT;
+};
+
+Options o;
+
+// Streams of the generator, one per kind of draw.
+enum Stream : uint64_t {
+  KEY,
+  PREFIX,
+  INSERT_ORDER,
+  SEARCH_ORDER,
+  DELETE_ORDER,
+  HOT_ORDER,
+  LOOKUP
+};
+
+uint64_t mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/**
+ * splitmix64 starting at a state derived from (seed, stream, index).
+ */
+class Random {
+
+public:
+  Random(Stream stream, uint64_t index)
+      : state(mix64(o.seed ^ mix64(stream * 0x9e3779b97f4a7c15ULL ^
+                                   mix64(index)))) {}
+
+  uint64_t next() {
+    state += 0x9e3779b97f4a7c15ULL;
+    return mix64(state);
+  }
+
+  // Uniform in [0, n).
+  uint64_t below(uint64_t n) {
+    return uint64_t((unsigned __int128)next() * n >> 64);
+  }
+
+  // Uniform in [0, 1).
+  double real() { return (next() >> 11) * 0x1.0p-53; }
+
+  // Standard normal, Box-Muller.
+  double normal() {
+    const double u = 1 - real();
+    return std::sqrt(-2 * std::log(u)) * std::cos(2 * M_PI * real());
+  }
+
+private:
+  uint64_t state;
+};
+
+/**
+ * A seeded permutation of [0, n): a balanced Feistel network over the
+ * smallest even number of bits covering n, walking the cycle until the result
+ * falls below n.
+ */
+class Permutation {
+
+public:
+  Permutation(Stream stream, uint64_t n) : n(n), stream(stream) {
+    int bits = 2;
+    while ((1ULL << bits) < n) {
+      bits += 2;
+    }
+    half = bits / 2;
+    mask = (1ULL << half) - 1;
+  }
+
+  uint64_t operator()(uint64_t i) const {
+    do {
+      i = encrypt(i);
+    } while (i >= n);
+    return i;
+  }
+
+private:
+  static const int ROUNDS = 4;
+  uint64_t n;
+  Stream stream;
+  int half;
+  uint64_t mask;
+
+  uint64_t encrypt(uint64_t x) const {
+    uint64_t left = x >> half, right = x & mask;
+    for (int r = 0; r < ROUNDS; ++r) {
+      const uint64_t f =
+          mix64(right ^ mix64(o.seed + stream * ROUNDS + r)) & mask;
+      const uint64_t t = left ^ f;
+      left = right;
+      right = t;
+    }
+    return left << half | right;
+  }
+};
+
+/**
+ * Zipf distributed ranks in [0, n), rank 0 the most frequent, by rejection
+ * inversion (Hörmann and Derflinger): constant time and memory for any n.
+ */
+class Zipf {
+
+public:
+  Zipf(uint64_t n, double exponent) : n(n), s(exponent) {
+    hX1 = hIntegral(1.5) - 1;
+    hN = hIntegral(n + 0.5);
+    sC = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+  }
+
+  uint64_t operator()(Random &r) const {
+    if (s == 0) {
+      return r.below(n);
+    }
+    while (true) {
+      const double u = hN + r.real() * (hX1 - hN);
+      const double x = hIntegralInverse(u);
+      double k = std::floor(x + 0.5);
+      k = std::min(std::max(k, 1.0), double(n));
+      if (k - x <= sC || u >= hIntegral(k + 0.5) - h(k)) {
+        return uint64_t(k) - 1;
+      }
+    }
+  }
+
+private:
+  uint64_t n;
+  double s, hX1, hN, sC;
+
+  // log1p(x) / x and expm1(x) / x, accurate near 0.
+  static double helper1(double x) {
+    return std::abs(x) > 1e-8 ? std::log1p(x) / x
+                              : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+  }
+  static double helper2(double x) {
+    return std::abs(x) > 1e-8 ? std::expm1(x) / x
+                              : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+  }
+  double h(double x) const { return std::exp(-s * std::log(x)); }
+  double hIntegral(double x) const {
+    const double l = std::log(x);
+    return helper2((1 - s) * l) * l;
+  }
+  double hIntegralInverse(double x) const {
+    const double t = std::max(-1.0, x * (1 - s));
+    return std::exp(helper1(t) * x);
+  }
+};
+
+std::vector<std::string> prefixes;
+
+// Prefixes like "https://www.abcd.com/efgh/ijk/".
+void makePrefixes() {
+  static const char LOWER[] = "abcdefghijklmnopqrstuvwxyz";
+  static const char *const TLDS[] = {".com/", ".org/", ".net/", ".io/"};
+  prefixes.resize(o.prefixes);
+  for (uint64_t p = 0; p < o.prefixes; ++p) {
+    Random r(PREFIX, p);
+    std::string &s = prefixes[p];
+    s = "https://www.";
+    const int segments = 1 + r.below(3);
+    for (int seg = 0; seg <= segments; ++seg) {
+      const int len = 3 + r.below(8);
+      for (int c = 0; c < len; ++c) {
+        s += LOWER[r.below(26)];
+      }
+      s += seg == 0 ? TLDS[r.below(4)] : "/";
+    }
+  }
+}
+
+// Key i drawn from stream attempt.
+void makeKey(uint64_t i, uint8_t attempt, std::string &key) {
+  static const Zipf prefixChoice(std::max<uint64_t>(o.prefixes, 1), 1);
+  Random r(KEY, i | uint64_t(attempt) << 40);
+  key.clear();
+  if (o.prefixes > 0) {
+    key = prefixes[prefixChoice(r)];
+  }
+  double len;
+  switch (o.length) {
+  case Options::UNIFORM:
+    len = o.lengthA + r.below(uint64_t(o.lengthB - o.lengthA) + 1);
+    break;
+  case Options::NORMAL:
+    len = std::round(o.lengthA + o.lengthB * r.normal());
+    break;
+  default:
+    len = o.lengthA;
+  }
+  const int n = std::max(1.0, len);
+  for (int c = 0; c < n; ++c) {
+    key += o.alphabet[r.below(o.alphabet.size())];
   }
-  return s;
 }
 
-const int N = 1e6;
+// Stream each key is drawn from.
+std::vector<uint8_t> attempts;
 
-int main(void) {
-  srand(time(nullptr));
+struct Entry {
+  uint64_t fingerprint;
+  uint64_t index;
+  bool operator<(const Entry &e) const {
+    return fingerprint != e.fingerprint ? fingerprint < e.fingerprint
+                                        : index < e.index;
+  }
+};
 
-  std::vector<std::pair<std::string, bool>> tests(N);
-  std::string s;
-  std::map<std::string, bool> exists;
-  // Generate unique strings.
-  for (uint32_t i = 0; i <= N - 1; ++i) {
-    s = generate_string();
-    if (!exists[s]) {
-      tests[i].first = s;
-      exists[s] = true;
-    } else {
-      --i;
+// Sort entries in parallel: partition by the top bits of the fingerprint,
+// then sort the partitions.
+void parallelSort(std::vector<Entry> &entries, WorkerPool &pool) {
+  const int BITS = 10, PARTS = 1 << BITS;
+  const int chunks = pool.size() * 4;
+  const uint64_t n = entries.size();
+  std::vector<std::vector<uint64_t>> counts(chunks,
+                                            std::vector<uint64_t>(PARTS));
+  pool.parallelFor(chunks, [&](int c) {
+    for (uint64_t i = n * c / chunks; i < n * (c + 1) / chunks; ++i) {
+      ++counts[c][entries[i].fingerprint >> (64 - BITS)];
     }
+  });
+  std::vector<uint64_t> starts(PARTS + 1);
+  uint64_t total = 0;
+  for (int p = 0; p < PARTS; ++p) {
+    starts[p] = total;
+    for (int c = 0; c < chunks; ++c) {
+      const uint64_t k = counts[c][p];
+      counts[c][p] = total;
+      total += k;
+    }
+  }
+  starts[PARTS] = total;
+  std::vector<Entry> sorted(n);
+  pool.parallelFor(chunks, [&](int c) {
+    for (uint64_t i = n * c / chunks; i < n * (c + 1) / chunks; ++i) {
+      sorted[counts[c][entries[i].fingerprint >> (64 - BITS)]++] = entries[i];
+    }
+  });
+  pool.parallelFor(PARTS, [&](int p) {
+    std::sort(sorted.begin() + starts[p], sorted.begin() + starts[p + 1]);
+  });
+  entries.swap(sorted);
+}
+
+// Draw the keys again until no two share a fingerprint; the key of lower
+// index keeps its draw. Fingerprints only collide for equal keys, or with
+// probability n^2 / 2^65, in which case a unique key is drawn again for
+// nothing.
+void makeUnique(WorkerPool &pool) {
+  attempts.assign(o.count, 0);
+  std::vector<Entry> keep(o.count);
+  pool.parallelFor(pool.size() * 4, [&](int c) {
+    std::string key;
+    const int chunks = pool.size() * 4;
+    for (uint64_t i = o.count * c / chunks; i < o.count * (c + 1) / chunks;
+         ++i) {
+      makeKey(i, 0, key);
+      keep[i] = {wyHash(key), i};
+    }
+  });
+  parallelSort(keep, pool);
+  std::vector<Entry> retry;
+  // Split the sorted entries into the first of every fingerprint and the
+  // rest.
+  auto split = [&](std::vector<Entry> &entries,
+                   const std::vector<Entry> *kept) {
+    std::vector<Entry> first, again;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const bool duplicate =
+          (i > 0 && entries[i].fingerprint == entries[i - 1].fingerprint) ||
+          (kept != nullptr &&
+           std::binary_search(kept->begin(), kept->end(),
+                              Entry{entries[i].fingerprint, 0},
+                              [](const Entry &a, const Entry &b) {
+                                return a.fingerprint < b.fingerprint;
+                              }));
+      (duplicate ? again : first).push_back(entries[i]);
+    }
+    entries.swap(first);
+    return again;
+  };
+  retry = split(keep, nullptr);
+  for (int round = 1; !retry.empty(); ++round) {
+    if (round == 256) {
+      std::cerr << "too few distinct keys for --count.\n";
+      std::exit(1);
+    }
+    pool.parallelFor(pool.size() * 4, [&](int c) {
+      std::string key;
+      const int chunks = pool.size() * 4;
+      for (size_t j = retry.size() * c / chunks;
+           j < retry.size() * (c + 1) / chunks; ++j) {
+        const uint64_t i = retry[j].index;
+        attempts[i] = round;
+        makeKey(i, round, key);
+        retry[j].fingerprint = wyHash(key);
+      }
+    });
+    std::sort(retry.begin(), retry.end());
+    std::vector<Entry> again = split(retry, &keep);
+    const size_t middle = keep.size();
+    keep.insert(keep.end(), retry.begin(), retry.end());
+    std::inplace_merge(keep.begin(), keep.begin() + middle, keep.end());
+    retry.swap(again);
+  }
+}
+
+// Lines written per chunk, a multiple of 64 so that chunks never share a
+// word of the flag bitmap.
+const uint64_t CHUNK = 1 << 16;
+
+// Keys [0, insertedKeys) are inserted; which key that is depends only on its
+// random draw, the files permute them.
+uint64_t insertedKeys;
+
+void fail(const std::string &what) {
+  std::cerr << what << " " << o.out << ": " << std::strerror(errno) << ".\n";
+  std::exit(1);
+}
+
+// Write name.txt with the keys keyOf(0), ..., keyOf(lines - 1), formatted in
+// parallel and written in order.
+template <typename F>
+void writeText(const std::string &name, uint64_t lines, WorkerPool &pool,
+               F keyOf) {
+  std::ofstream file(o.out + "/" + name + ".txt", std::ios::binary);
+  if (!file) {
+    fail("cannot write " + name + ".txt in");
+  }
+  const int batch = pool.size() * 4;
+  std::vector<std::string> buffers(batch);
+  for (uint64_t base = 0; base < lines; base += batch * CHUNK) {
+    pool.parallelFor(batch, [&](int c) {
+      std::string &buffer = buffers[c];
+      std::string key;
+      buffer.clear();
+      const uint64_t first = std::min(lines, base + c * CHUNK);
+      const uint64_t last = std::min(lines, first + CHUNK);
+      for (uint64_t j = first; j < last; ++j) {
+        const uint64_t i = keyOf(j);
+        makeKey(i, attempts[i], key);
+        buffer += key;
+        buffer += i < insertedKeys ? " 1\n" : " 0\n";
+      }
+    });
+    for (const std::string &buffer : buffers) {
+      file.write(buffer.data(), buffer.size());
+    }
+  }
+}
+
+// Write name.bin, see tests/KeyFile.h. A first pass sums the key bytes of
+// every chunk; the second maps the file and writes all chunks in parallel
+// at their offsets.
+template <typename F>
+void writeBinary(const std::string &name, uint64_t lines, WorkerPool &pool,
+                 F keyOf) {
+  const uint64_t chunks = (lines + CHUNK - 1) / CHUNK;
+  std::vector<uint64_t> chunkBytes(chunks + 1);
+  pool.parallelFor(chunks, [&](int c) {
+    std::string key;
+    uint64_t total = 0;
+    for (uint64_t j = c * CHUNK; j < std::min(lines, (c + 1) * CHUNK); ++j) {
+      const uint64_t i = keyOf(j);
+      makeKey(i, attempts[i], key);
+      total += key.size();
+    }
+    chunkBytes[c + 1] = total;
+  });
+  for (uint64_t c = 0; c < chunks; ++c) {
+    chunkBytes[c + 1] += chunkBytes[c];
+  }
+  const uint64_t keyBytes = chunkBytes[chunks];
+  const uint64_t length = KeyFileHeader::bytesStart(lines) + keyBytes;
+
+  const std::string path = o.out + "/" + name + ".bin";
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, length) != 0) {
+    fail("cannot write " + name + ".bin in");
+  }
+  void *map = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    fail("cannot map " + name + ".bin in");
   }
+  char *base = static_cast<char *>(map);
+  KeyFileHeader header = {};
+  std::memcpy(header.magic, KeyFileHeader::MAGIC, sizeof(header.magic));
+  header.count = lines;
+  header.keyBytes = keyBytes;
+  std::memcpy(base, &header, sizeof(header));
+  uint64_t *offsets =
+      reinterpret_cast<uint64_t *>(base + KeyFileHeader::offsetsStart());
+  uint64_t *flags =
+      reinterpret_cast<uint64_t *>(base + KeyFileHeader::flagsStart(lines));
+  char *bytes = base + KeyFileHeader::bytesStart(lines);
+  offsets[lines] = keyBytes;
+  pool.parallelFor(chunks, [&](int c) {
+    std::string key;
+    uint64_t offset = chunkBytes[c];
+    for (uint64_t j = c * CHUNK; j < std::min(lines, (c + 1) * CHUNK); ++j) {
+      const uint64_t i = keyOf(j);
+      makeKey(i, attempts[i], key);
+      offsets[j] = offset;
+      std::memcpy(bytes + offset, key.data(), key.size());
+      offset += key.size();
+      if (i < insertedKeys) {
+        flags[j / 64] |= 1ULL << (j % 64);
+      }
+    }
+  });
+  munmap(map, length);
+  ::close(fd);
+}
+
+// Write one file in the requested formats.
+template <typename F>
+void writeFile(const std::string &name, uint64_t lines, WorkerPool &pool,
+               F keyOf) {
+  if (o.format != Options::BINARY) {
+    writeText(name, lines, pool, keyOf);
+  }
+  if (o.format != Options::TEXT) {
+    writeBinary(name, lines, pool, keyOf);
+  }
+}
+
+// Write a file listing every key once, in a seeded order.
+void writePermutation(const std::string &name, Stream stream,
+                      WorkerPool &pool) {
+  const Permutation order(stream, o.count);
+  writeFile(name, o.count, pool, order);
+}
+
+// Write the skewed search file.
+void writeLookups(WorkerPool &pool) {
+  const uint64_t missingKeys = o.count - insertedKeys;
+  // Hot ranks are scattered over the keys by permutations.
+  const Permutation hits(HOT_ORDER, std::max<uint64_t>(insertedKeys, 1));
+  const Permutation misses(HOT_ORDER, std::max<uint64_t>(missingKeys, 1));
+  const Zipf hitRank(std::max<uint64_t>(insertedKeys, 1), o.zipf);
+  const Zipf missRank(std::max<uint64_t>(missingKeys, 1), o.zipf);
+  writeFile("search", o.searches, pool, [&](uint64_t j) {
+    Random r(LOOKUP, j);
+    const bool hit =
+        missingKeys == 0 || (insertedKeys > 0 && r.real() < o.hitRatio);
+    return hit ? hits(hitRank(r)) : insertedKeys + misses(missRank(r));
+  });
+}
+
+void usage() {
+  std::cerr
+      << "usage: generate_data.out [--count=N] [--seed=N] [--threads=N] "
+         "[--out=DIR]\n"
+         "  [--format=text|binary|both]\n"
+         "  [--length=uniform:MIN:MAX|normal:MEAN:STDDEV|fixed:N]\n"
+         "  [--alphabet=printable|alnum|lower|hex|chars:CHARACTERS]\n"
+         "  [--prefixes=N] [--inserted=FRACTION]\n"
+         "  [--searches=N] [--hit-ratio=FRACTION] [--zipf=EXPONENT]\n";
+}
 
-  // Let half of them insert into the hashmap.
-  for (uint32_t i = 0; i <= N / 2 - 1; ++i) {
-    tests[i].second = true;
+std::vector<std::string> split(const std::string &s, char sep) {
+  std::vector<std::string> parts;
+  std::istringstream in(s);
+  std::string part;
+  while (std::getline(in, part, sep)) {
+    parts.push_back(part);
+  }
+  return parts;
+}
+
+// Parse the command line, returns false on a bad option.
+bool parse(int argc, char *argv[]) {
+  std::string alphabet = "printable";
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      return false;
+    }
+    const std::string name = arg.substr(2, eq - 2);
+    const std::string value = arg.substr(eq + 1);
+    if (name == "count") {
+      o.count = std::strtoull(value.c_str(), nullptr, 10);
+      if (o.count < 1 || o.count > (1ULL << 40)) {
+        return false;
+      }
+    } else if (name == "seed") {
+      o.seed = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "threads") {
+      o.threads = std::atoi(value.c_str());
+      if (o.threads < 1) {
+        return false;
+      }
+    } else if (name == "out") {
+      o.out = value;
+    } else if (name == "format") {
+      if (value == "text") {
+        o.format = Options::TEXT;
+      } else if (value == "binary") {
+        o.format = Options::BINARY;
+      } else if (value == "both") {
+        o.format = Options::BOTH;
+      } else {
+        return false;
+      }
+    } else if (name == "length") {
+      const std::vector<std::string> parts = split(value, ':');
+      if (parts.size() == 3 && parts[0] == "uniform") {
+        o.length = Options::UNIFORM;
+      } else if (parts.size() == 3 && parts[0] == "normal") {
+        o.length = Options::NORMAL;
+      } else if (parts.size() == 2 && parts[0] == "fixed") {
+        o.length = Options::FIXED;
+      } else {
+        return false;
+      }
+      o.lengthA = std::atof(parts[1].c_str());
+      o.lengthB = parts.size() == 3 ? std::atof(parts[2].c_str()) : 0;
+      if (o.lengthA < 1 ||
+          (o.length == Options::UNIFORM && o.lengthB < o.lengthA)) {
+        return false;
+      }
+    } else if (name == "alphabet") {
+      alphabet = value;
+    } else if (name == "prefixes") {
+      o.prefixes = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "inserted") {
+      o.inserted = std::atof(value.c_str());
+      if (o.inserted < 0 || o.inserted > 1) {
+        return false;
+      }
+    } else if (name == "searches") {
+      o.searches = std::strtoull(value.c_str(), nullptr, 10);
+      o.skewed = true;
+    } else if (name == "hit-ratio") {
+      o.hitRatio = std::atof(value.c_str());
+      o.skewed = true;
+      if (o.hitRatio < 0 || o.hitRatio > 1) {
+        return false;
+      }
+    } else if (name == "zipf") {
+      o.zipf = std::atof(value.c_str());
+      o.skewed = true;
+      if (o.zipf < 0) {
+        return false;
+      }
+    } else {
+      return false;
+    }
   }
 
-  // File for inserts.
-  random_shuffle(tests.begin(), tests.end());
-  std::ofstream insertFile("insert.txt");
-  for (uint32_t i = 0; i <= N - 1; ++i) {
-    insertFile << tests[i].first << " " << tests[i].second << "\n";
+  if (alphabet == "printable") {
+    // ASCII 33 to 122, as the original generator.
+    for (char c = 33; c <= 122; ++c) {
+      o.alphabet += c;
+    }
+  } else if (alphabet == "alnum") {
+    o.alphabet =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  } else if (alphabet == "lower") {
+    o.alphabet = "abcdefghijklmnopqrstuvwxyz";
+  } else if (alphabet == "hex") {
+    o.alphabet = "0123456789abcdef";
+  } else if (alphabet.compare(0, 6, "chars:") == 0) {
+    o.alphabet = alphabet.substr(6);
+  } else {
+    return false;
+  }
+  // The files separate keys and flags by whitespace.
+  if (o.alphabet.empty() || o.alphabet.find_first_of(" \t\n\r\v\f") !=
+                                std::string::npos) {
+    return false;
+  }
+  if (o.searches == 0) {
+    o.searches = o.count;
   }
-  insertFile.close();
+  if (o.hitRatio < 0) {
+    o.hitRatio = o.inserted;
+  }
+  return true;
+}
 
-  // File for search.
-  random_shuffle(tests.begin(), tests.end());
-  std::ofstream searchFile("search.txt");
-  for (uint32_t i = 0; i <= N - 1; ++i) {
-    searchFile << tests[i].first << " " << tests[i].second << "\n";
+int main(int argc, char *argv[]) {
+  if (!parse(argc, argv)) {
+    usage();
+    return 1;
   }
-  searchFile.close();
+  WorkerPool pool(o.threads);
+  insertedKeys = uint64_t(o.count * o.inserted);
+  makePrefixes();
+  makeUnique(pool);
 
-  // File for deletion.
-  random_shuffle(tests.begin(), tests.end());
-  std::ofstream deleteFile("delete.txt");
-  for (uint32_t i = 0; i <= N - 1; ++i) {
-    deleteFile << tests[i].first << " " << tests[i].second << "\n";
+  writePermutation("insert", INSERT_ORDER, pool);
+  if (o.skewed) {
+    writeLookups(pool);
+  } else {
+    writePermutation("search", SEARCH_ORDER, pool);
   }
-  deleteFile.close();
+  writePermutation("delete", DELETE_ORDER, pool);
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,89 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/**
+ * Counts calls to the global operator new while enabled, and the resident
+ * set size before and after, for the "allocations" mode of the test
+ * applications. It replaces operator new and delete, so include it from
+ * exactly one translation unit.
+ */
+namespace AllocationCounter {
+
+inline std::atomic<bool> enabled(false);
+inline std::atomic<long> allocations(0);
+inline long rssBefore = 0;
+
+// Whether "allocations" was passed on the command line.
+inline bool requested(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "allocations") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Resident set size in bytes. Where /proc is missing this is the peak
+// resident set size instead.
+inline long residentBytes() {
+  long pages, resident;
+  std::ifstream statm("/proc/self/statm");
+  if (statm >> pages >> resident) {
+    return resident * sysconf(_SC_PAGESIZE);
+  }
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024L;
+#endif
+}
+
+// Start counting from zero.
+inline void start() {
+  rssBefore = residentBytes();
+  allocations = 0;
+  enabled = true;
+}
+
+// Stop counting and print the allocations per operation of a phase and the
+// resident set size before and after it.
+inline void report(const char *phase, int operations) {
+  enabled = false;
+  std::cout << phase << " allocations: "
+            << double(allocations.load()) / operations
+            << " per operation, RSS " << rssBefore / (1 << 20) << " -> "
+            << residentBytes() / (1 << 20) << " MB.\n";
+}
+
+} // namespace AllocationCounter
+
+void *operator new(std::size_t size) {
+  if (AllocationCounter::enabled.load(std::memory_order_relaxed)) {
+    AllocationCounter::allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+#endif // ALLOCATION_COUNTER_H
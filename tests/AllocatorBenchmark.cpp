@@ -0,0 +1,106 @@
+#include "../src/SlabAllocator.h"
+#include "AllocationCounter.h"
+#include "KeyFile.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A multi-threaded benchmark of the key storage of the chain hash maps on the
+ * keys of testdata/insert.txt: heap std::string copies (a std::string object
+ * plus, for long keys, its buffer) against single block InlineKeys from the
+ * SlabAllocator.
+ *
+ * Every thread allocates its share of the keys, then frees the share of the
+ * next thread, as the EpochManager does when another thread collects, and
+ * finally allocates its share again. Prints the time of each phase and the
+ * resident set size after it.
+ */
+std::vector<std::string> keys;
+
+struct HeapStrings {
+  static const char *name() { return "std::string"; }
+  typedef const std::string *Key;
+  static Key create(std::string_view key) { return new std::string(key); }
+  static void destroy(Key key) { delete key; }
+};
+
+struct SlabKeys {
+  static const char *name() { return "InlineKey"; }
+  typedef const InlineKey *Key;
+  static Key create(std::string_view key) { return InlineKey::create(key); }
+  static void destroy(Key key) { InlineKey::destroy(key); }
+};
+
+// At least two, so that every key is freed by another thread.
+int threads() { return std::max(2, int(std::thread::hardware_concurrency())); }
+
+// Run task(thread, start, n) on every core over [0, N), returns the time in
+// ms.
+double run(const std::function<void(int, int, int)> &task, int cores) {
+  const int N = keys.size();
+  std::vector<std::thread> threads;
+  std::chrono::high_resolution_clock::time_point start, end;
+  start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < cores; ++i) {
+    const int n = N / cores + (i == cores - 1 ? N % cores : 0);
+    threads.push_back(std::thread(task, i, i * (N / cores), n));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename Storage> void benchmark() {
+  const int N = keys.size();
+  const int cores = threads();
+  std::vector<typename Storage::Key> stored(N);
+  auto allocate = [&](int, int start, int n) {
+    for (int i = start; i < start + n; ++i) {
+      stored[i] = Storage::create(keys[i]);
+    }
+  };
+  // Free the share of the next thread.
+  auto release = [&](int thread, int, int) {
+    const int next = (thread + 1) % cores;
+    const int start = next * (N / cores);
+    const int n = N / cores + (next == cores - 1 ? N % cores : 0);
+    for (int i = start; i < start + n; ++i) {
+      Storage::destroy(stored[i]);
+    }
+  };
+
+  const long rss = AllocationCounter::residentBytes();
+  std::cout << Storage::name() << ", RSS " << rss / (1 << 20) << " MB.\n";
+  const double first = run(allocate, cores);
+  std::cout << "  allocate: " << first << " ms, RSS "
+            << AllocationCounter::residentBytes() / (1 << 20) << " MB.\n";
+  const double freed = run(release, cores);
+  std::cout << "  free from other threads: " << freed << " ms, RSS "
+            << AllocationCounter::residentBytes() / (1 << 20) << " MB.\n";
+  const double again = run(allocate, cores);
+  std::cout << "  allocate again: " << again << " ms, RSS "
+            << AllocationCounter::residentBytes() / (1 << 20) << " MB.\n";
+  run(release, cores);
+}
+
+int main(int argc, char *argv[]) {
+  KeyFile insertFile("testdata/insert");
+  for (size_t i = 0; i < insertFile.size(); ++i) {
+    keys.push_back(std::string(insertFile.key(i)));
+  }
+
+  std::cout << keys.size() << " keys, "
+            << threads() << " threads.\n";
+  benchmark<HeapStrings>();
+  benchmark<SlabKeys>();
+  std::cout << "Slabs reserved: " << SlabAllocator::reserved() / (1 << 20)
+            << " MB.\n";
+  return 0;
+}
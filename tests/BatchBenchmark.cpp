@@ -0,0 +1,113 @@
+#include "../src/ChainHashMapRehashThreads.h"
+#include "../src/SwissHashMap.h"
+#include "../src/ThreadSafeChainHashMap.h"
+#include "KeyFile.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/**
+ * A multi-threaded benchmark comparing the single key search loop of
+ * test_search with searchBatch at increasing batch sizes, on the keys of
+ * testdata/search.txt. The maps are filled with insertBatch and emptied with
+ * removeBatch.
+ */
+const int BATCH_SIZES[] = {16, 64, 256, 1024};
+const int MAX_BATCH = 1024;
+
+std::vector<std::string_view> views;
+std::vector<bool> expected;
+
+void search_single(int start, int n, const AbstractHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.search(views[i]) == expected[i]);
+  }
+}
+
+void search_batch(int start, int n, int batch, const AbstractHashMap &h) {
+  bool results[MAX_BATCH];
+  for (int i = start; i < start + n; i += batch) {
+    const int m = std::min(batch, start + n - i);
+    h.searchBatch(&views[i], m, results);
+    for (int j = 0; j < m; ++j) {
+      assert(results[j] == expected[i + j]);
+    }
+  }
+}
+
+// Split [0, N) over the cores like the test applications, returns the time
+// in ms.
+double run(const std::function<void(int, int)> &task) {
+  const int N = views.size();
+  const int cores = std::thread::hardware_concurrency();
+  std::vector<std::thread> threads;
+  std::chrono::high_resolution_clock::time_point start, end;
+  start = std::chrono::high_resolution_clock::now();
+  int p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(task, p, N / cores));
+    p += N / cores;
+  }
+  threads.push_back(std::thread(task, p, N / cores + N % cores));
+  for (auto &t : threads) {
+    t.join();
+  }
+  end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void benchmark(const std::string &name, AbstractHashMap &h,
+               std::vector<std::string> keys) {
+  bool results[MAX_BATCH];
+  for (int i = 0; i < int(keys.size()); i += MAX_BATCH) {
+    const int m = std::min(MAX_BATCH, int(keys.size()) - i);
+    h.insertBatch(&keys[i], m, results);
+  }
+  assert(h.size() == int(keys.size()));
+
+  const double single = run([&](int start, int n) { search_single(start, n, h); });
+  std::cout << name << "\n  single key: " << single << " ms.\n";
+  for (int batch : BATCH_SIZES) {
+    const double time =
+        run([&](int start, int n) { search_batch(start, n, batch, h); });
+    std::cout << "  batch " << batch << ": " << time << " ms (x"
+              << single / time << ").\n";
+  }
+
+  for (int i = 0; i < int(views.size()); i += MAX_BATCH) {
+    const int m = std::min(MAX_BATCH, int(views.size()) - i);
+    h.removeBatch(&views[i], m, results);
+    for (int j = 0; j < m; ++j) {
+      assert(results[j] == expected[i + j]);
+    }
+  }
+  assert(h.size() == 0);
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> keys;
+  KeyFile insertFile("testdata/insert");
+  for (size_t i = 0; i < insertFile.size(); ++i) {
+    if (insertFile.flag(i)) {
+      keys.push_back(std::string(insertFile.key(i)));
+    }
+  }
+
+  KeyFile searchFile("testdata/search");
+  for (size_t i = 0; i < searchFile.size(); ++i) {
+    views.push_back(searchFile.key(i));
+    expected.push_back(searchFile.flag(i));
+  }
+
+  ThreadSafeChainHashMap threadSafe;
+  benchmark("ThreadSafeChainHashMap", threadSafe, keys);
+  ChainHashMapRehashThreads rehashThreads(0.8, 5000, 500000);
+  benchmark("ChainHashMapRehashThreads", rehashThreads, keys);
+  SwissHashMap swiss;
+  benchmark("SwissHashMap", swiss, keys);
+  return 0;
+}
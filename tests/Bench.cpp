@@ -0,0 +1,733 @@
+#include "../src/ChainHashMap.h"
+#include "../src/ChainHashMapRehashOpenMp.h"
+#include "../src/ChainHashMapRehashThreads.h"
+#include "../src/ConcurrentHashMap.h"
+#include "../src/CuckooHashMap.h"
+#include "../src/DelegationHashMap.h"
+#include "../src/HopscotchHashMap.h"
+#include "../src/SplitOrderedHashMap.h"
+#include "../src/SwissHashMap.h"
+#include "../src/ThreadSafeChainHashMap.h"
+#include "LatencyRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * A benchmark driver running a mixed workload against any map by name.
+ *
+ * A key set of --keys random keys is generated from --seed and about
+ * --prefill of it is inserted before the clock starts. Every thread then
+ * runs searches, insertions and deletions in the --mix ratio for --duration
+ * seconds, on keys drawn uniformly or from a Zipf distribution whose rank 0
+ * is the hottest key. Operation and key sequences are drawn up front, so the
+ * timed loop only touches the map.
+ *
+ * Several maps accept duplicate keys, so writes are sharded: a thread only
+ * inserts and deletes the keys it owns (index % threads) and tracks which of
+ * them are present. An insertion of a present key searches it instead and
+ * counts as a miss, the work a map with unique keys would do. Each map is
+ * run at each thread count of --threads and the throughput per operation
+ * type is written as text, CSV or JSON.
+ *
+ * --latency times every operation into per-thread histograms and adds the
+ * p50, p99, p99.9 and max latency per operation type to the output.
+ * --timeseries=FILE writes the operations completed per 10 ms window as CSV,
+ * which shows resize pauses and lock convoys that averages hide. Both read
+ * the clock twice per operation, so compare their throughput only with other
+ * timed runs.
+ *
+ * --stats=FILE counts contended lock acquisitions during the runs and appends
+ * each map's stats() snapshot to FILE, or prints it for --stats=-.
+ *
+ *   bench.out --map=threadsafe,swiss --threads=1,2,4 --mix=90:5:5
+ *             --dist=zipf --zipf=0.99 --keys=1000000 --format=csv
+ */
+
+// Operations drawn per thread; the sequences wrap around.
+const int SAMPLES = 1 << 20;
+
+enum Op { READ, INSERT, DELETE, OPS };
+const char *const OP_NAMES[OPS] = {"read", "insert", "delete"};
+
+struct Options {
+  std::vector<std::string> maps = {"threadsafe"};
+  std::vector<int> threads = {
+      std::max(1, int(std::thread::hardware_concurrency()))};
+  // Weights of searches, insertions and deletions.
+  int mix[OPS] = {90, 5, 5};
+  bool zipf = false;
+  double zipfExponent = 0.99;
+  double duration = 1;
+  int keys = 1000000;
+  double prefill = 0.5;
+  uint64_t seed = 1;
+  int servers = std::max(1, int(std::thread::hardware_concurrency()) / 2);
+  std::string format = "text";
+  bool latency = false;
+  // File of the throughput time series, empty for none.
+  std::string timeseries;
+  // File the map statistics are appended to, empty for none.
+  std::string stats;
+};
+
+/**
+ * std::unordered_set behind the AbstractHashMap interface, the single
+ * threaded baseline. Lookups build a std::string, as C++17 has no
+ * heterogeneous lookup.
+ */
+class UnorderedSetMap : public AbstractHashMap {
+
+public:
+  bool insert(std::string &&key) { return set.insert(std::move(key)).second; }
+  using AbstractHashMap::insert;
+
+  bool search(std::string_view key) const {
+    return set.find(std::string(key)) != set.end();
+  }
+
+  bool remove(std::string_view key) { return set.erase(std::string(key)); }
+
+  int size() const { return set.size(); }
+
+private:
+  std::unordered_set<std::string> set;
+};
+
+/**
+ * std::unordered_set behind one mutex, the thread safe baseline.
+ */
+class LockedUnorderedSetMap : public AbstractHashMap {
+
+public:
+  bool insert(std::string &&key) {
+    std::lock_guard<std::mutex> lk(mtx);
+    return set.insert(std::move(key)).second;
+  }
+  using AbstractHashMap::insert;
+
+  bool search(std::string_view key) const {
+    const std::string k(key);
+    std::lock_guard<std::mutex> lk(mtx);
+    return set.find(k) != set.end();
+  }
+
+  bool remove(std::string_view key) {
+    const std::string k(key);
+    std::lock_guard<std::mutex> lk(mtx);
+    return set.erase(k);
+  }
+
+  int size() const {
+    std::lock_guard<std::mutex> lk(mtx);
+    return set.size();
+  }
+
+private:
+  std::unordered_set<std::string> set;
+  mutable std::mutex mtx;
+};
+
+struct MapType {
+  const char *name;
+  // Whether the map can be shared by several threads.
+  bool concurrent;
+  std::function<AbstractHashMap *(const Options &)> create;
+};
+
+const std::vector<MapType> &mapTypes() {
+  static const std::vector<MapType> types = {
+      {"chain", false, [](const Options &) { return new ChainHashMap(); }},
+      {"threadsafe", true,
+       [](const Options &) { return new ThreadSafeChainHashMap(); }},
+      {"threadsafe-spinlock", true,
+       [](const Options &) {
+         return new ThreadSafeChainHashMap(wyHash, LockStripes::SPINLOCK);
+       }},
+      {"threadsafe-mcs", true,
+       [](const Options &) {
+         return new ThreadSafeChainHashMap(wyHash, LockStripes::MCS);
+       }},
+      {"threadsafe-numa", true,
+       [](const Options &) {
+         return new ThreadSafeChainHashMap(
+             wyHash, LockStripes::MUTEX, ThreadSafeChainHashMap::DEFAULT_STRIPES,
+             ThreadSafeChainHashMap::NUMA_NODES);
+       }},
+      {"rehash-threads", true,
+       [](const Options &) {
+         return new ChainHashMapRehashThreads(0.8, 1024, 1024);
+       }},
+      {"rehash-openmp", true,
+       [](const Options &) {
+         return new ChainHashMapRehashOpenMp(0.8, 1024, 1024);
+       }},
+      {"rehash-openmp-coop", true,
+       [](const Options &) {
+         return new ChainHashMapRehashOpenMp(
+             0.8, 1024, 1024, ChainHashMapRehashOpenMp::COOPERATIVE);
+       }},
+      {"swiss", true, [](const Options &) { return new SwissHashMap(); }},
+      {"cuckoo", true, [](const Options &) { return new CuckooHashMap(); }},
+      {"hopscotch", true,
+       [](const Options &) { return new HopscotchHashMap(); }},
+      {"split-ordered", true,
+       [](const Options &) { return new SplitOrderedHashMap(2, 4096); }},
+      {"concurrent", true,
+       [](const Options &) { return new ConcurrentHashMap<std::string>(); }},
+      {"delegation", true,
+       [](const Options &o) { return new DelegationHashMap(o.servers); }},
+      {"unordered_set", false,
+       [](const Options &) { return new UnorderedSetMap(); }},
+      {"unordered_set-locked", true,
+       [](const Options &) { return new LockedUnorderedSetMap(); }},
+  };
+  return types;
+}
+
+const MapType *findMapType(const std::string &name) {
+  for (const MapType &t : mapTypes()) {
+    if (name == t.name) {
+      return &t;
+    }
+  }
+  return nullptr;
+}
+
+// Operation counts of one thread.
+struct Counts {
+  long ops[OPS] = {};
+  // Searches which found their key, insertions and deletions which changed
+  // the map.
+  long hits[OPS] = {};
+};
+
+// Latencies and throughput over time of one thread, for timed runs.
+struct Recording {
+  LatencyHistogram latency[OPS];
+  // Reads split by whether they found their key; a miss may have to rule
+  // out every key of its bucket.
+  LatencyHistogram readHit, readMiss;
+  ThroughputSeries series;
+
+  void merge(const Recording &other) {
+    for (int op = 0; op < OPS; ++op) {
+      latency[op].merge(other.latency[op]);
+    }
+    readHit.merge(other.readHit);
+    readMiss.merge(other.readMiss);
+    series.merge(other.series);
+  }
+};
+
+// Result of one map at one thread count.
+struct Result {
+  std::string map;
+  int threads;
+  double seconds;
+  Counts counts;
+  Recording recording;
+};
+
+std::vector<std::string> keys;
+
+void generateKeys(const Options &o) {
+  static const char ALPHABET[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  std::mt19937_64 rng(o.seed);
+  std::uniform_int_distribution<int> length(8, 32);
+  std::uniform_int_distribution<int> letter(0, sizeof(ALPHABET) - 2);
+  std::unordered_set<std::string> seen;
+  keys.clear();
+  while (int(keys.size()) < o.keys) {
+    std::string key(length(rng), ' ');
+    for (char &c : key) {
+      c = ALPHABET[letter(rng)];
+    }
+    if (seen.insert(key).second) {
+      keys.push_back(std::move(key));
+    }
+  }
+}
+
+// Cumulative Zipf weights of the key ranks.
+std::vector<double> zipfCdf(const Options &o) {
+  std::vector<double> cdf(o.keys);
+  double sum = 0;
+  for (int i = 0; i < o.keys; ++i) {
+    sum += 1 / std::pow(i + 1, o.zipfExponent);
+    cdf[i] = sum;
+  }
+  return cdf;
+}
+
+// The key and operation sequences of one thread.
+void drawSamples(const Options &o, const std::vector<double> &cdf, int t,
+                 int threads, std::vector<int> &samples,
+                 std::vector<uint8_t> &ops) {
+  std::mt19937_64 rng(o.seed * 1000003 + t);
+  std::uniform_int_distribution<int> uniform(0, o.keys - 1);
+  std::uniform_real_distribution<double> weight(0, o.zipf ? cdf.back() : 1);
+  std::uniform_int_distribution<int> op(0, o.mix[READ] + o.mix[INSERT] +
+                                               o.mix[DELETE] - 1);
+  samples.resize(SAMPLES);
+  ops.resize(SAMPLES);
+  for (int i = 0; i < SAMPLES; ++i) {
+    samples[i] =
+        o.zipf ? std::lower_bound(cdf.begin(), cdf.end(), weight(rng)) -
+                     cdf.begin()
+               : uniform(rng);
+    const int r = op(rng);
+    ops[i] = r < o.mix[READ]                    ? READ
+             : r < o.mix[READ] + o.mix[INSERT] ? INSERT
+                                               : DELETE;
+    // Move writes to the nearest key owned by the thread.
+    if (ops[i] != READ) {
+      int &k = samples[i];
+      k = k - k % threads + t;
+      if (k >= o.keys) {
+        k -= threads;
+      }
+    }
+  }
+}
+
+// Nanoseconds since start.
+uint64_t since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// present[k] is only written by the owner of key k. Untimed runs compile
+// without the clock reads.
+template <bool TIMED>
+void worker(AbstractHashMap &h, const std::vector<int> &samples,
+            const std::vector<uint8_t> &ops, std::vector<uint8_t> &present,
+            const std::atomic<bool> &stop,
+            std::chrono::steady_clock::time_point start, Counts &counts,
+            Recording &recording) {
+  Counts c;
+  Recording r;
+  for (int i = 0; !stop.load(std::memory_order_relaxed);
+       i = (i + 1) & (SAMPLES - 1)) {
+    const uint64_t begin = TIMED ? since(start) : 0;
+    const int k = samples[i];
+    const std::string &key = keys[k];
+    bool hit = false;
+    switch (ops[i]) {
+    case READ:
+      hit = h.search(key);
+      break;
+    case INSERT:
+      if (present[k]) {
+        h.search(key);
+      } else {
+        hit = h.insert(std::string_view(key));
+        present[k] = true;
+      }
+      break;
+    case DELETE:
+      hit = h.remove(key);
+      present[k] = false;
+      break;
+    }
+    if (TIMED) {
+      const uint64_t end = since(start);
+      r.latency[ops[i]].record(end - begin);
+      if (ops[i] == READ) {
+        (hit ? r.readHit : r.readMiss).record(end - begin);
+      }
+      r.series.record(end);
+    }
+    ++c.ops[ops[i]];
+    c.hits[ops[i]] += hit;
+  }
+  counts = c;
+  recording = std::move(r);
+}
+
+Result run(const Options &o, const MapType &type, int threads,
+           const std::vector<double> &cdf) {
+  std::unique_ptr<AbstractHashMap> h(type.create(o));
+  h->collectStats(!o.stats.empty());
+  // Prefill a random subset of the keys, every thread its own keys.
+  std::vector<uint8_t> present(o.keys);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&, t]() {
+      for (int i = t; i < o.keys; i += threads) {
+        if (std::hash<std::string>()(keys[i]) % 1000 < o.prefill * 1000) {
+          h->insert(std::string_view(keys[i]));
+          present[i] = true;
+        }
+      }
+    }));
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  workers.clear();
+
+  std::vector<std::vector<int>> samples(threads);
+  std::vector<std::vector<uint8_t>> ops(threads);
+  for (int t = 0; t < threads; ++t) {
+    drawSamples(o, cdf, t, threads, samples[t], ops[t]);
+  }
+
+  std::vector<Counts> counts(threads);
+  std::vector<Recording> recordings(threads);
+  std::atomic<bool> stop(false);
+  const bool timed = o.latency || !o.timeseries.empty();
+  const auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread(timed ? worker<true> : worker<false>,
+                                  std::ref(*h), std::cref(samples[t]),
+                                  std::cref(ops[t]), std::ref(present),
+                                  std::cref(stop), start, std::ref(counts[t]),
+                                  std::ref(recordings[t])));
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(o.duration));
+  stop = true;
+  for (auto &w : workers) {
+    w.join();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  if (!o.stats.empty()) {
+    std::ostringstream title;
+    title << type.name << ", " << threads << " threads:\n";
+    if (o.stats == "-") {
+      std::cout << title.str();
+    } else {
+      std::ofstream(o.stats, std::ios::app) << title.str();
+    }
+    h->dumpStats(o.stats);
+  }
+
+  Result r{type.name, threads,
+           std::chrono::duration<double>(end - start).count(), Counts(),
+           Recording()};
+  for (int t = 0; t < threads; ++t) {
+    for (int op = 0; op < OPS; ++op) {
+      r.counts.ops[op] += counts[t].ops[op];
+      r.counts.hits[op] += counts[t].hits[op];
+    }
+    r.recording.merge(recordings[t]);
+  }
+  return r;
+}
+
+std::string mixString(const Options &o) {
+  return std::to_string(o.mix[READ]) + ":" + std::to_string(o.mix[INSERT]) +
+         ":" + std::to_string(o.mix[DELETE]);
+}
+
+std::string distString(const Options &o) {
+  if (!o.zipf) {
+    return "uniform";
+  }
+  std::ostringstream s;
+  s << "zipf-" << o.zipfExponent;
+  return s.str();
+}
+
+// Rows of a result: one per operation type, the reads split into hits and
+// misses, and "all".
+template <typename F> void forEachRow(const Result &r, F f) {
+  long ops = 0, hits = 0;
+  LatencyHistogram all;
+  for (int op = 0; op < OPS; ++op) {
+    f(OP_NAMES[op], r.counts.ops[op], r.counts.hits[op],
+      r.recording.latency[op]);
+    ops += r.counts.ops[op];
+    hits += r.counts.hits[op];
+    all.merge(r.recording.latency[op]);
+  }
+  f("read-hit", r.counts.hits[READ], r.counts.hits[READ],
+    r.recording.readHit);
+  f("read-miss", r.counts.ops[READ] - r.counts.hits[READ], 0L,
+    r.recording.readMiss);
+  f("all", ops, hits, all);
+}
+
+void printText(const Options &o, const Result &r) {
+  std::cout << r.map << ", " << r.threads << " threads:";
+  forEachRow(r, [&](const char *op, long ops, long hits,
+                    const LatencyHistogram &) {
+    std::cout << " " << op << " " << ops / r.seconds / 1e6 << " Mops/s";
+    if (ops > 0 && std::strcmp(op, "all") != 0) {
+      std::cout << " (" << 100.0 * hits / ops << "% hits)";
+    }
+    std::cout << (std::strcmp(op, "all") == 0 ? ".\n" : ",");
+  });
+  if (!o.latency) {
+    return;
+  }
+  forEachRow(r, [&](const char *op, long, long, const LatencyHistogram &l) {
+    if (l.count() > 0) {
+      std::cout << "  " << op << " latency: p50 " << l.percentile(0.5)
+                << " ns, p99 " << l.percentile(0.99) << " ns, p99.9 "
+                << l.percentile(0.999) << " ns, max " << l.max() << " ns.\n";
+    }
+  });
+}
+
+void printCsvHeader(const Options &o) {
+  std::cout << "map,threads,mix,dist,keys,op,ops,hits,seconds,ops_per_sec,"
+               "ops_per_sec_per_thread"
+            << (o.latency ? ",p50_ns,p99_ns,p999_ns,max_ns" : "") << "\n";
+}
+
+void printCsv(const Options &o, const Result &r) {
+  forEachRow(r, [&](const char *op, long ops, long hits,
+                    const LatencyHistogram &l) {
+    std::cout << r.map << "," << r.threads << "," << mixString(o) << ","
+              << distString(o) << "," << o.keys << "," << op << "," << ops
+              << "," << hits << "," << r.seconds << "," << ops / r.seconds
+              << "," << ops / r.seconds / r.threads;
+    if (o.latency) {
+      std::cout << "," << l.percentile(0.5) << "," << l.percentile(0.99)
+                << "," << l.percentile(0.999) << "," << l.max();
+    }
+    std::cout << "\n";
+  });
+}
+
+void printJson(const Options &o, const std::vector<Result> &results) {
+  std::cout << "{\n  \"workload\": {\"mix\": \"" << mixString(o)
+            << "\", \"dist\": \"" << distString(o) << "\", \"keys\": "
+            << o.keys << ", \"prefill\": " << o.prefill
+            << ", \"duration\": " << o.duration << ", \"seed\": " << o.seed
+            << "},\n  \"results\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    std::cout << (i == 0 ? "\n" : ",\n") << "    {\"map\": \"" << r.map
+              << "\", \"threads\": " << r.threads
+              << ", \"seconds\": " << r.seconds << ", \"ops\": {";
+    bool first = true;
+    forEachRow(r, [&](const char *op, long ops, long hits,
+                      const LatencyHistogram &l) {
+      std::cout << (first ? "" : ", ") << "\"" << op << "\": {\"ops\": " << ops
+                << ", \"hits\": " << hits
+                << ", \"ops_per_sec\": " << ops / r.seconds;
+      if (o.latency) {
+        std::cout << ", \"latency_ns\": {\"p50\": " << l.percentile(0.5)
+                  << ", \"p99\": " << l.percentile(0.99)
+                  << ", \"p99.9\": " << l.percentile(0.999)
+                  << ", \"max\": " << l.max() << "}";
+      }
+      std::cout << "}";
+      first = false;
+    });
+    std::cout << "}}";
+  }
+  std::cout << "\n  ]\n}\n";
+}
+
+// Rows of the time series file: the operations of each window of a run.
+void writeTimeseries(std::ostream &out, const Result &r) {
+  const std::vector<uint64_t> &windows = r.recording.series.counts();
+  const double window = ThroughputSeries::WINDOW_NS / 1e9;
+  for (size_t w = 0; w < windows.size(); ++w) {
+    // The last window is cut short by the end of the run.
+    const double length = std::min(window, r.seconds - w * window);
+    out << r.map << "," << r.threads << ","
+        << w * ThroughputSeries::WINDOW_NS / 1000000 << "," << windows[w]
+        << "," << (length > 0 ? windows[w] / length : 0) << "\n";
+  }
+}
+
+void usage() {
+  std::cerr
+      << "usage: bench.out [--map=NAME,...|all] [--threads=N,...] "
+         "[--mix=READ:INSERT:DELETE]\n"
+         "                 [--dist=uniform|zipf] [--zipf=EXPONENT] "
+         "[--duration=SECONDS]\n"
+         "                 [--keys=N] [--prefill=FRACTION] [--seed=N] "
+         "[--servers=N]\n"
+         "                 [--format=text|csv|json] [--latency] "
+         "[--timeseries=FILE]\n"
+         "                 [--stats=FILE|-]\n"
+         "maps:";
+  for (const MapType &t : mapTypes()) {
+    std::cerr << " " << t.name;
+  }
+  std::cerr << "\n";
+}
+
+std::vector<std::string> split(const std::string &s, char sep) {
+  std::vector<std::string> parts;
+  std::istringstream in(s);
+  std::string part;
+  while (std::getline(in, part, sep)) {
+    parts.push_back(part);
+  }
+  return parts;
+}
+
+// Parse the command line, returns false on a bad option.
+bool parse(int argc, char *argv[], Options &o) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--latency") {
+      o.latency = true;
+      continue;
+    }
+    const size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      return false;
+    }
+    const std::string name = arg.substr(2, eq - 2);
+    const std::string value = arg.substr(eq + 1);
+    if (name == "map") {
+      o.maps.clear();
+      for (const std::string &m : split(value, ',')) {
+        if (m == "all") {
+          for (const MapType &t : mapTypes()) {
+            o.maps.push_back(t.name);
+          }
+        } else if (findMapType(m) != nullptr) {
+          o.maps.push_back(m);
+        } else {
+          std::cerr << "unknown map " << m << "\n";
+          return false;
+        }
+      }
+    } else if (name == "threads") {
+      o.threads.clear();
+      for (const std::string &t : split(value, ',')) {
+        o.threads.push_back(std::atoi(t.c_str()));
+        if (o.threads.back() < 1) {
+          return false;
+        }
+      }
+    } else if (name == "mix") {
+      const std::vector<std::string> parts = split(value, ':');
+      if (parts.size() != OPS) {
+        return false;
+      }
+      for (int op = 0; op < OPS; ++op) {
+        o.mix[op] = std::atoi(parts[op].c_str());
+        if (o.mix[op] < 0) {
+          return false;
+        }
+      }
+      if (o.mix[READ] + o.mix[INSERT] + o.mix[DELETE] == 0) {
+        return false;
+      }
+    } else if (name == "dist") {
+      if (value != "uniform" && value != "zipf") {
+        return false;
+      }
+      o.zipf = value == "zipf";
+    } else if (name == "zipf") {
+      o.zipfExponent = std::atof(value.c_str());
+    } else if (name == "duration") {
+      o.duration = std::atof(value.c_str());
+    } else if (name == "keys") {
+      o.keys = std::atoi(value.c_str());
+      if (o.keys < 1) {
+        return false;
+      }
+    } else if (name == "prefill") {
+      o.prefill = std::atof(value.c_str());
+    } else if (name == "seed") {
+      o.seed = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "servers") {
+      o.servers = std::atoi(value.c_str());
+      if (o.servers < 1) {
+        return false;
+      }
+    } else if (name == "format") {
+      if (value != "text" && value != "csv" && value != "json") {
+        return false;
+      }
+      o.format = value;
+    } else if (name == "timeseries") {
+      if (value.empty()) {
+        return false;
+      }
+      o.timeseries = value;
+    } else if (name == "stats") {
+      if (value.empty()) {
+        return false;
+      }
+      o.stats = value;
+    } else {
+      return false;
+    }
+  }
+  // Writes move to a key the thread owns, so every thread must own one.
+  for (int threads : o.threads) {
+    if (threads > o.keys) {
+      std::cerr << "--keys must be at least the largest --threads value\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  Options o;
+  if (!parse(argc, argv, o)) {
+    usage();
+    return 1;
+  }
+  generateKeys(o);
+  const std::vector<double> cdf =
+      o.zipf ? zipfCdf(o) : std::vector<double>();
+
+  if (o.format == "text") {
+    std::cout << o.keys << " keys, mix " << mixString(o) << ", "
+              << distString(o) << ", " << o.duration << " s per run.\n";
+  } else if (o.format == "csv") {
+    printCsvHeader(o);
+  }
+  std::ofstream timeseries;
+  if (!o.timeseries.empty()) {
+    timeseries.open(o.timeseries);
+    if (!timeseries) {
+      std::cerr << "cannot write " << o.timeseries << "\n";
+      return 1;
+    }
+    timeseries << "map,threads,window_start_ms,ops,ops_per_sec\n";
+  }
+  std::vector<Result> results;
+  for (const std::string &name : o.maps) {
+    const MapType &type = *findMapType(name);
+    for (int threads : o.threads) {
+      if (threads > 1 && !type.concurrent) {
+        std::cerr << name << " is single threaded, skipped at " << threads
+                  << " threads.\n";
+        continue;
+      }
+      results.push_back(run(o, type, threads, cdf));
+      if (o.format == "text") {
+        printText(o, results.back());
+      } else if (o.format == "csv") {
+        printCsv(o, results.back());
+      }
+      if (timeseries.is_open()) {
+        writeTimeseries(timeseries, results.back());
+      }
+    }
+  }
+  if (o.format == "json") {
+    printJson(o, results);
+  }
+  return 0;
+}
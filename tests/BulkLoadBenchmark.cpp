@@ -0,0 +1,91 @@
+#include "../src/ChainHashMapRehashOpenMp.h"
+#include "../src/ThreadSafeChainHashMap.h"
+#include "KeyFile.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Building a map from scratch: the keys of testdata/insert.txt are inserted
+ * once with insert() on every hardware thread, like test_insert, and once
+ * with bulkLoad() on as many threads, for ThreadSafeChainHashMap and for a
+ * ChainHashMapRehashOpenMp starting with 16 buckets.
+ */
+std::vector<std::string_view> keys;
+
+double millis(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Insert all keys on every hardware thread, returns the time in ms.
+template <typename Map> double insertAll(Map &h) {
+  const int N = keys.size();
+  const int cores = std::thread::hardware_concurrency();
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < cores; ++c) {
+    threads.push_back(std::thread([&h, c, cores, N]() {
+      for (int i = c * (N / cores);
+           i < (c == cores - 1 ? N : (c + 1) * (N / cores)); ++i) {
+        h.insert(keys[i]);
+      }
+    }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  return millis(start);
+}
+
+// Bulk load all keys on every hardware thread, returns the time in ms.
+template <typename Map> double bulkLoadAll(Map &h) {
+  const auto start = std::chrono::steady_clock::now();
+  h.bulkLoad(keys.data(), keys.size(), std::thread::hardware_concurrency());
+  return millis(start);
+}
+
+template <typename Map> void check(const Map &h) {
+  assert(h.size() == int(keys.size()));
+  for (std::string_view key : keys) {
+    assert(h.search(key));
+  }
+}
+
+template <typename Map, typename Make>
+void benchmark(const std::string &name, Make make) {
+  Map *inserted = make();
+  const double insert = insertAll(*inserted);
+  check(*inserted);
+  delete inserted;
+
+  Map *loaded = make();
+  const double load = bulkLoadAll(*loaded);
+  check(*loaded);
+  delete loaded;
+
+  std::cout << name << ": insert " << insert << " ms, bulk load " << load
+            << " ms (" << insert / load << "x).\n";
+}
+
+int main() {
+  KeyFile insertFile("testdata/insert");
+  for (size_t i = 0; i < insertFile.size(); ++i) {
+    if (insertFile.flag(i)) {
+      keys.push_back(insertFile.key(i));
+    }
+  }
+
+  std::cout << keys.size() << " keys, " << std::thread::hardware_concurrency()
+            << " threads.\n";
+  benchmark<ThreadSafeChainHashMap>(
+      "ThreadSafeChainHashMap", []() { return new ThreadSafeChainHashMap(); });
+  benchmark<ChainHashMapRehashOpenMp>("ChainHashMapRehashOpenMp", []() {
+    return new ChainHashMapRehashOpenMp(0.8, 16, 16);
+  });
+  return 0;
+}
@@ -1,6 +1,9 @@
 #include "../src/ChainHashMapRehashThreads.h"
+#include "AllocationCounter.h"
+#include "KeyFile.h"
+#include "LatencyRecorder.h"
 #include <cassert>
-#include <fstream>
+#include <cstring>
 #include <iostream>
 #include <thread>
 
@@ -8,47 +11,73 @@
  * A multi-threaded test application to test multi-threaded thread-safe
  * ChainHashMapRehashThreads.
  */
-std::vector<std::pair<std::string, bool>> tests;
+std::vector<std::pair<std::string_view, bool>> tests;
 
 void test_insert(int start, int n, ChainHashMapRehashThreads &h) {
+  LatencyRecorder::Thread recorder;
   for (int i = start; i <= n + start - 1; ++i) {
     if (tests[i].second) {
+      const uint64_t t = recorder.begin();
       assert(h.insert(tests[i].first));
+      recorder.end(t);
     }
   }
 }
 
 void test_search(int start, int n, ChainHashMapRehashThreads &h) {
+  LatencyRecorder::Thread recorder;
   for (int i = start; i <= n + start - 1; ++i) {
+    const uint64_t t = recorder.begin();
     assert(h.search(tests[i].first) == tests[i].second);
+    recorder.end(t);
   }
 }
 
 void test_remove(int start, int n, ChainHashMapRehashThreads &h) {
+  LatencyRecorder::Thread recorder;
   for (int i = start; i <= n + start - 1; ++i) {
+    const uint64_t t = recorder.begin();
     assert(h.remove(tests[i].first) == tests[i].second);
+    recorder.end(t);
   }
 }
 
 int main(int argc, char *argv[]) {
   ChainHashMapRehashThreads h(0.8, 5000, 500000);
-  std::string s;
-  bool toInsert;
+  // Pass "noshrink" to keep the table sized for the peak after deletions,
+  // and "stats" to print the chain lengths, lock contention and resizes
+  // after insertion and deletion.
+  bool stats = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "noshrink") == 0) {
+      h.setAutoShrink(false);
+    }
+    stats = stats || std::strcmp(argv[i], "stats") == 0;
+  }
+  h.collectStats(stats);
   std::chrono::high_resolution_clock::time_point start, end;
   std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
+  // Pass "latency" for per-operation latency percentiles and "timeseries"
+  // for the operations completed per 10 ms window.
+  const bool latency = LatencyRecorder::requested(argc, argv);
   int cores = std::thread::hardware_concurrency();
   std::vector<std::thread> threads;
 
   // Test insertion.
-  std::ifstream insertFile("testdata/insert.txt");
-  while (insertFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  insertFile.close();
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.tests();
 
   const int N = tests.size();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  if (latency) {
+    LatencyRecorder::start();
+  }
   int p = 0;
   for (int i = 1; i <= cores - 1; ++i) {
     threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
@@ -64,25 +93,39 @@ int main(int argc, char *argv[]) {
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
   std::cout << "Insertion time: " << time.count() << " ms.\n";
+  if (latency) {
+    LatencyRecorder::report("Insertion");
+  }
+  if (stats) {
+    h.dumpStats();
+  }
 
   // Test search.
   tests.clear();
   threads.clear();
-  std::ifstream searchFile("testdata/search.txt");
-  while (searchFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  searchFile.close();
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.tests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  if (latency) {
+    LatencyRecorder::start();
+  }
   p = 0;
   for (int i = 1; i <= cores - 1; ++i) {
-    threads.push_back(std::thread(test_search, p, N / cores, std::ref(h)));
-    p += N / cores;
+    threads.push_back(std::thread(test_search, p, S / cores, std::ref(h)));
+    p += S / cores;
   }
   threads.push_back(
-      std::thread(test_search, p, N / cores + N % cores, std::ref(h)));
+      std::thread(test_search, p, S / cores + S % cores, std::ref(h)));
   for (auto &t : threads) {
     t.join();
   }
@@ -90,18 +133,27 @@ int main(int argc, char *argv[]) {
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
   std::cout << "Search time: " << time.count() << " ms.\n";
+  if (latency) {
+    LatencyRecorder::report("Search");
+  }
 
   // Test deletion.
   tests.clear();
   threads.clear();
-  std::ifstream deletionFile("testdata/delete.txt");
-  while (deletionFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  deletionFile.close();
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.tests();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  if (latency) {
+    LatencyRecorder::start();
+  }
   p = 0;
   for (int i = 1; i <= cores - 1; ++i) {
     threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
@@ -116,6 +168,44 @@ int main(int argc, char *argv[]) {
   end = std::chrono::high_resolution_clock::now();
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
   std::cout << "Deletion time: " << time.count() << " ms.\n";
+  if (latency) {
+    LatencyRecorder::report("Deletion");
+  }
+  std::cout << "Buckets after deletion: " << h.getBuckets() << ", RSS "
+            << AllocationCounter::residentBytes() / (1 << 20) << " MB.\n";
+  if (stats) {
+    h.dumpStats();
+  }
+
+  // Test search after deletion, on the table the deletions left behind.
+  threads.clear();
+  for (auto &test : tests) {
+    test.second = false;
+  }
+  start = std::chrono::high_resolution_clock::now();
+  if (latency) {
+    LatencyRecorder::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_search, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_search, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  end = std::chrono::high_resolution_clock::now();
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  std::cout << "Search after deletion time: " << time.count() << " ms.\n";
+  if (latency) {
+    LatencyRecorder::report("Search after deletion");
+  }
   return 0;
 }
\ No newline at end of file
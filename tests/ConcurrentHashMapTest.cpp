@@ -0,0 +1,200 @@
+#include "../src/ConcurrentHashMap.h"
+#include "AllocationCounter.h"
+#include "KeyFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+/**
+ * A multi-threaded test application to test ConcurrentHashMap as a key to
+ * value map; every key maps to its length.
+ */
+std::vector<std::pair<std::string_view, bool>> tests;
+
+void test_insert(int start, int n, ConcurrentHashMap<std::string, int> &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    if (tests[i].second) {
+      const int length = tests[i].first.size();
+      assert(h.emplace(std::string(tests[i].first), length));
+    }
+  }
+}
+
+void test_search(int start, int n, ConcurrentHashMap<std::string, int> &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    std::optional<int> value = h.find(tests[i].first);
+    assert(value.has_value() == tests[i].second);
+    assert(!value || *value == int(tests[i].first.size()));
+  }
+}
+
+void test_remove(int start, int n, ConcurrentHashMap<std::string, int> &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.erase(tests[i].first) == tests[i].second);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  ConcurrentHashMap<std::string, int> h;
+  std::chrono::high_resolution_clock::time_point start, end;
+  std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
+  int cores = std::thread::hardware_concurrency();
+  std::vector<std::thread> threads;
+
+  // Test insertion.
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.tests();
+
+  const int N = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  int p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_insert, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == N / 2);
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
+  std::cout << "Insertion time: " << time.count() << " ms.\n";
+
+  // Test search.
+  tests.clear();
+  threads.clear();
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.tests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_search, p, S / cores, std::ref(h)));
+    p += S / cores;
+  }
+  threads.push_back(
+      std::thread(test_search, p, S / cores + S % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
+  std::cout << "Search time: " << time.count() << " ms.\n";
+
+  // Test deletion.
+  tests.clear();
+  threads.clear();
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.tests();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_remove, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == 0);
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
+  std::cout << "Deletion time: " << time.count() << " ms.\n";
+
+  // Test assignment: insert_or_assign() returns true for a new key and false
+  // when it replaces the value of an existing one, which leaves the size.
+  ConcurrentHashMap<std::string, int> a;
+  const std::string x = "x";
+  assert(a.insert_or_assign(x, 1));
+  assert(!a.insert_or_assign(x, 2));
+  assert(!a.insert_or_assign(std::string("x"), 3));
+  assert(a.insert_or_assign(std::string("y"), 4));
+  assert(a.size() == 2);
+  assert(a.find("x") == 3 && a.find("y") == 4);
+
+  // Assign rounds of values while other threads read: a replaced node is
+  // retired under lock-free readers, which must always find the key with
+  // one of the values it was assigned, never going back to an older one.
+  const int KEYS = 10000, ROUNDS = 50;
+  std::vector<std::string> keys;
+  for (int i = 0; i < KEYS; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    assert(a.emplace(keys[i], 0));
+  }
+  std::atomic<bool> done(false);
+  threads.clear();
+  const int readers = std::max(1, cores / 2);
+  for (int r = 0; r < readers; ++r) {
+    threads.push_back(std::thread([&a, &keys, &done]() {
+      std::vector<int> seen(KEYS, 0);
+      while (!done) {
+        for (int i = 0; i < KEYS; ++i) {
+          std::optional<int> value = a.find(keys[i]);
+          assert(value.has_value());
+          assert(*value >= seen[i] && *value <= ROUNDS);
+          seen[i] = *value;
+        }
+      }
+    }));
+  }
+  std::vector<std::thread> writers;
+  const int W = std::max(1, cores - readers);
+  for (int w = 0; w < W; ++w) {
+    writers.push_back(std::thread([&a, &keys, w, W]() {
+      for (int round = 1; round <= ROUNDS; ++round) {
+        for (int i = w; i < KEYS; i += W) {
+          assert(!a.insert_or_assign(keys[i], round));
+        }
+      }
+    }));
+  }
+  for (auto &t : writers) {
+    t.join();
+  }
+  done = true;
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(a.size() == size_t(KEYS) + 2);
+  for (int i = 0; i < KEYS; ++i) {
+    assert(a.find(keys[i]) == ROUNDS);
+  }
+  std::cout << "Assignment under concurrent reads: ok.\n";
+  return 0;
+}
\ No newline at end of file
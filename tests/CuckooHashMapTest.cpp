@@ -0,0 +1,166 @@
+#include "../src/CuckooHashMap.h"
+#include "AllocationCounter.h"
+#include "KeyFile.h"
+#include <cassert>
+#include <iostream>
+#include <thread>
+
+/**
+ * A multi-threaded test application to test multi-threaded thread-safe
+ * CuckooHashMap.
+ */
+std::vector<std::pair<std::string_view, bool>> tests;
+
+void test_insert(int start, int n, CuckooHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    if (tests[i].second) {
+      assert(h.insert(tests[i].first));
+    }
+  }
+}
+
+void test_search(int start, int n, CuckooHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.search(tests[i].first) == tests[i].second);
+  }
+}
+
+void test_remove(int start, int n, CuckooHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.remove(tests[i].first) == tests[i].second);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  CuckooHashMap h;
+  std::chrono::high_resolution_clock::time_point start, end;
+  std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
+  int cores = std::thread::hardware_concurrency();
+  std::vector<std::thread> threads;
+
+  // Test insertion.
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.tests();
+
+  const int N = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  int p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_insert, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == N / 2);
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
+  std::cout << "Insertion time: " << time.count() << " ms.\n";
+  std::cout << "Load factor: " << h.loadFactor() << ".\n";
+
+  // A key already in the map is not inserted again.
+  for (int i = 0; i < N; ++i) {
+    if (tests[i].second) {
+      assert(!h.insert(tests[i].first));
+      break;
+    }
+  }
+  assert(h.size() == N / 2);
+
+  // Test search.
+  tests.clear();
+  threads.clear();
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.tests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_search, p, S / cores, std::ref(h)));
+    p += S / cores;
+  }
+  threads.push_back(
+      std::thread(test_search, p, S / cores + S % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
+  std::cout << "Search time: " << time.count() << " ms.\n";
+
+  // Test deletion.
+  tests.clear();
+  threads.clear();
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.tests();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_remove, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == 0);
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
+  std::cout << "Deletion time: " << time.count() << " ms.\n";
+
+  // Load factor reached before each growth, starting from 16 buckets.
+  tests = insertFile.tests();
+  CuckooHashMap small(wyHash, 16);
+  int capacity = small.capacity();
+  double before = 0;
+  std::cout << "Load factor before growing:";
+  for (int i = 0; i < N; ++i) {
+    if (tests[i].second) {
+      before = small.loadFactor();
+      assert(small.insert(tests[i].first));
+      if (small.capacity() != capacity) {
+        capacity = small.capacity();
+        std::cout << " " << before;
+      }
+    }
+  }
+  std::cout << ".\n";
+  assert(small.size() == N / 2);
+  for (int i = 0; i < N; ++i) {
+    assert(small.search(tests[i].first) == tests[i].second);
+  }
+  return 0;
+}
\ No newline at end of file
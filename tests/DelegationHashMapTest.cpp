@@ -0,0 +1,164 @@
+#include "../src/DelegationHashMap.h"
+#include "AllocationCounter.h"
+#include "KeyFile.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/**
+ * A multi-threaded test application to test multi-threaded thread-safe
+ * DelegationHashMap. Pass "async" to search through searchAsync futures.
+ */
+std::vector<std::pair<std::string_view, bool>> tests;
+
+void test_insert(int start, int n, DelegationHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    if (tests[i].second) {
+      assert(h.insert(tests[i].first));
+    }
+  }
+}
+
+void test_search(int start, int n, DelegationHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.search(tests[i].first) == tests[i].second);
+  }
+}
+
+// Keep up to WINDOW searches in flight.
+void test_search_async(int start, int n, DelegationHashMap &h) {
+  const int WINDOW = 64;
+  std::vector<std::future<bool>> results;
+  for (int i = start; i <= n + start - 1; i += WINDOW) {
+    const int m = std::min(WINDOW, n + start - i);
+    results.clear();
+    for (int j = i; j < i + m; ++j) {
+      results.push_back(h.searchAsync(tests[j].first));
+    }
+    for (int j = 0; j < m; ++j) {
+      assert(results[j].get() == tests[i + j].second);
+    }
+  }
+}
+
+void test_remove(int start, int n, DelegationHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.remove(tests[i].first) == tests[i].second);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool async = false;
+  for (int i = 1; i < argc; ++i) {
+    async = async || std::strcmp(argv[i], "async") == 0;
+  }
+  // Half of the hardware threads serve, the other half run clients, so that
+  // no side spins on a core the other needs. A single hardware thread has to
+  // run one of each, and the timings then include switching between them.
+  const int hardware = std::max(1, int(std::thread::hardware_concurrency()));
+  const int servers = std::max(1, hardware / 2);
+  DelegationHashMap h(servers);
+  std::chrono::high_resolution_clock::time_point start, end;
+  std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
+  // One client thread per hardware thread left, at least one.
+  int cores = std::max(1, hardware - servers);
+  std::vector<std::thread> threads;
+
+  // Test insertion.
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.tests();
+
+  const int N = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  int p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_insert, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == N / 2);
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
+  std::cout << "Insertion time: " << time.count() << " ms.\n";
+
+  // Test search.
+  tests.clear();
+  threads.clear();
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.tests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  auto search = async ? test_search_async : test_search;
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(search, p, S / cores, std::ref(h)));
+    p += S / cores;
+  }
+  threads.push_back(
+      std::thread(search, p, S / cores + S % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
+  std::cout << "Search time: " << time.count() << " ms.\n";
+
+  // Test deletion.
+  tests.clear();
+  threads.clear();
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.tests();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_remove, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == 0);
+  end = std::chrono::high_resolution_clock::now();
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
+  std::cout << "Deletion time: " << time.count() << " ms.\n";
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "../src/Hasher.h"
+#include "../src/MapStats.h"
+#include "KeyFile.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * A single threaded micro benchmark comparing the hash functions on the keys
+ * of testdata/insert.txt: time per key, and how evenly the keys spread over
+ * 1024 * 1024 buckets when the index is a power-of-two mask. A chi-square/df
+ * near 1 means the keys spread like a random function would spread them.
+ */
+const int PASSES = 10;
+const int BUCKETS = 1024 * 1024;
+
+void benchmark(const std::string &name, Hasher hasher,
+               const std::vector<std::string_view> &keys) {
+  std::chrono::high_resolution_clock::time_point start, end;
+  std::chrono::duration<double, std::nano> time;
+
+  // Keep the results alive so the hashing can't be optimized away.
+  uint64_t sink = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for (int pass = 0; pass < PASSES; ++pass) {
+    for (std::string_view key : keys) {
+      sink += hasher(key);
+    }
+  }
+  end = std::chrono::high_resolution_clock::now();
+  time = end - start;
+
+  std::vector<int> buckets(BUCKETS);
+  for (std::string_view key : keys) {
+    ++buckets[hasher(key) & (BUCKETS - 1)];
+  }
+  MapStats stats;
+  for (int n : buckets) {
+    stats.addBucket(n);
+  }
+
+  std::cout << name << ": " << time.count() / (PASSES * keys.size())
+            << " ns/key, max bucket " << stats.maxChain() << ", empty buckets "
+            << 100 * stats.emptyRatio() << "%, chi-square/df "
+            << stats.chiSquareRatio() << " (checksum " << sink % 10 << ").\n";
+}
+
+int main(int argc, char *argv[]) {
+  KeyFile insertFile("testdata/insert");
+  std::vector<std::string_view> keys;
+  for (size_t i = 0; i < insertFile.size(); ++i) {
+    keys.push_back(insertFile.key(i));
+  }
+
+  std::cout << keys.size() << " keys, " << BUCKETS << " buckets.\n";
+  benchmark("polynomial", polynomialHash, keys);
+  benchmark("fnv1a", fnv1aHash, keys);
+  benchmark("wyhash", wyHash, keys);
+  return 0;
+}
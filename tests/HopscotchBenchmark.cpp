@@ -0,0 +1,80 @@
+#include "../src/HopscotchHashMap.h"
+#include "../src/ThreadSafeChainHashMap.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Compares HopscotchHashMap with ThreadSafeChainHashMap as they fill up.
+ * Both have 2^20 buckets; for each load factor from 0.5 to 0.95 that many
+ * keys per bucket are inserted on every hardware thread, then searched for
+ * once (hits) along with as many keys which are absent (misses). Generated
+ * keys are used, as testdata/insert.txt holds too few for the highest loads.
+ */
+const int BUCKETS = 1024 * 1024;
+
+std::vector<std::string> present, absent;
+
+double millis(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Run f(i) for i in [0, n) on every hardware thread, returns the time in
+// nanoseconds per call.
+template <typename F> double perKey(int n, F f) {
+  const int cores = std::thread::hardware_concurrency();
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < cores; ++c) {
+    threads.push_back(std::thread([&f, c, cores, n]() {
+      for (int i = c * (n / cores);
+           i < (c == cores - 1 ? n : (c + 1) * (n / cores)); ++i) {
+        f(i);
+      }
+    }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  return millis(start) * 1e6 / n;
+}
+
+template <typename Map> void benchmark(const std::string &name, Map &h, int n) {
+  const double insert =
+      perKey(n, [&h](int i) { assert(h.insert(present[i])); });
+  assert(h.size() == n);
+  const double hit = perKey(n, [&h](int i) { assert(h.search(present[i])); });
+  const double miss = perKey(n, [&h](int i) { assert(!h.search(absent[i])); });
+  std::cout << "  " << name << ": insert " << insert << " ns, hit " << hit
+            << " ns, miss " << miss << " ns";
+}
+
+int main() {
+  const std::vector<double> loads = {0.5, 0.6, 0.7, 0.8, 0.9, 0.95};
+  const int N = loads.back() * BUCKETS;
+  for (int i = 0; i < N; ++i) {
+    present.push_back("key" + std::to_string(i));
+    absent.push_back("absent" + std::to_string(i));
+  }
+
+  std::cout << BUCKETS << " buckets, " << std::thread::hardware_concurrency()
+            << " threads, per key.\n";
+  for (double load : loads) {
+    const int n = load * BUCKETS;
+    std::cout << "Load factor " << load << ":\n";
+    ThreadSafeChainHashMap chained;
+    benchmark("ThreadSafeChainHashMap", chained, n);
+    std::cout << ".\n";
+    HopscotchHashMap hopscotch(wyHash, BUCKETS);
+    benchmark("HopscotchHashMap", hopscotch, n);
+    const MapStats stats = hopscotch.stats();
+    std::cout << ", at most " << stats.maxChain() << " keys per home, "
+              << stats.rehashes << " growths.\n";
+  }
+  return 0;
+}
@@ -0,0 +1,202 @@
+#ifndef KEY_FILE_H
+#define KEY_FILE_H
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Layout of a binary key file, written by testdata/generate_data.cpp:
+ *
+ *   KeyFileHeader
+ *   uint64_t offsets[count + 1]   key i is bytes [offsets[i], offsets[i + 1])
+ *   uint64_t flags[(count + 63) / 64]   bit i % 64 of word i / 64 is flag i
+ *   char bytes[keyBytes]          the keys, back to back
+ *
+ * All integers are little endian, the sections are 8-byte aligned.
+ */
+struct KeyFileHeader {
+  static constexpr char MAGIC[8] = {'H', 'M', 'K', 'E', 'Y', 'S', '1', '\n'};
+
+  char magic[8];
+  uint64_t count;
+  uint64_t keyBytes;
+  uint64_t reserved;
+
+  // Offsets of the sections, in bytes from the start of the file.
+  static uint64_t offsetsStart() { return sizeof(KeyFileHeader); }
+  static uint64_t flagsStart(uint64_t count) {
+    return offsetsStart() + (count + 1) * 8;
+  }
+  static uint64_t bytesStart(uint64_t count) {
+    return flagsStart(count) + (count + 63) / 64 * 8;
+  }
+};
+
+/**
+ * The keys and flags of one test data file, e.g. KeyFile("testdata/insert").
+ *
+ * name.bin is mapped read-only, so opening it costs no parsing and no copies
+ * and key(i) points into the mapping. Without name.bin, name.txt ("key flag"
+ * lines) is read into memory instead.
+ */
+class KeyFile {
+
+public:
+  // Constructor, opens name.bin or else name.txt.
+  explicit KeyFile(const std::string &name) {
+    if (!openBinary(name + ".bin")) {
+      readText(name + ".txt");
+    }
+  }
+
+  // Number of keys.
+  size_t size() const { return count; }
+
+  // Key i.
+  std::string_view key(size_t i) const {
+    if (map == nullptr) {
+      return textKeys[i];
+    }
+    return std::string_view(bytes + offsets[i], offsets[i + 1] - offsets[i]);
+  }
+
+  // Flag of key i, whether it is inserted.
+  bool flag(size_t i) const {
+    return map == nullptr ? textFlags[i] : flags[i / 64] >> (i % 64) & 1;
+  }
+
+  // The (key, flag) pairs of the test applications, pointing into the file.
+  std::vector<std::pair<std::string_view, bool>> tests() const {
+    std::vector<std::pair<std::string_view, bool>> pairs(count);
+    for (size_t i = 0; i < count; ++i) {
+      pairs[i] = {key(i), flag(i)};
+    }
+    return pairs;
+  }
+
+  // The same pairs with keys copied into std::strings, for the
+  // std::unordered_set baselines, whose lookups take const std::string &.
+  std::vector<std::pair<std::string, bool>> stringTests() const {
+    std::vector<std::pair<std::string, bool>> pairs(count);
+    for (size_t i = 0; i < count; ++i) {
+      pairs[i] = {std::string(key(i)), flag(i)};
+    }
+    return pairs;
+  }
+
+  // Whether the file is a mapped binary file.
+  bool mapped() const { return map != nullptr; }
+
+  // Destructor, unmaps the file.
+  ~KeyFile() {
+    if (map != nullptr) {
+      munmap(map, length);
+    }
+  }
+
+  KeyFile(const KeyFile &) = delete;
+  KeyFile &operator=(const KeyFile &) = delete;
+
+private:
+  size_t count = 0;
+
+  // The mapping of a binary file.
+  void *map = nullptr;
+  size_t length = 0;
+  const uint64_t *offsets = nullptr;
+  const uint64_t *flags = nullptr;
+  const char *bytes = nullptr;
+
+  // The contents of a text file.
+  std::string text;
+  std::vector<std::string_view> textKeys;
+  std::vector<bool> textFlags;
+
+  bool openBinary(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(KeyFileHeader)) {
+      ::close(fd);
+      std::__throw_runtime_error("KeyFile: truncated binary file.");
+    }
+    length = st.st_size;
+#ifdef MAP_POPULATE
+    // Fault the pages in now rather than in the timed phases.
+    const int mapFlags = MAP_PRIVATE | MAP_POPULATE;
+#else
+    const int mapFlags = MAP_PRIVATE;
+#endif
+    map = mmap(nullptr, length, PROT_READ, mapFlags, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+      map = nullptr;
+      std::__throw_runtime_error("KeyFile: cannot map binary file.");
+    }
+    const char *base = static_cast<const char *>(map);
+    const KeyFileHeader *header = reinterpret_cast<const KeyFileHeader *>(base);
+    // The count bound keeps bytesStart() from overflowing, and the tables
+    // must fit before keyBytes is compared with what is left.
+    const uint64_t tablesEnd = KeyFileHeader::bytesStart(header->count);
+    if (std::memcmp(header->magic, KeyFileHeader::MAGIC, 8) != 0 ||
+        header->count > length / 8 || tablesEnd > length ||
+        header->keyBytes != length - tablesEnd) {
+      munmap(map, length);
+      map = nullptr;
+      std::__throw_runtime_error("KeyFile: not a key file.");
+    }
+    count = header->count;
+    offsets = reinterpret_cast<const uint64_t *>(
+        base + KeyFileHeader::offsetsStart());
+    // key(i) trusts the offsets, check that they cut the key bytes exactly.
+    bool valid = offsets[0] == 0 && offsets[count] == header->keyBytes;
+    for (size_t i = 0; i < count && valid; ++i) {
+      valid = offsets[i] <= offsets[i + 1];
+    }
+    if (!valid) {
+      munmap(map, length);
+      map = nullptr;
+      std::__throw_runtime_error("KeyFile: corrupt key offsets.");
+    }
+    flags = reinterpret_cast<const uint64_t *>(
+        base + KeyFileHeader::flagsStart(count));
+    bytes = base + KeyFileHeader::bytesStart(count);
+    return true;
+  }
+
+  void readText(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      std::__throw_runtime_error("KeyFile: cannot open test data.");
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    text = contents.str();
+    // Lines are "key flag".
+    size_t p = 0;
+    while (p < text.size()) {
+      const size_t space = text.find(' ', p);
+      const size_t end = text.find('\n', p);
+      if (space == std::string::npos || space > end) {
+        break;
+      }
+      textKeys.push_back(std::string_view(text).substr(p, space - p));
+      textFlags.push_back(text[space + 1] == '1');
+      p = end == std::string::npos ? text.size() : end + 1;
+    }
+    count = textKeys.size();
+  }
+};
+#endif // KEY_FILE_H
@@ -0,0 +1,225 @@
+#ifndef LATENCY_RECORDER_H
+#define LATENCY_RECORDER_H
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+/**
+ * A histogram of latencies in nanoseconds with logarithmic buckets, each
+ * power of two split into 2^(SUB_BITS - 1) linear sub-buckets (HDR histogram
+ * style). Values below 2^SUB_BITS are exact; larger ones are off by at most
+ * 2^-(SUB_BITS - 1), under 1.6%. Recording is an index computation and an
+ * increment, so every thread keeps its own histogram and they are merged
+ * once the threads are done.
+ */
+class LatencyHistogram {
+
+public:
+  static const int SUB_BITS = 7;
+
+  // Constructor.
+  LatencyHistogram() : counts(BUCKETS) {}
+
+  // Record one latency.
+  void record(uint64_t ns) {
+    ++counts[index(ns)];
+    ++total;
+    largest = std::max(largest, ns);
+  }
+
+  // Add the latencies of another histogram.
+  void merge(const LatencyHistogram &other) {
+    for (int i = 0; i < BUCKETS; ++i) {
+      counts[i] += other.counts[i];
+    }
+    total += other.total;
+    largest = std::max(largest, other.largest);
+  }
+
+  // Number of latencies recorded.
+  uint64_t count() const { return total; }
+
+  // Largest latency recorded.
+  uint64_t max() const { return largest; }
+
+  // Latency below or at which a fraction p of the latencies fall, as the
+  // upper end of its bucket.
+  uint64_t percentile(double p) const {
+    const uint64_t rank = std::max<uint64_t>(1, uint64_t(p * total + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(highest(i), largest);
+      }
+    }
+    return largest;
+  }
+
+  void clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = largest = 0;
+  }
+
+private:
+  static const int HALF = 1 << (SUB_BITS - 1);
+  static const int BUCKETS = (64 - SUB_BITS + 2) * HALF;
+
+  std::vector<uint64_t> counts;
+  uint64_t total = 0;
+  uint64_t largest = 0;
+
+  static int index(uint64_t v) {
+    if (v < (1ULL << SUB_BITS)) {
+      return v;
+    }
+    const int magnitude = 64 - __builtin_clzll(v) - SUB_BITS;
+    return magnitude * HALF + int(v >> magnitude);
+  }
+
+  static uint64_t highest(int i) {
+    if (i < (1 << SUB_BITS)) {
+      return i;
+    }
+    const int magnitude = i / HALF - 1;
+    return ((uint64_t(i - magnitude * HALF) + 1) << magnitude) - 1;
+  }
+};
+
+/**
+ * Operations completed per WINDOW of a phase, to show pauses such as
+ * resizes that totals and percentiles hide.
+ */
+class ThroughputSeries {
+
+public:
+  static constexpr uint64_t WINDOW_NS = 10 * 1000 * 1000;
+
+  // Record an operation completed at time ns of the phase.
+  void record(uint64_t ns) {
+    const size_t w = ns / WINDOW_NS;
+    if (w >= windows.size()) {
+      windows.resize(w + 1);
+    }
+    ++windows[w];
+  }
+
+  // Add the operations of another series.
+  void merge(const ThroughputSeries &other) {
+    if (other.windows.size() > windows.size()) {
+      windows.resize(other.windows.size());
+    }
+    for (size_t w = 0; w < other.windows.size(); ++w) {
+      windows[w] += other.windows[w];
+    }
+  }
+
+  // Operations completed in each window.
+  const std::vector<uint64_t> &counts() const { return windows; }
+
+  void clear() { windows.clear(); }
+
+private:
+  std::vector<uint64_t> windows;
+};
+
+/**
+ * Per-operation latencies and throughput over time for the "latency" and
+ * "timeseries" modes of the test applications. Each worker thread records
+ * into a LatencyRecorder::Thread, which merges into the phase totals when
+ * it goes out of scope.
+ */
+namespace LatencyRecorder {
+
+inline bool latency = false;
+inline bool timeseries = false;
+inline std::chrono::steady_clock::time_point phaseStart;
+inline LatencyHistogram histogram;
+inline ThroughputSeries series;
+inline std::mutex mtx;
+
+// Nanoseconds since the start of the phase.
+inline uint64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - phaseStart)
+      .count();
+}
+
+// Whether "latency" or "timeseries" was passed on the command line, and
+// turn the modes on.
+inline bool requested(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    latency = latency || std::strcmp(argv[i], "latency") == 0;
+    timeseries = timeseries || std::strcmp(argv[i], "timeseries") == 0;
+  }
+  return latency || timeseries;
+}
+
+// Start a phase.
+inline void start() {
+  histogram.clear();
+  series.clear();
+  phaseStart = std::chrono::steady_clock::now();
+}
+
+// Print the latency percentiles and the throughput windows of a phase.
+inline void report(const char *phase) {
+  if (latency) {
+    std::cout << phase << " latency: p50 " << histogram.percentile(0.5)
+              << " ns, p99 " << histogram.percentile(0.99) << " ns, p99.9 "
+              << histogram.percentile(0.999) << " ns, max " << histogram.max()
+              << " ns.\n";
+  }
+  if (timeseries) {
+    std::cout << phase << " operations per "
+              << ThroughputSeries::WINDOW_NS / 1000000 << " ms:";
+    for (uint64_t ops : series.counts()) {
+      std::cout << " " << ops;
+    }
+    std::cout << "\n";
+  }
+}
+
+/**
+ * The recording of one worker thread.
+ */
+class Thread {
+
+public:
+  // Time before an operation, 0 if nothing is recorded.
+  uint64_t begin() const { return latency ? now() : 0; }
+
+  // Record an operation which began at time t.
+  void end(uint64_t t) {
+    if (!latency && !timeseries) {
+      return;
+    }
+    const uint64_t done = now();
+    if (latency) {
+      histogram.record(done - t);
+    }
+    if (timeseries) {
+      series.record(done);
+    }
+  }
+
+  // Destructor, merges into the phase totals.
+  ~Thread() {
+    if (latency || timeseries) {
+      std::lock_guard<std::mutex> lk(mtx);
+      LatencyRecorder::histogram.merge(histogram);
+      LatencyRecorder::series.merge(series);
+    }
+  }
+
+private:
+  LatencyHistogram histogram;
+  ThroughputSeries series;
+};
+
+} // namespace LatencyRecorder
+#endif // LATENCY_RECORDER_H
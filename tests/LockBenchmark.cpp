@@ -0,0 +1,104 @@
+#include "../src/ThreadSafeChainHashMap.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A multi-threaded benchmark of ThreadSafeChainHashMap's bucket locks under
+ * skewed keys. Every thread draws keys from a Zipf distribution over KEYS
+ * keys for SECONDS seconds; half of its operations are searches and half are
+ * an insert immediately followed by a remove of the same key. Prints the
+ * throughput and how evenly the operations were spread over the threads
+ * (min/max ratio and Jain's fairness index, 1 is perfectly fair).
+ */
+const int KEYS = 1024;
+const double ZIPF_EXPONENT = 1.2;
+const double SECONDS = 1;
+const int SAMPLES = 1 << 16;
+
+std::vector<std::string> keys;
+
+// Key indices drawn from the Zipf distribution, one sequence per thread.
+std::vector<int> zipfSamples(int seed) {
+  std::vector<double> cdf(KEYS);
+  double sum = 0;
+  for (int i = 0; i < KEYS; ++i) {
+    sum += 1 / std::pow(i + 1, ZIPF_EXPONENT);
+    cdf[i] = sum;
+  }
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(0, sum);
+  std::vector<int> samples(SAMPLES);
+  for (int &s : samples) {
+    s = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+  }
+  return samples;
+}
+
+void worker(ThreadSafeChainHashMap &h, const std::vector<int> &samples,
+            const std::atomic<bool> &stop, long &ops) {
+  long done = 0;
+  for (int i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+    const std::string &key = keys[samples[i & (SAMPLES - 1)]];
+    if (i & 1) {
+      h.search(key);
+      ++done;
+    } else {
+      h.insert(key);
+      h.remove(key);
+      done += 2;
+    }
+  }
+  ops = done;
+}
+
+void benchmark(const std::string &name, LockStripes::Kind kind, int threads) {
+  ThreadSafeChainHashMap h(wyHash, kind);
+  std::vector<std::vector<int>> samples;
+  for (int t = 0; t < threads; ++t) {
+    samples.push_back(zipfSamples(t + 1));
+  }
+  std::vector<long> ops(threads);
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread(worker, std::ref(h), std::cref(samples[t]),
+                                  std::cref(stop), std::ref(ops[t])));
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(SECONDS));
+  stop = true;
+  for (auto &t : workers) {
+    t.join();
+  }
+
+  double total = 0, squares = 0;
+  for (long o : ops) {
+    total += o;
+    squares += double(o) * o;
+  }
+  const long fewest = *std::min_element(ops.begin(), ops.end());
+  const long most = *std::max_element(ops.begin(), ops.end());
+  std::cout << name << ": " << total / SECONDS / 1e6 << " Mops/s, min/max "
+            << double(fewest) / most << ", Jain "
+            << total * total / (threads * squares) << ".\n";
+}
+
+int main(int argc, char *argv[]) {
+  for (int i = 0; i < KEYS; ++i) {
+    keys.push_back("key" + std::to_string(i));
+  }
+  const int threads =
+      std::max(4, int(std::thread::hardware_concurrency()));
+  std::cout << threads << " threads, " << KEYS << " keys, Zipf exponent "
+            << ZIPF_EXPONENT << ".\n";
+  benchmark("mutex", LockStripes::MUTEX, threads);
+  benchmark("spinlock", LockStripes::SPINLOCK, threads);
+  benchmark("mcs", LockStripes::MCS, threads);
+  return 0;
+}
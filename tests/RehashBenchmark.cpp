@@ -0,0 +1,63 @@
+#include "../src/ChainHashMapRehashThreads.h"
+#include "KeyFile.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/**
+ * A multi-threaded insertion benchmark dominated by rehashing: the keys of
+ * testdata/insert.txt are inserted into a ChainHashMapRehashThreads which
+ * starts with 16 buckets, so it doubles about 16 times on the way. Prints
+ * the best insertion time over ROUNDS rounds.
+ */
+const int ROUNDS = 5;
+
+std::vector<std::string_view> keys;
+
+void insert(int start, int n, ChainHashMapRehashThreads &h) {
+  for (int i = start; i < start + n; ++i) {
+    h.insert(keys[i]);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  KeyFile insertFile("testdata/insert");
+  for (size_t i = 0; i < insertFile.size(); ++i) {
+    if (insertFile.flag(i)) {
+      keys.push_back(insertFile.key(i));
+    }
+  }
+
+  const int N = keys.size();
+  const int cores = std::thread::hardware_concurrency();
+  double best = 0;
+  int buckets = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    ChainHashMapRehashThreads h(0.8, 16, 16);
+    std::vector<std::thread> threads;
+    std::chrono::high_resolution_clock::time_point start, end;
+    start = std::chrono::high_resolution_clock::now();
+    int p = 0;
+    for (int i = 1; i <= cores - 1; ++i) {
+      threads.push_back(std::thread(insert, p, N / cores, std::ref(h)));
+      p += N / cores;
+    }
+    threads.push_back(
+        std::thread(insert, p, N / cores + N % cores, std::ref(h)));
+    for (auto &t : threads) {
+      t.join();
+    }
+    end = std::chrono::high_resolution_clock::now();
+    assert(h.size() == N);
+    const double time =
+        std::chrono::duration<double, std::milli>(end - start).count();
+    best = round == 0 ? time : std::min(best, time);
+    buckets = h.getBuckets();
+  }
+  std::cout << N << " keys, 16 -> " << buckets
+            << " buckets, best insertion time: " << best << " ms.\n";
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "../src/ChainHashMapRehashOpenMp.h"
+#include "KeyFile.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Scans a ChainHashMapRehashOpenMp holding the keys of testdata/insert.txt
+ * with parallel_for_each() on every hardware thread, first alone and then
+ * while writer threads keep inserting and removing other keys, growing and
+ * shrinking the table under the scan. Every scan must visit each of the
+ * stable keys exactly once; writer keys start with a tab, which the
+ * alphabets of generate_data.out never hold.
+ */
+std::vector<std::string_view> keys;
+
+struct Scan {
+  double ms;
+  uint64_t stable;
+  uint64_t bytes;
+};
+
+Scan scan(const ChainHashMapRehashOpenMp &h, int threads) {
+  std::atomic<uint64_t> stable(0), bytes(0);
+  const auto start = std::chrono::steady_clock::now();
+  h.parallel_for_each(
+      [&](std::string_view key) {
+        if (key[0] != '\t') {
+          stable.fetch_add(1, std::memory_order_relaxed);
+        }
+        bytes.fetch_add(key.size(), std::memory_order_relaxed);
+      },
+      threads);
+  return {std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - start)
+              .count(),
+          stable, bytes};
+}
+
+void print(const std::string &name, const Scan &s) {
+  std::cout << name << ": " << s.ms << " ms, " << s.stable / s.ms / 1000
+            << " M stable keys/s, " << s.bytes / s.ms / 1000
+            << " MB/s of keys.\n";
+}
+
+int main() {
+  KeyFile insertFile("testdata/insert");
+  for (size_t i = 0; i < insertFile.size(); ++i) {
+    if (insertFile.flag(i)) {
+      keys.push_back(insertFile.key(i));
+    }
+  }
+  const int cores = std::thread::hardware_concurrency();
+  ChainHashMapRehashOpenMp h(0.8, 16, 16, ChainHashMapRehashOpenMp::COOPERATIVE);
+  h.bulkLoad(keys.data(), keys.size(), cores);
+  std::cout << keys.size() << " keys, " << cores << " threads.\n";
+
+  const Scan quiet = scan(h, cores);
+  assert(quiet.stable == keys.size());
+  print("Scan", quiet);
+
+  // Writers insert and remove waves of keys as large as the stable set, so
+  // the table doubles and halves while the scans run.
+  std::atomic<bool> done(false);
+  std::vector<std::thread> writers;
+  const int W = std::max(1, cores / 2);
+  for (int w = 0; w < W; ++w) {
+    writers.push_back(std::thread([&h, &done, w, W]() {
+      const int n = keys.size() / W;
+      while (!done) {
+        for (int i = 0; i < n && !done; ++i) {
+          h.insert("\t" + std::to_string(w) + ":" + std::to_string(i));
+        }
+        for (int i = 0; i < n; ++i) {
+          h.remove("\t" + std::to_string(w) + ":" + std::to_string(i));
+        }
+      }
+    }));
+  }
+  Scan busy = {0, 0, 0};
+  const int SCANS = 10;
+  for (int i = 0; i < SCANS; ++i) {
+    const Scan s = scan(h, cores);
+    assert(s.stable == keys.size());
+    busy.ms += s.ms;
+    busy.stable += s.stable;
+    busy.bytes += s.bytes;
+  }
+  done = true;
+  for (auto &t : writers) {
+    t.join();
+  }
+  print("Scan with " + std::to_string(W) + " writers", busy);
+  std::cout << "Resizes during the run: " << h.stats().rehashes << ".\n";
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "../src/ChainHashMapRehashThreads.h"
+#include "../src/ThreadSafeChainHashMap.h"
+#include "KeyFile.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+/**
+ * A restart benchmark: the keys of testdata/insert.txt are inserted into a
+ * map on every hardware thread, the map is saved to a snapshot file, and a
+ * new map is filled once by inserting the keys again and once by loading the
+ * snapshot. Pass the path of the snapshot file, snapshot.bin by default; it
+ * is removed afterwards.
+ *
+ * The snapshot is read back from the page cache. For a cold load, drop the
+ * caches between the save and the load (echo 3 > /proc/sys/vm/drop_caches).
+ */
+std::vector<std::string_view> keys;
+
+double millis(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Insert all keys on every hardware thread, returns the time in ms.
+template <typename Map> double insertAll(Map &h) {
+  const int N = keys.size();
+  const int cores = std::thread::hardware_concurrency();
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < cores; ++c) {
+    threads.push_back(std::thread([&h, c, cores, N]() {
+      for (int i = c * (N / cores);
+           i < (c == cores - 1 ? N : (c + 1) * (N / cores)); ++i) {
+        h.insert(keys[i]);
+      }
+    }));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  return millis(start);
+}
+
+template <typename Map> void check(const Map &h) {
+  assert(h.size() == int(keys.size()));
+  for (std::string_view key : keys) {
+    assert(h.search(key));
+  }
+}
+
+template <typename Map, typename Make>
+void benchmark(const std::string &name, const std::string &path, Make make) {
+  Map *original = make();
+  insertAll(*original);
+
+  auto start = std::chrono::steady_clock::now();
+  original->saveSnapshot(path);
+  const double save = millis(start);
+  delete original;
+  struct stat st;
+  stat(path.c_str(), &st);
+  const double mb = st.st_size / double(1 << 20);
+
+  Map *reinserted = make();
+  const double insert = insertAll(*reinserted);
+  check(*reinserted);
+  delete reinserted;
+
+  Map *loaded = make();
+  start = std::chrono::steady_clock::now();
+  loaded->loadSnapshot(path);
+  const double load = millis(start);
+  check(*loaded);
+  delete loaded;
+
+  std::cout << name << ": " << mb << " MB snapshot, save " << save
+            << " ms (" << mb / save * 1000 << " MB/s), re-insert " << insert
+            << " ms, load " << load << " ms (" << mb / load * 1000
+            << " MB/s).\n";
+}
+
+int main(int argc, char *argv[]) {
+  const std::string path = argc > 1 ? argv[1] : "snapshot.bin";
+  KeyFile insertFile("testdata/insert");
+  for (size_t i = 0; i < insertFile.size(); ++i) {
+    if (insertFile.flag(i)) {
+      keys.push_back(insertFile.key(i));
+    }
+  }
+
+  std::cout << keys.size() << " keys.\n";
+  benchmark<ThreadSafeChainHashMap>("ThreadSafeChainHashMap", path, []() {
+    return new ThreadSafeChainHashMap();
+  });
+  benchmark<ChainHashMapRehashThreads>(
+      "ChainHashMapRehashThreads", path,
+      []() { return new ChainHashMapRehashThreads(0.8, 16, 16); });
+  std::remove(path.c_str());
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include "../src/SwissHashMap.h"
+#include "AllocationCounter.h"
+#include "KeyFile.h"
+#include <cassert>
+#include <iostream>
+#include <thread>
+
+/**
+ * A multi-threaded test application to test multi-threaded thread-safe
+ * SwissHashMap.
+ */
+std::vector<std::pair<std::string_view, bool>> tests;
+
+void test_insert(int start, int n, SwissHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    if (tests[i].second) {
+      assert(h.insert(tests[i].first));
+    }
+  }
+}
+
+void test_search(int start, int n, SwissHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.search(tests[i].first) == tests[i].second);
+  }
+}
+
+void test_remove(int start, int n, SwissHashMap &h) {
+  for (int i = start; i <= n + start - 1; ++i) {
+    assert(h.remove(tests[i].first) == tests[i].second);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  SwissHashMap h;
+  std::chrono::high_resolution_clock::time_point start, end;
+  std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
+  int cores = std::thread::hardware_concurrency();
+  std::vector<std::thread> threads;
+
+  // Test insertion.
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.tests();
+
+  const int N = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  int p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_insert, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == N / 2);
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
+  std::cout << "Insertion time: " << time.count() << " ms.\n";
+
+  // Test search.
+  tests.clear();
+  threads.clear();
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.tests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_search, p, S / cores, std::ref(h)));
+    p += S / cores;
+  }
+  threads.push_back(
+      std::thread(test_search, p, S / cores + S % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
+  std::cout << "Search time: " << time.count() << " ms.\n";
+
+  // Test deletion.
+  tests.clear();
+  threads.clear();
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.tests();
+
+  start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_remove, p, N / cores + N % cores, std::ref(h)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(h.size() == 0);
+  end = std::chrono::high_resolution_clock::now();
+
+  time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+      end - start);
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
+  std::cout << "Deletion time: " << time.count() << " ms.\n";
+
+  // The table doubles as it fills up, starting from one group.
+  tests = insertFile.tests();
+  SwissHashMap small(wyHash, 16);
+  threads.clear();
+  p = 0;
+  for (int i = 1; i <= cores - 1; ++i) {
+    threads.push_back(std::thread(test_insert, p, N / cores, std::ref(small)));
+    p += N / cores;
+  }
+  threads.push_back(
+      std::thread(test_insert, p, N / cores + N % cores, std::ref(small)));
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(small.size() == N / 2);
+  test_search(0, N, small);
+  std::cout << "Growths from 16 slots: " << small.stats().rehashes << ", "
+            << small.capacity() << " slots.\n";
+
+  // Removals under a steady size leave tombstones, which end no probe; the
+  // rebuilds that drop them must keep misses as cheap as in a fresh table.
+  // The keys take under REHASH_LOAD of the table, which keeps its size.
+  const int LIVE = 45000, CHURN = 1100000, MISSES = 100000;
+  SwissHashMap churned(wyHash, 65536);
+  for (int i = 0; i < LIVE; ++i) {
+    churned.insert("churn" + std::to_string(i));
+  }
+  auto missTime = [&]() {
+    const auto missStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < MISSES; ++i) {
+      assert(!churned.search("missing" + std::to_string(i)));
+    }
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - missStart)
+        .count();
+  };
+  const double fresh = missTime();
+  for (int i = LIVE; i < LIVE + CHURN; ++i) {
+    assert(churned.remove("churn" + std::to_string(i - LIVE)));
+    assert(churned.insert("churn" + std::to_string(i)));
+  }
+  assert(churned.size() == LIVE && churned.capacity() == 65536);
+  const double churnedTime = missTime();
+  assert(churnedTime < 5 * fresh);
+  std::cout << "Misses after " << CHURN << " churned keys: " << churnedTime
+            << " ms, " << fresh << " ms fresh, " << churned.stats().rehashes
+            << " rebuilds, " << churned.capacity() << " slots.\n";
+  return 0;
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
+#include "../src/NumaTopology.h"
 #include "../src/ThreadSafeChainHashMap.h"
+#include "AllocationCounter.h"
+#include "KeyFile.h"
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <cstring>
 #include <iostream>
 #include <thread>
 
@@ -8,7 +12,7 @@
  * A multi-threaded test application to test single-threaded thread-safe
  * ThreadSafeChainHashMap.
  */
-std::vector<std::pair<std::string, bool>> tests;
+std::vector<std::pair<std::string_view, bool>> tests;
 
 void test_insert(int start, int n, ThreadSafeChainHashMap &h) {
   for (int i = start; i <= n + start - 1; ++i) {
@@ -30,90 +34,179 @@ void test_remove(int start, int n, ThreadSafeChainHashMap &h) {
   }
 }
 
+// Sort the tests by shard, so that every shard's keys form one range.
+void sort_by_shard(const ThreadSafeChainHashMap &h) {
+  std::stable_sort(tests.begin(), tests.end(),
+                   [&h](const std::pair<std::string_view, bool> &a,
+                        const std::pair<std::string_view, bool> &b) {
+                     return h.shardOf(a.first) < h.shardOf(b.first);
+                   });
+}
+
+// Split every shard's range of the sorted tests over threads pinned to the
+// shard's node, so that each thread only touches node-local memory.
+void run_steered(void (*task)(int, int, ThreadSafeChainHashMap &),
+                 ThreadSafeChainHashMap &h, int cores) {
+  const int shards = h.shardCount();
+  const int perShard = std::max(1, cores / shards);
+  std::vector<std::thread> threads;
+  int first = 0;
+  for (int s = 0; s < shards; ++s) {
+    int last = first;
+    while (last < int(tests.size()) && h.shardOf(tests[last].first) == s) {
+      ++last;
+    }
+    const int n = last - first;
+    for (int i = 0; i < perShard; ++i) {
+      const int start = first + i * (n / perShard);
+      const int count = n / perShard + (i == perShard - 1 ? n % perShard : 0);
+      const int node = h.nodeOfShard(s);
+      threads.push_back(std::thread([=, &h]() {
+        NumaTopology::pin(node);
+        task(start, count, h);
+      }));
+    }
+    first = last;
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
 int main(int argc, char *argv[]) {
-  ThreadSafeChainHashMap h;
-  std::string s;
-  bool toInsert;
+  // Pass "numa" for one shard per NUMA node, with the worker threads pinned
+  // to the node of the keys they work on, and "stats" to print the chain
+  // lengths and lock contention after insertion and deletion.
+  bool numa = false;
+  bool stats = false;
+  for (int i = 1; i < argc; ++i) {
+    numa = numa || std::strcmp(argv[i], "numa") == 0;
+    stats = stats || std::strcmp(argv[i], "stats") == 0;
+  }
+  ThreadSafeChainHashMap h(wyHash, LockStripes::MUTEX,
+                           ThreadSafeChainHashMap::DEFAULT_STRIPES,
+                           numa ? ThreadSafeChainHashMap::NUMA_NODES : 1);
+  h.collectStats(stats);
   std::chrono::high_resolution_clock::time_point start, end;
   std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
   int cores = std::thread::hardware_concurrency();
   std::vector<std::thread> threads;
 
   // Test insertion.
-  std::ifstream insertFile("testdata/insert.txt");
-  while (insertFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.tests();
+  if (numa) {
+    sort_by_shard(h);
   }
-  insertFile.close();
 
   const int N = tests.size();
+  int p = 0;
 
   start = std::chrono::high_resolution_clock::now();
-  int p = 0;
-  for (int i = 1; i <= cores - 1; ++i) {
-    threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
-    p += N / cores;
+  if (allocations) {
+    AllocationCounter::start();
   }
-  threads.push_back(
-      std::thread(test_insert, p, N / cores + N % cores, std::ref(h)));
-  for (auto &t : threads) {
-    t.join();
+  if (numa) {
+    run_steered(test_insert, h, cores);
+  } else {
+    for (int i = 1; i <= cores - 1; ++i) {
+      threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
+      p += N / cores;
+    }
+    threads.push_back(
+        std::thread(test_insert, p, N / cores + N % cores, std::ref(h)));
+    for (auto &t : threads) {
+      t.join();
+    }
   }
   assert(h.size() == N / 2);
   end = std::chrono::high_resolution_clock::now();
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
   std::cout << "Insertion time: " << time.count() << " ms.\n";
+  if (stats) {
+    h.dumpStats();
+  }
 
   // Test search.
   tests.clear();
   threads.clear();
-  std::ifstream searchFile("testdata/search.txt");
-  while (searchFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.tests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
+  if (numa) {
+    sort_by_shard(h);
   }
-  searchFile.close();
 
   start = std::chrono::high_resolution_clock::now();
-  p = 0;
-  for (int i = 1; i <= cores - 1; ++i) {
-    threads.push_back(std::thread(test_search, p, N / cores, std::ref(h)));
-    p += N / cores;
+  if (allocations) {
+    AllocationCounter::start();
   }
-  threads.push_back(
-      std::thread(test_search, p, N / cores + N % cores, std::ref(h)));
-  for (auto &t : threads) {
-    t.join();
+  if (numa) {
+    run_steered(test_search, h, cores);
+  } else {
+    p = 0;
+    for (int i = 1; i <= cores - 1; ++i) {
+      threads.push_back(std::thread(test_search, p, S / cores, std::ref(h)));
+      p += S / cores;
+    }
+    threads.push_back(
+        std::thread(test_search, p, S / cores + S % cores, std::ref(h)));
+    for (auto &t : threads) {
+      t.join();
+    }
   }
   end = std::chrono::high_resolution_clock::now();
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
   std::cout << "Search time: " << time.count() << " ms.\n";
 
   // Test deletion.
   tests.clear();
   threads.clear();
-  std::ifstream deletionFile("testdata/delete.txt");
-  while (deletionFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.tests();
+  if (numa) {
+    sort_by_shard(h);
   }
-  deletionFile.close();
 
   start = std::chrono::high_resolution_clock::now();
-  p = 0;
-  for (int i = 1; i <= cores - 1; ++i) {
-    threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
-    p += N / cores;
+  if (allocations) {
+    AllocationCounter::start();
   }
-  threads.push_back(
-      std::thread(test_remove, p, N / cores + N % cores, std::ref(h)));
-  for (auto &t : threads) {
-    t.join();
+  if (numa) {
+    run_steered(test_remove, h, cores);
+  } else {
+    p = 0;
+    for (int i = 1; i <= cores - 1; ++i) {
+      threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
+      p += N / cores;
+    }
+    threads.push_back(
+        std::thread(test_remove, p, N / cores + N % cores, std::ref(h)));
+    for (auto &t : threads) {
+      t.join();
+    }
   }
   assert(h.size() == 0);
   end = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
   std::cout << "Deletion time: " << time.count() << " ms.\n";
+  if (stats) {
+    h.dumpStats();
+  }
   return 0;
 }
\ No newline at end of file
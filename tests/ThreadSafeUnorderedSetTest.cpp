@@ -1,5 +1,6 @@
+#include "AllocationCounter.h"
+#include "KeyFile.h"
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <mutex>
 #include <thread>
@@ -38,23 +39,23 @@ void test_remove(int start, int n, std::unordered_set<std::string> &h) {
 
 int main(int argc, char *argv[]) {
   std::unordered_set<std::string> h;
-  std::string s;
-  bool toInsert;
   std::chrono::high_resolution_clock::time_point start, end;
   std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
   int cores = std::thread::hardware_concurrency();
   std::vector<std::thread> threads;
 
   // Test insertion.
-  std::ifstream insertFile("testdata/insert.txt");
-  while (insertFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  insertFile.close();
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.stringTests();
 
   const int N = tests.size();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
   int p = 0;
   for (int i = 1; i <= cores - 1; ++i) {
     threads.push_back(std::thread(test_insert, p, N / cores, std::ref(h)));
@@ -70,25 +71,30 @@ int main(int argc, char *argv[]) {
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
   std::cout << "Insertion time: " << time.count() << " ms.\n";
 
   // Test search.
   tests.clear();
   threads.clear();
-  std::ifstream searchFile("testdata/search.txt");
-  while (searchFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  searchFile.close();
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.stringTests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
   p = 0;
   for (int i = 1; i <= cores - 1; ++i) {
-    threads.push_back(std::thread(test_search, p, N / cores, std::ref(h)));
-    p += N / cores;
+    threads.push_back(std::thread(test_search, p, S / cores, std::ref(h)));
+    p += S / cores;
   }
   threads.push_back(
-      std::thread(test_search, p, N / cores + N % cores, std::ref(h)));
+      std::thread(test_search, p, S / cores + S % cores, std::ref(h)));
   for (auto &t : threads) {
     t.join();
   }
@@ -96,18 +102,21 @@ int main(int argc, char *argv[]) {
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
   std::cout << "Search time: " << time.count() << " ms.\n";
 
   // Test deletion.
   tests.clear();
   threads.clear();
-  std::ifstream deletionFile("testdata/delete.txt");
-  while (deletionFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  deletionFile.close();
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.stringTests();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
   p = 0;
   for (int i = 1; i <= cores - 1; ++i) {
     threads.push_back(std::thread(test_remove, p, N / cores, std::ref(h)));
@@ -120,6 +129,9 @@ int main(int argc, char *argv[]) {
   }
   assert(h.size() == 0);
   end = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
   std::cout << "Deletion time: " << time.count() << " ms.\n";
   return 0;
 }
\ No newline at end of file
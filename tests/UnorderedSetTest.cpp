@@ -1,6 +1,7 @@
+#include "AllocationCounter.h"
+#include "KeyFile.h"
 #include <cassert>
 #include <chrono>
-#include <fstream>
 #include <iostream>
 #include <unordered_set>
 #include <vector>
@@ -10,21 +11,21 @@ int main(int argc, char *argv[]) {
 
   std::unordered_set<std::string> h;
   std::vector<std::pair<std::string, bool>> tests;
-  std::string s;
-  bool toInsert;
   std::chrono::high_resolution_clock::time_point start, end;
   std::chrono::duration<double, std::milli> time;
+  // Pass "allocations" to count heap allocations per operation.
+  const bool allocations = AllocationCounter::requested(argc, argv);
 
   // Test insertion.
-  std::ifstream insertFile("testdata/insert.txt");
-  while (insertFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  insertFile.close();
+  KeyFile insertFile("testdata/insert");
+  tests = insertFile.stringTests();
 
   const int N = tests.size();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
   for (int i = 0; i < tests.size(); ++i) {
     if (tests[i].second) {
       h.insert(tests[i].first);
@@ -35,17 +36,22 @@ int main(int argc, char *argv[]) {
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Insertion", N / 2);
+  }
   std::cout << "Insertion time: " << time.count() << " ms.\n";
 
   // Test search.
   tests.clear();
-  std::ifstream searchFile("testdata/search.txt");
-  while (searchFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  searchFile.close();
+  KeyFile searchFile("testdata/search");
+  tests = searchFile.stringTests();
+  // The search file may hold more or fewer lookups than keys inserted.
+  const int S = tests.size();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
   for (int i = 0; i < tests.size(); ++i) {
     assert((h.find(tests[i].first) != h.end() ? true : false) ==
            tests[i].second);
@@ -54,17 +60,20 @@ int main(int argc, char *argv[]) {
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Search", S);
+  }
   std::cout << "Search time: " << time.count() << " ms.\n";
 
   // Test deletion.
   tests.clear();
-  std::ifstream deletionFile("testdata/delete.txt");
-  while (deletionFile >> s >> toInsert) {
-    tests.push_back({s, toInsert});
-  }
-  deletionFile.close();
+  KeyFile deletionFile("testdata/delete");
+  tests = deletionFile.stringTests();
 
   start = std::chrono::high_resolution_clock::now();
+  if (allocations) {
+    AllocationCounter::start();
+  }
   for (int i = 0; i < tests.size(); ++i) {
     assert(h.erase(tests[i].first) == tests[i].second);
   }
@@ -73,5 +82,8 @@ int main(int argc, char *argv[]) {
 
   time = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
       end - start);
+  if (allocations) {
+    AllocationCounter::report("Deletion", N);
+  }
   std::cout << "Deletion time: " << time.count() << " ms.\n";
 }
\ No newline at end of file